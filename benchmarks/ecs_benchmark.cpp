@@ -0,0 +1,503 @@
+// headless microbenchmarks for itu_entity_storage
+// No window nor renderer is created: every scenario runs in its own world (see `ITU_World`), at a few entity counts,
+// for both storage modes. Results are written as JSON (to stdout, or to the file passed as first argument),
+// so that different versions of the storage can be compared.
+//
+// usage: ecs_benchmark [output.json] [repetitions]   (repetitions: 1 to `BENCH_REPETITIONS_MAX`)
+
+#define TEXTURE_PIXELS_PER_UNIT 128
+#define CAMERA_PIXELS_PER_UNIT  32
+
+#include <itu_unity_include.hpp>
+#include <stdio.h>
+
+#define BENCH_REPETITIONS_DEFAULT 5
+#define BENCH_REPETITIONS_MAX     64
+#define BENCH_RESULTS_MAX         512
+
+// all the same size, so that iteration cost only depends on the number of components
+struct BenchC0 { float v[4]; };
+struct BenchC1 { float v[4]; };
+struct BenchC2 { float v[4]; };
+struct BenchC3 { float v[4]; };
+struct BenchC4 { float v[4]; };
+struct BenchC5 { float v[4]; };
+struct BenchC6 { float v[4]; };
+struct BenchC7 { float v[4]; };
+
+register_component(BenchC0)
+register_component(BenchC1)
+register_component(BenchC2)
+register_component(BenchC3)
+register_component(BenchC4)
+register_component(BenchC5)
+register_component(BenchC6)
+register_component(BenchC7)
+
+// `PhysicsData` as it was before `PhysicsInterpolation` was split out of it
+struct BenchPhysicsDataLegacy
+{
+	b2BodyId body_id;
+
+	vec2f fixed_step_position;
+	float fixed_step_rotation;
+	vec2f fixed_step_velocity;
+	float fixed_step_torque;
+
+	vec2f velocity;
+	float torque;
+
+	bool ignore_position;
+	bool ignore_rotation;
+};
+
+register_component(BenchPhysicsDataLegacy)
+
+struct BenchResult
+{
+	char name[64];
+	const char* mode;
+	int entities_count;
+	int bytes_per_entity; // component data read by the scenario for each entity (0 if not relevant)
+	Uint64 ns_min;
+	Uint64 ns_median;
+};
+
+struct BenchContext
+{
+	BenchResult results[BENCH_RESULTS_MAX];
+	int results_count;
+	int repetitions;
+
+	stbds_arr(ITU_EntityId) entity_ids; // created by the last `bench_populate`, in the current world
+
+	// keeps the optimizer from removing iteration loops
+	volatile float sink;
+	int systems_seen;
+};
+
+static BenchContext ctx_bench;
+
+static int bench_entities_counts[] = { 1000, 2000, 4000, 8000, 16000 };
+static ITU_EStorageMode bench_modes[] = { ITU_ESTORAGE_MODE_SPARSE, ITU_ESTORAGE_MODE_ARCHETYPE };
+static const char* bench_mode_names[] = { "sparse", "archetype" };
+
+typedef void (*BenchFunction)(int entities_count);
+
+Uint64 bench_now_ns()
+{
+	return SDL_GetPerformanceCounter() * SECONDS(1) / SDL_GetPerformanceFrequency();
+}
+
+int bench_compare_u64(const void* a, const void* b)
+{
+	Uint64 va = *(const Uint64*)a;
+	Uint64 vb = *(const Uint64*)b;
+	return va < vb ? -1 : va > vb;
+}
+
+// new world with all the benchmark components enabled, made current
+ITU_World* bench_world_begin(ITU_EStorageMode mode)
+{
+	ITU_World* world = itu_world_create(16, false, mode);
+	itu_world_set_current(world);
+	enable_component(BenchC0);
+	enable_component(BenchC1);
+	enable_component(BenchC2);
+	enable_component(BenchC3);
+	enable_component(BenchC4);
+	enable_component(BenchC5);
+	enable_component(BenchC6);
+	enable_component(BenchC7);
+	enable_component(Transform);
+	enable_component(Sprite);
+	enable_component(SpriteCompact);
+	enable_component(PhysicsData);
+	enable_component(PhysicsInterpolation);
+	enable_component(BenchPhysicsDataLegacy);
+	return world;
+}
+
+void bench_world_end(ITU_World* world)
+{
+	itu_world_set_current(NULL);
+	itu_world_destroy(world);
+}
+
+// entities with the first `components_count` components
+void bench_populate(int entities_count, int components_count)
+{
+	float value[4] = { 1, 2, 3, 4 };
+	stbds_arrsetlen(ctx_bench.entity_ids, entities_count);
+	for(int i = 0; i < entities_count; ++i)
+	{
+		ITU_EntityId id = itu_entity_create();
+		for(int c = 0; c < components_count; ++c)
+			itu_entity_component_add(id, ITU_COMPONENT_TYPE_BenchC0 + c, value);
+		ctx_bench.entity_ids[i] = id;
+	}
+}
+
+// runs `fn_setup` (untimed) and `fn_bench` (timed) `repetitions` times, each time in a fresh world
+void bench_run(const char* name, int bytes_per_entity, BenchFunction fn_setup, BenchFunction fn_bench)
+{
+	for(int m = 0; m < SDL_arraysize(bench_modes); ++m)
+	{
+		for(int n = 0; n < SDL_arraysize(bench_entities_counts); ++n)
+		{
+			int entities_count = bench_entities_counts[n];
+			Uint64 times[BENCH_REPETITIONS_MAX];
+			int repetitions = ctx_bench.repetitions;
+			for(int r = 0; r < repetitions; ++r)
+			{
+				ITU_World* world = bench_world_begin(bench_modes[m]);
+				if(fn_setup)
+					fn_setup(entities_count);
+
+				Uint64 time_start = bench_now_ns();
+				fn_bench(entities_count);
+				times[r] = bench_now_ns() - time_start;
+
+				bench_world_end(world);
+			}
+			SDL_qsort(times, repetitions, sizeof(Uint64), bench_compare_u64);
+
+			SDL_assert(ctx_bench.results_count < BENCH_RESULTS_MAX);
+			BenchResult* result = &ctx_bench.results[ctx_bench.results_count++];
+			SDL_strlcpy(result->name, name, sizeof(result->name));
+			result->mode = bench_mode_names[m];
+			result->entities_count = entities_count;
+			result->bytes_per_entity = bytes_per_entity;
+			result->ns_min = times[0];
+			result->ns_median = times[repetitions / 2];
+
+			SDL_Log("%-28s %-10s %6d %4d B  min %10.3f ms  median %10.3f ms\n", name, result->mode, entities_count, bytes_per_entity, result->ns_min / 1000000.0, result->ns_median / 1000000.0);
+		}
+	}
+}
+
+// scenarios
+void bench_setup_populate_4(int entities_count)
+{
+	bench_populate(entities_count, 4);
+}
+
+void bench_setup_populate_8(int entities_count)
+{
+	bench_populate(entities_count, 8);
+}
+
+void bench_create_destroy_churn(int entities_count)
+{
+	// create everything, then destroy and recreate half of it a few times (exercises id recycling)
+	ITU_EntityId* ids = (ITU_EntityId*)SDL_malloc(sizeof(ITU_EntityId) * entities_count);
+	float value[4] = { 0 };
+	for(int i = 0; i < entities_count; ++i)
+	{
+		ids[i] = itu_entity_create();
+		itu_entity_component_add(ids[i], ITU_COMPONENT_TYPE_BenchC0, value);
+		itu_entity_component_add(ids[i], ITU_COMPONENT_TYPE_BenchC1, value);
+	}
+	for(int round = 0; round < 4; ++round)
+	{
+		for(int i = round % 2; i < entities_count; i += 2)
+			itu_entity_destroy(ids[i]);
+		for(int i = round % 2; i < entities_count; i += 2)
+		{
+			ids[i] = itu_entity_create();
+			itu_entity_component_add(ids[i], ITU_COMPONENT_TYPE_BenchC0, value);
+			itu_entity_component_add(ids[i], ITU_COMPONENT_TYPE_BenchC1, value);
+		}
+	}
+	SDL_free(ids);
+}
+
+void bench_component_add_remove(int entities_count)
+{
+	float value[4] = { 0 };
+	for(int round = 0; round < 4; ++round)
+	{
+		ITU_ComponentType component_type = ITU_COMPONENT_TYPE_BenchC4 + round;
+		for(int i = 0; i < entities_count; ++i)
+			itu_entity_component_add(ctx_bench.entity_ids[i], component_type, value);
+		for(int i = 0; i < entities_count; ++i)
+			itu_entity_component_remove(ctx_bench.entity_ids[i], component_type);
+	}
+}
+
+void bench_tag_add_remove(int entities_count)
+{
+	for(int tag = 0; tag < 8; ++tag)
+	{
+		for(int i = 0; i < entities_count; ++i)
+			itu_entity_tag_add(ctx_bench.entity_ids[i], tag);
+		int members_count;
+		itu_entity_tag_members(tag, &members_count);
+		SDL_assert(members_count == entities_count);
+		for(int i = 0; i < entities_count; i += 2)
+			itu_entity_tag_remove(ctx_bench.entity_ids[i], tag);
+	}
+}
+
+void bench_system_count(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count)
+{
+	ctx_bench.systems_seen += entity_ids_count;
+}
+
+// cost of keeping the systems' matching entities up to date, while the signature of entities changes
+void bench_system_matching(int entities_count)
+{
+	for(int i = 0; i < 8; ++i)
+		add_system(bench_system_count, (1ull << (ITU_COMPONENT_TYPE_BenchC0 + i)) | component_mask(BenchC0), 0);
+
+	SDLContext context = { };
+	float value[4] = { 0 };
+	for(int round = 0; round < 4; ++round)
+	{
+		ITU_ComponentType component_type = ITU_COMPONENT_TYPE_BenchC4 + round;
+		for(int i = round % 2; i < entities_count; i += 2)
+			itu_entity_component_remove(ctx_bench.entity_ids[i], component_type);
+		itu_sys_estorage_systems_update(&context);
+		for(int i = round % 2; i < entities_count; i += 2)
+			itu_entity_component_add(ctx_bench.entity_ids[i], component_type, value);
+		itu_sys_estorage_systems_update(&context);
+	}
+}
+
+template<typename... T>
+void bench_iterate(int entities_count)
+{
+	// NOTE: several passes, a single one is too short to be measured reliably at low entity counts
+	float sum = 0;
+	for(int pass = 0; pass < 16; ++pass)
+	{
+		itu_query<T...> query;
+		while(query.next())
+		{
+			float* columns[] = { query.template column_read<T>()->v... };
+			for(int c = 0; c < sizeof...(T); ++c)
+				for(int i = 0; i < query.count(); ++i)
+					sum += columns[c][i * 4];
+		}
+	}
+	ctx_bench.sink = sum;
+}
+
+void bench_setup_sprites(int entities_count)
+{
+	Transform transform = { };
+	transform.scale = VEC2F_ONE;
+	Sprite sprite;
+	itu_lib_sprite_init(&sprite, NULL, SDL_FRect{ 0, 0, 32, 32 });
+	for(int i = 0; i < entities_count; ++i)
+	{
+		ITU_EntityId id = itu_entity_create();
+		transform.position = vec2f{ (float)i, 0 };
+		entity_add_component(id, Transform, transform);
+		entity_add_component(id, Sprite, sprite);
+	}
+}
+
+void bench_setup_sprites_compact(int entities_count)
+{
+	Transform transform = { };
+	transform.scale = VEC2F_ONE;
+	SpriteCompact sprite;
+	itu_lib_sprite_compact_init(&sprite, SPRITE_COMPACT_TEXTURE_NONE, SDL_FRect{ 0, 0, 32, 32 });
+	for(int i = 0; i < entities_count; ++i)
+	{
+		ITU_EntityId id = itu_entity_create();
+		transform.position = vec2f{ (float)i, 0 };
+		entity_add_component(id, Transform, transform);
+		entity_add_component(id, SpriteCompact, sprite);
+	}
+}
+
+// reads everything the sprite render system needs, without actually rendering
+void bench_sprites(int entities_count)
+{
+	float sum = 0;
+	for(int pass = 0; pass < 16; ++pass)
+	{
+		itu_query<Transform, Sprite> query;
+		while(query.next())
+		{
+			Transform* transforms = query.column_read<Transform>();
+			Sprite*    sprites    = query.column_read<Sprite>();
+			for(int i = 0; i < query.count(); ++i)
+			{
+				Sprite* sprite = &sprites[i];
+				sum += transforms[i].position.x + transforms[i].rotation + sprite->rect.w * sprite->pivot.x;
+				sum += sprite->tint.r + sprite->tint.a + (sprite->texture != NULL) + sprite->flip_horizontal;
+			}
+		}
+	}
+	ctx_bench.sink = sum;
+}
+
+void bench_sprites_compact(int entities_count)
+{
+	float sum = 0;
+	for(int pass = 0; pass < 16; ++pass)
+	{
+		itu_query<Transform, SpriteCompact> query;
+		while(query.next())
+		{
+			Transform*     transforms = query.column_read<Transform>();
+			SpriteCompact* sprites    = query.column_read<SpriteCompact>();
+			for(int i = 0; i < query.count(); ++i)
+			{
+				SpriteCompact* sprite = &sprites[i];
+				color tint = itu_lib_sprite_tint_unpack(sprite->tint);
+				sum += transforms[i].position.x + transforms[i].rotation + sprite->rect.w * sprite->pivot.x;
+				sum += tint.r + tint.a + (sprite->texture != SPRITE_COMPACT_TEXTURE_NONE) + sprite->flip_horizontal;
+			}
+		}
+	}
+	ctx_bench.sink = sum;
+}
+
+void bench_setup_physics_legacy(int entities_count)
+{
+	BenchPhysicsDataLegacy physics_data = { };
+	for(int i = 0; i < entities_count; ++i)
+	{
+		ITU_EntityId id = itu_entity_create();
+		physics_data.velocity = vec2f{ (float)i, 1 };
+		entity_add_component(id, BenchPhysicsDataLegacy, physics_data);
+	}
+}
+
+void bench_setup_physics(int entities_count)
+{
+	PhysicsData physics_data = { };
+	PhysicsInterpolation interpolation = { };
+	for(int i = 0; i < entities_count; ++i)
+	{
+		ITU_EntityId id = itu_entity_create();
+		physics_data.velocity = vec2f{ (float)i, 1 };
+		entity_add_component(id, PhysicsData, physics_data);
+		entity_add_component(id, PhysicsInterpolation, interpolation);
+	}
+}
+
+// what gameplay code typically does with physics bodies every frame (steering): read and write velocity
+void bench_physics_legacy(int entities_count)
+{
+	for(int pass = 0; pass < 16; ++pass)
+	{
+		itu_query<BenchPhysicsDataLegacy> query;
+		while(query.next())
+		{
+			BenchPhysicsDataLegacy* physics_datas = query.column<BenchPhysicsDataLegacy>();
+			for(int i = 0; i < query.count(); ++i)
+			{
+				physics_datas[i].velocity = physics_datas[i].velocity * 0.99f;
+				physics_datas[i].torque += 0.01f;
+			}
+		}
+	}
+}
+
+void bench_physics(int entities_count)
+{
+	for(int pass = 0; pass < 16; ++pass)
+	{
+		itu_query<PhysicsData> query;
+		while(query.next())
+		{
+			PhysicsData* physics_datas = query.column<PhysicsData>();
+			for(int i = 0; i < query.count(); ++i)
+			{
+				physics_datas[i].velocity = physics_datas[i].velocity * 0.99f;
+				physics_datas[i].torque += 0.01f;
+			}
+		}
+	}
+}
+
+void bench_json_append(stbds_arr(char)* json, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	va_list args_copy;
+	va_copy(args_copy, args);
+	int len = SDL_vsnprintf(NULL, 0, fmt, args_copy);
+	va_end(args_copy);
+
+	// NOTE: `SDL_vsnprintf` always writes the null terminator, so we make room for it and drop it afterwards
+	SDL_assert(len >= 0);
+	char* line = stbds_arraddnptr(*json, len + 1);
+	SDL_vsnprintf(line, len + 1, fmt, args);
+	va_end(args);
+	stbds_arrsetlen(*json, stbds_arrlen(*json) - 1);
+}
+
+// NOTE: the result is NOT null terminated
+stbds_arr(char) bench_json_build()
+{
+	stbds_arr(char) json = NULL;
+	bench_json_append(&json, "{\n");
+	bench_json_append(&json, "\t\"repetitions\": %d,\n", ctx_bench.repetitions);
+	bench_json_append(&json, "\t\"results\": [\n");
+	for(int i = 0; i < ctx_bench.results_count; ++i)
+	{
+		BenchResult* result = &ctx_bench.results[i];
+		bench_json_append(&json, "\t\t{ \"name\": \"%s\", \"mode\": \"%s\", \"entities\": %d, \"bytes_per_entity\": %d, \"ns_min\": %llu, \"ns_median\": %llu }%s\n",
+			result->name, result->mode, result->entities_count, result->bytes_per_entity,
+			(unsigned long long)result->ns_min, (unsigned long long)result->ns_median,
+			i < ctx_bench.results_count - 1 ? "," : ""
+		);
+	}
+	bench_json_append(&json, "\t]\n");
+	bench_json_append(&json, "}\n");
+	return json;
+}
+
+int main(int argc, char** argv)
+{
+	const char* path_output = argc > 1 ? argv[1] : NULL;
+	ctx_bench.repetitions = argc > 2 ? SDL_atoi(argv[2]) : BENCH_REPETITIONS_DEFAULT;
+	if(ctx_bench.repetitions < 1 || ctx_bench.repetitions > BENCH_REPETITIONS_MAX)
+	{
+		SDL_Log("ERROR repetitions must be between 1 and %d (got %d)\n", BENCH_REPETITIONS_MAX, ctx_bench.repetitions);
+		return 1;
+	}
+
+	bench_run("create_destroy_churn", 0                      , NULL                       , bench_create_destroy_churn);
+	bench_run("component_add_remove", 0                      , bench_setup_populate_4     , bench_component_add_remove);
+	bench_run("tag_add_remove"      , 0                      , bench_setup_populate_4     , bench_tag_add_remove);
+	bench_run("system_matching"     , 0                      , bench_setup_populate_8     , bench_system_matching);
+	bench_run("iterate_1"           , sizeof(BenchC0) * 1    , bench_setup_populate_8     , bench_iterate<BenchC0>);
+	bench_run("iterate_2"           , sizeof(BenchC0) * 2    , bench_setup_populate_8     , bench_iterate<BenchC0, BenchC1>);
+	bench_run("iterate_3"           , sizeof(BenchC0) * 3    , bench_setup_populate_8     , bench_iterate<BenchC0, BenchC1, BenchC2>);
+	bench_run("iterate_4"           , sizeof(BenchC0) * 4    , bench_setup_populate_8     , bench_iterate<BenchC0, BenchC1, BenchC2, BenchC3>);
+	bench_run("iterate_5"           , sizeof(BenchC0) * 5    , bench_setup_populate_8     , bench_iterate<BenchC0, BenchC1, BenchC2, BenchC3, BenchC4>);
+	bench_run("iterate_6"           , sizeof(BenchC0) * 6    , bench_setup_populate_8     , bench_iterate<BenchC0, BenchC1, BenchC2, BenchC3, BenchC4, BenchC5>);
+	bench_run("iterate_7"           , sizeof(BenchC0) * 7    , bench_setup_populate_8     , bench_iterate<BenchC0, BenchC1, BenchC2, BenchC3, BenchC4, BenchC5, BenchC6>);
+	bench_run("iterate_8"           , sizeof(BenchC0) * 8    , bench_setup_populate_8     , bench_iterate<BenchC0, BenchC1, BenchC2, BenchC3, BenchC4, BenchC5, BenchC6, BenchC7>);
+
+	// layout comparisons (before/after)
+	bench_run("sprite"              , sizeof(Transform) + sizeof(Sprite)       , bench_setup_sprites        , bench_sprites);
+	bench_run("sprite_compact"      , sizeof(Transform) + sizeof(SpriteCompact), bench_setup_sprites_compact, bench_sprites_compact);
+	bench_run("physics_legacy"      , sizeof(BenchPhysicsDataLegacy)           , bench_setup_physics_legacy , bench_physics_legacy);
+	bench_run("physics"             , sizeof(PhysicsData)                      , bench_setup_physics        , bench_physics);
+
+	stbds_arr(char) json = bench_json_build();
+	int ret = 0;
+	if(path_output)
+	{
+		if(!SDL_SaveFile(path_output, json, stbds_arrlen(json)))
+		{
+			SDL_Log("ERROR could not write '%s': %s\n", path_output, SDL_GetError());
+			ret = 1;
+		}
+	}
+	else
+		fwrite(json, 1, stbds_arrlen(json), stdout);
+	stbds_arrfree(json);
+	stbds_arrfree(ctx_bench.entity_ids);
+
+	itu_lib_jobs_deinit();
+	return ret;
+}
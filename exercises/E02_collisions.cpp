@@ -1,11 +1,13 @@
 #define STB_IMAGE_IMPLEMENTATION
 #define ITU_LIB_ENGINE_IMPLEMENTATION
+#define ITU_LIB_ARENA_IMPLEMENTATION
 #define ITU_LIB_RENDER_IMPLEMENTATION
 #define ITU_LIB_OVERLAPS_IMPLEMENTATION
 
 #include <SDL3/SDL.h>
 
 #include <itu_common.hpp>
+#include <itu_lib_arena.hpp>
 #include <itu_lib_render.hpp>
 #include <itu_lib_overlaps.hpp>
 
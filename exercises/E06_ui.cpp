@@ -316,7 +316,7 @@ void ex6_system_assign_player_target(SDLContext* context, ITU_EntityId* entity_i
 	if(!itu_entity_is_valid(id_player))
 		return;
 
-	EX6_PlayerData* player_data = entity_get_data(id_player, EX6_PlayerData);
+	EX6_PlayerData* player_data = entity_get_data_mut(id_player, EX6_PlayerData);
 	Transform* player_transform = entity_get_data(id_player, Transform);
 	vec2f player_pos = player_transform->position;
 
@@ -344,9 +344,9 @@ void ex6_system_player_update(SDLContext* context, ITU_EntityId* entity_ids, int
 	for(int i = 0; i < entity_ids_count; ++i)
 	{
 		ITU_EntityId id = entity_ids[i];
-		Transform*      transform    = entity_get_data(id, Transform);
+		Transform*      transform    = entity_get_data_mut(id, Transform);
 		EX6_PlayerData* data         = entity_get_data(id, EX6_PlayerData);
-		PhysicsData*    physics_data = entity_get_data(id, PhysicsData);
+		PhysicsData*    physics_data = entity_get_data_mut(id, PhysicsData);
 
 		vec2f dir = VEC2F_ZERO;
 		if(context->btn_isdown[BTN_TYPE_UP])
@@ -642,7 +642,7 @@ int main(void)
 			ImGui::Text("Timing");
 			ImGui::LabelText("work", "%6.3f ms/f", (float)elapsed_work  / (float)MILLIS(1));
 			ImGui::LabelText("tot",  "%6.3f ms/f", (float)elapsed_frame / (float)MILLIS(1));
-			ImGui::LabelText("physics steps",  "%d", context.physics_steps_count);
+			ImGui::LabelText("physics steps",  "%d", itu_sys_estorage_phase_runs_count(ITU_SYSTEM_PHASE_FIXED_UPDATE));
 
 			ImGui::End();
 
@@ -1,13 +1,17 @@
 #define STB_IMAGE_IMPLEMENTATION
 #define ITU_LIB_ENGINE_IMPLEMENTATION
+#define ITU_LIB_ARENA_IMPLEMENTATION
 #define ITU_LIB_RENDER_IMPLEMENTATION
 #define ITU_LIB_OVERLAPS_IMPLEMENTATION
+#define ITU_LIB_LOOP_IMPLEMENTATION
 
 #include <SDL3/SDL.h>
 
 #include <itu_common.hpp>
+#include <itu_lib_arena.hpp>
 #include <itu_lib_render.hpp>
 #include <itu_lib_overlaps.hpp>
+#include <itu_lib_loop.hpp>
 
 #define ENABLE_DIAGNOSTICS
 
@@ -637,18 +641,13 @@ int main(void)
 	game_init(&context, &state);
 	game_reset(&context, &state);
 
-	SDL_Time walltime_frame_beg;
-	SDL_Time walltime_frame_end;
-	SDL_Time walltime_work_end;
-	SDL_Time elapsed_work;
-	SDL_Time elapsed_frame;
-
-	SDL_GetCurrentTime(&walltime_frame_beg);
-	walltime_frame_end = walltime_frame_beg;
+	ITU_FrameLoop loop;
+	itu_lib_loop_init(&loop, context.renderer, TARGET_FRAMERATE, ITU_LOOP_PACING_HYBRID);
 
 	while(!quit)
 	{
 		// input
+		itu_lib_loop_frame_begin(&loop);
 		SDL_Event event;
 		while(SDL_PollEvent(&event))
 		{
@@ -697,37 +696,29 @@ int main(void)
 		game_update(&context, &state);
 		game_render(&context, &state);
 
-		SDL_GetCurrentTime(&walltime_work_end);
-		elapsed_work = walltime_work_end - walltime_frame_beg;
-
-		if(elapsed_work < TARGET_FRAMERATE)
-			SDL_DelayPrecise(TARGET_FRAMERATE - elapsed_work);
-		SDL_GetCurrentTime(&walltime_frame_end);
-		elapsed_frame = walltime_frame_end - walltime_frame_beg;
-		
-
 #ifdef ENABLE_DIAGNOSTICS
 		{
 			SDL_SetRenderDrawColor(context.renderer, 0x0, 0x00, 0x00, 0xCC);
-			SDL_FRect rect = SDL_FRect{ 5, 5, 225, 85 };
+			// NOTE: timings are about the previous frame (this frame's wait and present haven't happened yet)
+			SDL_FRect rect = SDL_FRect{ 5, 5, 225, 95 };
 			SDL_RenderFillRect(context.renderer, &rect);
 			SDL_SetRenderDrawColor(context.renderer, 0xFF, 0xFF, 0xFF, 0xFF);
 			SDL_RenderDebugTextFormat(context.renderer, 10, 10, "entities : %d", ENTITY_COUNT);
-			SDL_RenderDebugTextFormat(context.renderer, 10, 20, "work     : %9.6f ms/f", (float)elapsed_work  / (float)MILLIS(1));
-			SDL_RenderDebugTextFormat(context.renderer, 10, 30, "tot      : %9.6f ms/f", (float)elapsed_frame / (float)MILLIS(1));
-			SDL_RenderDebugTextFormat(context.renderer, 10, 40, "[TAB] reset ");
-			SDL_RenderDebugTextFormat(context.renderer, 10, 50, "[F1]  collisions        %s", DEBUG_separate_collisions   ? " ON" : "OFF");
-			SDL_RenderDebugTextFormat(context.renderer, 10, 60, "[F2]  render colliders  %s", DEBUG_render_colliders      ? " ON" : "OFF");
-			SDL_RenderDebugTextFormat(context.renderer, 10, 70, "[F3]  render tex border %s", DEBUG_render_texture_border ? " ON" : "OFF");
-			SDL_RenderDebugTextFormat(context.renderer, 10, 80, "[F4]  render textures   %s", DEBUG_render_texture        ? " ON" : "OFF");
+			SDL_RenderDebugTextFormat(context.renderer, 10, 20, "work     : %9.6f ms/f", (float)loop.elapsed_work  / (float)MILLIS(1));
+			SDL_RenderDebugTextFormat(context.renderer, 10, 30, "tot      : %9.6f ms/f", (float)loop.elapsed_frame / (float)MILLIS(1));
+			SDL_RenderDebugTextFormat(context.renderer, 10, 40, "latency  : %9.6f ms", (float)loop.latency_input / (float)MILLIS(1));
+			SDL_RenderDebugTextFormat(context.renderer, 10, 50, "[TAB] reset ");
+			SDL_RenderDebugTextFormat(context.renderer, 10, 60, "[F1]  collisions        %s", DEBUG_separate_collisions   ? " ON" : "OFF");
+			SDL_RenderDebugTextFormat(context.renderer, 10, 70, "[F2]  render colliders  %s", DEBUG_render_colliders      ? " ON" : "OFF");
+			SDL_RenderDebugTextFormat(context.renderer, 10, 80, "[F3]  render tex border %s", DEBUG_render_texture_border ? " ON" : "OFF");
+			SDL_RenderDebugTextFormat(context.renderer, 10, 90, "[F4]  render textures   %s", DEBUG_render_texture        ? " ON" : "OFF");
 		}
 #endif
 
-		// render
-		SDL_RenderPresent(context.renderer);
+		// wait and render
+		itu_lib_loop_frame_end(&loop);
 
-		context.delta = (float)elapsed_frame / (float)SECONDS(1);
+		context.delta = loop.delta;
 		context.uptime += context.delta;
-		walltime_frame_beg = walltime_frame_end;
 	}
 }
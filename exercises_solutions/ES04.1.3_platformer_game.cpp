@@ -27,7 +27,6 @@
 #define PHYSICS_TIMESTEP_NSECS  SECONDS(1) / 60
 #define PHYSICS_TIMESTEP_SECS   NS_TO_SECONDS(PHYSICS_TIMESTEP_NSECS)
 #define PHYSICS_MAX_TIMESTEPS_PER_FRAME 4
-#define PHYSICS_MAX_CONTACTS_PER_ENTITY 16
 
 #define WINDOW_W         800
 #define WINDOW_H         600
@@ -511,10 +510,8 @@ static void game_update_post_physics(SDLContext* context, GameState* state)
 		PlayerData* data = &state->player_data;
 	
 		
-		static b2ContactData* contact_data = (b2ContactData*)SDL_calloc(PHYSICS_MAX_CONTACTS_PER_ENTITY, sizeof(b2ContactData));
-	
 		int contacts = b2Body_GetContactCapacity(entity->body_id);
-		SDL_assert(contacts <= PHYSICS_MAX_CONTACTS_PER_ENTITY && "Max number of contacts exceeded. If this is not an error, increase PHYSICS_MAX_CONTACTS_PER_ENTITY");
+		b2ContactData* contact_data = arena_push_array(&context->arena_frame, b2ContactData, contacts);
 
 		int actual_contacts = b2Body_GetContactData(state->player->body_id, contact_data, contacts);
 
@@ -791,19 +788,14 @@ int main(void)
 	game_init(&context, &state);
 	game_reset(&context, &state);
 
-	SDL_Time walltime_frame_beg;
-	SDL_Time walltime_frame_end;
-	SDL_Time walltime_work_end;
-	SDL_Time elapsed_work = 0;
-	SDL_Time elapsed_frame = 0;
+	ITU_FrameLoop loop;
+	itu_lib_loop_init(&loop, context.renderer, TARGET_FRAMERATE_NS, ITU_LOOP_PACING_HYBRID);
 	SDL_Time accumulator_physics = 0;
 
-	SDL_GetCurrentTime(&walltime_frame_beg);
-	walltime_frame_end = walltime_frame_beg;
-
 	while(!quit)
 	{
 		// input
+		itu_lib_loop_frame_begin(&loop);
 		SDL_Event event;
 		sdl_input_clear(&context);
 		while(SDL_PollEvent(&event))
@@ -906,8 +898,9 @@ int main(void)
 			ImGui::Begin("itu_diagnostics");
 			ImGui::PushItemWidth(120);
 			ImGui::Text("Timing");
-			ImGui::LabelText("work", "%6.3f ms/f", (float)elapsed_work / (float)MILLIS(1));
-			ImGui::LabelText("tot", "%6.3f ms/f", (float)elapsed_frame / (float)MILLIS(1));
+			ImGui::LabelText("work", "%6.3f ms/f", (float)loop.elapsed_work / (float)MILLIS(1));
+			ImGui::LabelText("tot", "%6.3f ms/f", (float)loop.elapsed_frame / (float)MILLIS(1));
+			ImGui::LabelText("latency", "%6.3f ms", (float)loop.latency_input / (float)MILLIS(1));
 
 			ImGui::Text("Debug");
 			if(ImGui::Button("[TAB] reset"))
@@ -922,24 +915,12 @@ int main(void)
 		
 		itu_lib_imgui_frame_end(&context);
 
-		SDL_GetCurrentTime(&walltime_work_end);
-		elapsed_work = walltime_work_end - walltime_frame_beg;
-
-		if(elapsed_work < TARGET_FRAMERATE_NS)
-			SDL_DelayNS(TARGET_FRAMERATE_NS - elapsed_work);
-
-		SDL_GetCurrentTime(&walltime_frame_end);
-		elapsed_frame = walltime_frame_end - walltime_frame_beg;
-
-		// // NOTE: corrently rendering diagnostics through ImGui (see above)
-		// sdl_render_diagnostics(&context, elapsed_work, elapsed_frame);
-
-		// render
-		SDL_RenderPresent(context.renderer);
+		// wait and render
+		itu_lib_loop_frame_end(&loop);
+		itu_arena_reset(&context.arena_frame);
 
-		context.delta = (float)elapsed_frame / (float)SECONDS(1);
+		context.delta = loop.delta;
 		context.uptime += context.delta;
-		accumulator_physics += elapsed_frame;
-		walltime_frame_beg = walltime_frame_end;
+		accumulator_physics += loop.elapsed_frame;
 	}
 }
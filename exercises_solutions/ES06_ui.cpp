@@ -2,6 +2,8 @@
 #define CAMERA_PIXELS_PER_UNIT  32  // how many pixels of windows will be used to render a single world unit
 
 #define ENABLE_DIAGNOSTICS
+#define ITU_PROFILER_ENABLED
+#define ITU_MEMORY_TRACKING_ENABLED
 
 // rendering framerate
 #define TARGET_FRAMERATE_NS     (SECONDS(1) / 60)
@@ -344,27 +346,13 @@ void ex6_system_assign_player_target(SDLContext* context, ITU_EntityId* entity_i
 	if(!itu_entity_is_valid(id_player))
 		return;
 
-	EX6_PlayerData* player_data = entity_get_data(id_player, EX6_PlayerData);
+	EX6_PlayerData* player_data = entity_get_data_mut(id_player, EX6_PlayerData);
 	Transform* player_transform = entity_get_data(id_player, Transform);
 	vec2f player_pos = player_transform->position;
 
+	// NOTE: the spatial index only visits the cells around the player, instead of every asteroid
 	ITU_EntityId id_closest = ITU_ENTITY_ID_NULL;
-	float closest_distance_sq = FLOAT_MAX_VAL;
-
-	for(int i = 0; i < entity_ids_count; ++i)
-	{
-		ITU_EntityId id = entity_ids[i];
-
-		Transform*   transform = entity_get_data(id, Transform);
-
-		float curr_distance_sq = distance_sq(player_pos, transform->position);
-
-		if(curr_distance_sq < closest_distance_sq)
-		{
-			id_closest = id;
-			closest_distance_sq = curr_distance_sq;
-		}
-	}
+	itu_spatial_query_nearest(player_pos, 0, 1, 0, tag_mask(TAG_ASTEROID), &id_closest);
 
 	player_data->target = id_closest;
 }
@@ -374,9 +362,9 @@ void ex6_system_player_update(SDLContext* context, ITU_EntityId* entity_ids, int
 	for(int i = 0; i < entity_ids_count; ++i)
 	{
 		ITU_EntityId id = entity_ids[i];
-		Transform*      transform    = entity_get_data(id, Transform);
+		Transform*      transform    = entity_get_data_mut(id, Transform);
 		EX6_PlayerData* data         = entity_get_data(id, EX6_PlayerData);
-		PhysicsData*    physics_data = entity_get_data(id, PhysicsData);
+		PhysicsData*    physics_data = entity_get_data_mut(id, PhysicsData);
 
 		vec2f dir = VEC2F_ZERO;
 		if(context->btn_isdown[BTN_TYPE_UP])
@@ -434,6 +422,7 @@ static void game_init(SDLContext* context, GameState* state)
 	ttf_engine = TTF_CreateRendererTextEngine(context->renderer);
 
 	itu_sys_estorage_init(512);
+	itu_spatial_index_enable(4.0f);
 	itu_sys_physics_init(context);
 
 	enable_component(EX6_PlayerData);
@@ -453,7 +442,8 @@ static void game_init(SDLContext* context, GameState* state)
 	itu_sys_estorage_tag_set_debug_name(TAG_CAMERA_TARGET, "camera target");
 	itu_sys_estorage_tag_set_debug_name(TAG_ASTEROID, "asteroid");
 	
-	add_system(ex6_system_assign_player_target      , component_mask(Transform), tag_mask(TAG_ASTEROID));
+	// NOTE: asteroids are found through the spatial index, no need to keep a list of them
+	add_system_with_access(ex6_system_assign_player_target, component_mask(Transform), tag_mask(TAG_ASTEROID), 0, 0, ITU_SYSTEM_FLAG_QUERY);
 	add_system(ex6_system_player_update             , component_mask(Transform) | component_mask(PhysicsData) | component_mask(EX6_PlayerData)  , 0);
 	add_system(ex6_system_health                    , component_mask(EX6_HealthRenderer)  | component_mask(EX6_Sprite9Patch), 0);
 	add_system(ex6_system_sprite_render_camera      , component_mask(EX6_TransformScreen) | component_mask(Sprite)          , 0);
@@ -525,38 +515,44 @@ static void game_reset(SDLContext* context, GameState* state)
 	}
 
 	// entities
-	for(int i = 0; i < ENTITY_COUNT; ++i)
 	{
-		ITU_EntityId id = itu_entity_create();
-		char name_buf[16];
-		SDL_snprintf(name_buf, 16, "asteroid_%d", i);
-		itu_entity_set_debug_name(id, name_buf);
-
+		ITU_Prefab prefab_asteroid = { };
 		Transform transform = { 0 };
-		Sprite sprite;
-
 		transform.scale = VEC2F_ONE;
-		transform.position.x = SDL_randf() * 16 - 8;
-		transform.position.y = SDL_randf() * 16 - 8;
-
+		Sprite sprite;
 		itu_lib_sprite_init(&sprite, tex_space, itu_lib_sprite_get_rect(0, 4, 128, 128));
 
-		// FIXME this is thrash
-		PhysicsStaticData physics_data = { 0 };
-		body_def.position = value_cast(b2Vec2, transform.position);
-		body_def.type = b2_staticBody;
-		physics_data.body_id = itu_sys_physics_add_body(value_cast(void*, id), &body_def);
+		prefab_set_component(&prefab_asteroid, Transform, transform);
+		prefab_set_component(&prefab_asteroid, Sprite, sprite);
+		itu_prefab_component_set(&prefab_asteroid, component_type(PhysicsStaticData), NULL);
+		itu_prefab_component_set(&prefab_asteroid, component_type(ShapeData), NULL);
+		itu_prefab_tag_add(&prefab_asteroid, TAG_ASTEROID);
 
-		
-		ShapeData shape_data;
-		shape_data.shape_id = b2CreateCircleShape(physics_data.body_id, &shape_def, &circle);
-
-		entity_add_component(id, Transform,   transform);
-		entity_add_component(id, Sprite,      sprite);
-		entity_add_component(id, PhysicsStaticData, physics_data);
-		entity_add_component(id, ShapeData, shape_data);
-		itu_entity_tag_add(id, TAG_ASTEROID);
+		ITU_EntityId ids[ENTITY_COUNT];
+		itu_entity_create_batch(&prefab_asteroid, ENTITY_COUNT, ids);
+		itu_prefab_free(&prefab_asteroid);
 
+		// per-entity data
+		for(int i = 0; i < ENTITY_COUNT; ++i)
+		{
+			ITU_EntityId id = ids[i];
+			char name_buf[16];
+			SDL_snprintf(name_buf, 16, "asteroid_%d", i);
+			itu_entity_set_debug_name(id, name_buf);
+
+			Transform* transform = entity_get_data(id, Transform);
+			transform->position.x = SDL_randf() * 16 - 8;
+			transform->position.y = SDL_randf() * 16 - 8;
+
+			// FIXME this is thrash
+			PhysicsStaticData* physics_data = entity_get_data(id, PhysicsStaticData);
+			body_def.position = value_cast(b2Vec2, transform->position);
+			body_def.type = b2_staticBody;
+			physics_data->body_id = itu_sys_physics_add_body(value_cast(void*, id), &body_def);
+
+			ShapeData* shape_data = entity_get_data(id, ShapeData);
+			shape_data->shape_id = b2CreateCircleShape(physics_data->body_id, &shape_def, &circle);
+		}
 	}
 
 	// healtbar
@@ -617,6 +613,9 @@ static void game_reset(SDLContext* context, GameState* state)
 
 int main(void)
 {
+	// NOTE: must happen before anything is allocated
+	itu_memory_tracker_install();
+
 	bool quit = false;
 	SDLContext context = { 0 };
 	GameState  state   = { };
@@ -655,14 +654,8 @@ int main(void)
 	game_init(&context, &state);
 	game_reset(&context, &state);
 
-	SDL_Time walltime_frame_beg;
-	SDL_Time walltime_frame_end;
-	SDL_Time walltime_work_end;
-	SDL_Time elapsed_work = 0;
-	SDL_Time elapsed_frame = 0;
-
-	SDL_GetCurrentTime(&walltime_frame_beg);
-	walltime_frame_end = walltime_frame_beg;
+	ITU_FrameLoop loop;
+	itu_lib_loop_init(&loop, context.renderer, TARGET_FRAMERATE_NS, ITU_LOOP_PACING_HYBRID);
 
 	sdl_input_set_mapping_keyboard(&context, SDLK_W,     BTN_TYPE_UP);
 	sdl_input_set_mapping_keyboard(&context, SDLK_A,     BTN_TYPE_LEFT);
@@ -677,6 +670,7 @@ int main(void)
 
 	while(!quit)
 	{
+		itu_lib_loop_frame_begin(&loop);
 		quit = sdl_process_events(&context);
 
 		SDL_SetRenderDrawColor(context.renderer, 0x00, 0x00, 0x00, 0x00);
@@ -686,6 +680,7 @@ int main(void)
 
 		// update
 		itu_sys_estorage_systems_update(&context);
+		itu_lib_loop_frame_report(&loop, itu_sys_estorage_timings_last_total(), itu_sys_estorage_phase_runs_count(ITU_SYSTEM_PHASE_FIXED_UPDATE));
 #ifdef ENABLE_DIAGNOSTICS
 		{
 			//ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4 { 33/255.0f, 33/255.0f, 33/255.0f, 255/255.0f });
@@ -698,10 +693,34 @@ int main(void)
 					{
 						//ImGui::Begin("itu_diagnostics");
 						ImGui::Text("Timing");
-						ImGui::LabelText("work", "%6.3f ms/f", (float)elapsed_work  / (float)MILLIS(1));
-						ImGui::LabelText("tot",  "%6.3f ms/f", (float)elapsed_frame / (float)MILLIS(1));
-						ImGui::LabelText("physics steps",  "%d", context.physics_steps_count);
+						ImGui::LabelText("work", "%6.3f ms/f", (float)loop.elapsed_work  / (float)MILLIS(1));
+						ImGui::LabelText("tot",  "%6.3f ms/f", (float)loop.elapsed_frame / (float)MILLIS(1));
+						ImGui::LabelText("latency", "%6.3f ms", (float)loop.latency_input / (float)MILLIS(1));
+						ImGui::LabelText("late by", "%6.3f ms", (float)loop.deadline_error / (float)MILLIS(1));
 
+						int pacing = loop.pacing;
+						if(ImGui::Combo("pacing", &pacing, itu_lib_loop_pacing_names, ITU_LOOP_PACING_MAX))
+							itu_lib_loop_set_pacing(&loop, (ITU_LoopPacing)pacing);
+						ImGui::LabelText("physics steps",  "%d", itu_sys_estorage_phase_runs_count(ITU_SYSTEM_PHASE_FIXED_UPDATE));
+
+						ImGui::Text("Memory");
+						ImGui::LabelText("frame arena", "%6.1f KB (peak %.1f KB)", (float)itu_arena_used(&context.arena_frame) / KB(1), (float)context.arena_frame.used_peak / KB(1));
+
+						ImGui::EndTabItem();
+					}
+					if(ImGui::BeginTabItem("Frame stats"))
+					{
+						itu_debug_ui_render_frame_stats(&loop);
+						ImGui::EndTabItem();
+					}
+					if(ImGui::BeginTabItem("Profiler"))
+					{
+						itu_debug_ui_render_profiler();
+						ImGui::EndTabItem();
+					}
+					if(ImGui::BeginTabItem("Memory"))
+					{
+						itu_debug_ui_render_memory();
 						ImGui::EndTabItem();
 					}
 					if(ImGui::BeginTabItem("Entities"))
@@ -724,21 +743,16 @@ int main(void)
 
 		itu_lib_imgui_frame_end(&context);
 
-		SDL_GetCurrentTime(&walltime_work_end);
-		elapsed_work = walltime_work_end - walltime_frame_beg;
-
-		if(elapsed_work < TARGET_FRAMERATE_NS)
-			SDL_DelayNS(TARGET_FRAMERATE_NS - elapsed_work);
-
-		SDL_GetCurrentTime(&walltime_frame_end);
-		elapsed_frame = walltime_frame_end - walltime_frame_beg;
+		// wait and render
+		// (on hitches, also log where the time went, system by system)
+		if(itu_lib_loop_frame_end(&loop))
+			itu_sys_estorage_timings_last_log();
+		itu_arena_reset(&context.arena_frame);
 
-		// render
-		SDL_RenderPresent(context.renderer);
-
-		context.delta = (float)elapsed_frame / (float)SECONDS(1);
+		context.delta = loop.delta;
 		context.uptime += context.delta;
-		context.elapsed_frame = elapsed_frame;
-		walltime_frame_beg = walltime_frame_end;
+		context.elapsed_frame = loop.elapsed_frame;
 	}
+
+	itu_memory_tracker_report_leaks();
 }
@@ -5,6 +5,7 @@
 #include <SDL3/SDL_log.h>    // SDL_Log()
 #include <SDL3/SDL_error.h>  // SDL_Error()
 #include <SDL3/SDL_stdinc.h> // SDL_assert(), all math functions and macros
+#include <SDL3/SDL_intrin.h> // compiler intrinsics (needed for _BitScanForward64 on MSVC)
 #endif
 
 // *******************************************************************
@@ -47,6 +48,22 @@
 // indexes a void* array with the given size
 #define pointer_index(pointer, i, elem_size) (((unsigned char*)(pointer) + (i)*(elem_size)))
 
+// returns the index of the lowest bit set in `mask`
+// NOTE: `mask` must NOT be 0
+// NOTE: useful to iterate only over the bits that are set:
+//       while(mask) { int i = bit_index_lowest(mask); /* ... */ mask &= mask - 1; }
+static inline int bit_index_lowest(Uint64 mask)
+{
+	SDL_assert(mask != 0);
+#ifdef _MSC_VER
+	unsigned long ret;
+	_BitScanForward64(&ret, mask);
+	return (int)ret;
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
 // effectively checks if `var` is of the given type `T`
 // To be more precise, checks if the compiler can safely cast `var` to `T`.
 // Unless you're doing something very weird, if you use this with non-integral(ie, structs) value types this will work as intended
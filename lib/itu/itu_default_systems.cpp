@@ -10,71 +10,668 @@
 #define PHYSICS_MAX_TIMESTEPS_PER_FRAME 4
 #endif
 
+// NOTE: sprite rendering and physics iterate their own queries: they are registered with `ITU_SYSTEM_FLAG_QUERY`,
+//       so their entity list is always empty
 void itu_system_sprite_render(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count)
 {
-	for(int i = 0; i < entity_ids_count; ++i)
+	itu_query<Transform, Sprite> query;
+	while(query.next())
 	{
-		ITU_EntityId id = entity_ids[i];
-		Transform* transform = entity_get_data(id, Transform);
-		Sprite*    sprite = entity_get_data(id, Sprite);
+		Transform* transforms = query.column_read<Transform>();
+		Sprite*    sprites    = query.column_read<Sprite>();
+		for(int i = 0; i < query.count(); ++i)
+			itu_lib_sprite_render(context, &sprites[i], &transforms[i]);
+	}
+}
 
-		itu_lib_sprite_render(context, sprite, transform);
+void itu_system_sprite_compact_render(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count)
+{
+	itu_query<Transform, SpriteCompact> query;
+	while(query.next())
+	{
+		Transform*     transforms = query.column_read<Transform>();
+		SpriteCompact* sprites    = query.column_read<SpriteCompact>();
+		for(int i = 0; i < query.count(); ++i)
+			itu_lib_sprite_compact_render(context, &sprites[i], &transforms[i]);
 	}
 }
 
-void itu_system_physics(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count)
+// transform hierarchy
+// every entity with a `TransformParent` is a node. Nodes are kept sorted by depth in contiguous arrays, so that
+// a single linear pass processes every parent before its children. The order is rebuilt only when the hierarchy changes
+struct ITU_TransformNode
+{
+	ITU_EntityId id;
+	ITU_EntityId parent;
+	Sint32 parent_node; // index of the parent in `nodes`, or -1 if the parent has no `TransformParent` (it's a root)
+};
+
+struct ITU_TransformHierarchyContext
+{
+	stbds_arr(ITU_TransformNode) nodes;
+	stbds_arr(Transform) worlds; // world transform of every node (same order as `nodes`)
+	stbds_arr(bool) dirty;       // world transform of the node was recomputed this frame (so children need to be too)
+
+	Uint32 version;       // bumped every time a parent changes
+	Uint32 version_built; // `version` at the time `nodes` was built
+};
+
+// every world has its own hierarchy (see `ITU_World`)
+ITU_TransformHierarchyContext* itu_world_transform_hierarchy();
+#define ctx_hierarchy (*itu_world_transform_hierarchy())
+
+Transform itu_transform_compose(Transform* parent, Transform* local)
+{
+	Transform ret;
+	ret.position = parent->position + rotate(mul_element_wise(local->position, parent->scale), parent->rotation);
+	ret.scale    = mul_element_wise(parent->scale, local->scale);
+	ret.rotation = parent->rotation + local->rotation;
+	return ret;
+}
+
+void itu_transform_set_parent(ITU_EntityId child, ITU_EntityId parent, Transform local)
+{
+	SDL_assert(itu_entity_is_valid(child));
+
+	TransformParent* data = entity_get_data_mut(child, TransformParent);
+	if(!itu_entity_is_valid(parent))
+	{
+		// the world transform cache stays as it is, so the child stays where it was
+		// NOTE: deferred, so it can be called from a system (applied right away outside of `itu_sys_estorage_systems_update`)
+		if(data)
+			itu_entity_deferred_component_remove(child, component_type(TransformParent));
+		ctx_hierarchy.version++;
+		return;
+	}
+
+	// no cycles allowed
+	ITU_EntityId ancestor = parent;
+	for(int depth = 0; itu_entity_is_valid(ancestor); ++depth)
+	{
+		SDL_assert(!itu_entity_equals(ancestor, child) && depth < TRANSFORM_HIERARCHY_DEPTH_MAX);
+		TransformParent* data_ancestor = entity_get_data(ancestor, TransformParent);
+		if(!data_ancestor)
+			break;
+		ancestor = data_ancestor->parent;
+	}
+
+	if(data)
+	{
+		data->parent = parent;
+		data->local = local;
+	}
+	else
+	{
+		TransformParent data_new = { parent, local };
+		entity_add_component_deferred(child, TransformParent, data_new);
+	}
+	ctx_hierarchy.version++;
+}
+
+void itu_transform_hierarchy_rebuild(ITU_EntityId* entity_ids, int entity_ids_count)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	stbds_arrsetlen(ctx_hierarchy.nodes , entity_ids_count);
+	stbds_arrsetlen(ctx_hierarchy.worlds, entity_ids_count);
+	stbds_arrsetlen(ctx_hierarchy.dirty , entity_ids_count);
+
+	// depth of every node (counting only ancestors that are nodes themselves)
+	ITU_ArenaTemp scratch = itu_arena_scratch_begin();
+	Sint32* depths = arena_push_array(scratch.arena, Sint32, entity_ids_count);
+	int depths_count[TRANSFORM_HIERARCHY_DEPTH_MAX + 1] = { 0 };
+	for(int i = 0; i < entity_ids_count; ++i)
+	{
+		int depth = 0;
+		ITU_EntityId ancestor = entity_get_data(entity_ids[i], TransformParent)->parent;
+		while(itu_entity_is_valid(ancestor))
+		{
+			TransformParent* data_ancestor = entity_get_data(ancestor, TransformParent);
+			if(!data_ancestor)
+				break;
+			depth++;
+			ancestor = data_ancestor->parent;
+			SDL_assert(depth < TRANSFORM_HIERARCHY_DEPTH_MAX);
+		}
+		depths[i] = depth;
+		depths_count[depth + 1]++;
+	}
+
+	// counting sort by depth
+	for(int i = 1; i <= TRANSFORM_HIERARCHY_DEPTH_MAX; ++i)
+		depths_count[i] += depths_count[i - 1];
+
+	stbds_hm(Uint32, Sint32) node_map = NULL; // maps EntityId.index to the node index
 	for(int i = 0; i < entity_ids_count; ++i)
 	{
-		ITU_EntityId id = entity_ids[i];
-		PhysicsData* physics_data = entity_get_data(id, PhysicsData);
+		int node_idx = depths_count[depths[i]]++;
+		ITU_TransformNode* node = &ctx_hierarchy.nodes[node_idx];
+		node->id = entity_ids[i];
+		node->parent = entity_get_data(entity_ids[i], TransformParent)->parent;
+		stbds_hmput(node_map, entity_ids[i].index, node_idx);
+	}
 
-		b2Body_SetLinearVelocity(physics_data->body_id, value_cast(b2Vec2, physics_data->velocity));
-		b2Body_SetAngularVelocity(physics_data->body_id, physics_data->torque);
+	for(int i = 0; i < entity_ids_count; ++i)
+	{
+		ITU_TransformNode* node = &ctx_hierarchy.nodes[i];
+		ptrdiff_t map_idx = itu_entity_is_valid(node->parent) ? stbds_hmgeti(node_map, node->parent.index) : -1;
+		node->parent_node = map_idx >= 0 ? node_map[map_idx].value : -1;
 	}
 
-	context->physics_steps_count = 0;
-	context->accumulator_physics += context->elapsed_frame;
+	stbds_hmfree(node_map);
+	itu_arena_scratch_end(scratch);
+	ctx_hierarchy.version_built = ctx_hierarchy.version;
+}
+
+void itu_system_transform_hierarchy(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count)
+{
+	bool rebuild = ctx_hierarchy.version_built != ctx_hierarchy.version || entity_ids_count != stbds_arrlen(ctx_hierarchy.nodes);
+	for(int i = 0; !rebuild && i < entity_ids_count; ++i)
+		rebuild = !itu_entity_matches(ctx_hierarchy.nodes[i].id, component_mask(TransformParent), 0);
+
+	Uint32 tick_last_run = itu_sys_estorage_system_tick_last_run();
+	if(rebuild)
+	{
+		itu_transform_hierarchy_rebuild(entity_ids, entity_ids_count);
+		tick_last_run = 0; // recompute everything
+	}
 
-	// decouple physics step from framerate, running 0, 1 or multiple physics step per frame
-	while(context->accumulator_physics >= PHYSICS_TIMESTEP_NSECS && context->physics_steps_count < PHYSICS_MAX_TIMESTEPS_PER_FRAME)
+	for(int i = 0; i < stbds_arrlen(ctx_hierarchy.nodes); ++i)
 	{
-		itu_sys_physics_step(PHYSICS_TIMESTEP_SECS);
-		context->physics_steps_count++;
-		context->accumulator_physics -= PHYSICS_TIMESTEP_NSECS;
+		ITU_TransformNode* node = &ctx_hierarchy.nodes[i];
+		TransformParent* data = entity_get_data(node->id, TransformParent);
 
-		// update game state from b2d state, interpolating when physics step is out of synch with game logic
-		// NOTE: we need to read the b2d state every step in order to get a correct interpolation, even if it's wasteful
-		//       (there is definitely a way to adjust `t` and `t_inv` based on the numbers of steps done and do the reading only once,
-		//       marking it as a TODO for the future)
-		float t = (float)(context->accumulator_physics) / (float)PHYSICS_TIMESTEP_NSECS;
-		float t_inv = 1 - t;
+		// parent changed without going through `itu_transform_set_parent`, rebuild next frame
+		if(!itu_entity_equals(data->parent, node->parent))
+			ctx_hierarchy.version++;
 
-		for(int i = 0; i < entity_ids_count; ++i)
+		bool dirty = itu_entity_changed_tick(node->id, component_type(TransformParent)) > tick_last_run;
+		Transform* world_parent;
+		if(node->parent_node >= 0)
+		{
+			world_parent = &ctx_hierarchy.worlds[node->parent_node];
+			dirty |= ctx_hierarchy.dirty[node->parent_node];
+		}
+		else
 		{
-			ITU_EntityId id = entity_ids[i];
-			Transform*  transform = entity_get_data(id, Transform);
-			PhysicsData* physics_data = entity_get_data(id, PhysicsData);
+			// NOTE: if the parent is gone (or has no `Transform`) the node just stays where it is
+			world_parent = itu_entity_is_valid(node->parent) ? entity_get_data(node->parent, Transform) : NULL;
+			if(!world_parent)
+			{
+				ctx_hierarchy.worlds[i] = *entity_get_data(node->id, Transform);
+				ctx_hierarchy.dirty[i] = false;
+				continue;
+			}
+			dirty |= itu_entity_changed_tick(node->parent, component_type(Transform)) > tick_last_run;
+		}
+
+		ctx_hierarchy.dirty[i] = dirty;
+		if(!dirty)
+			continue;
+
+		ctx_hierarchy.worlds[i] = itu_transform_compose(world_parent, &data->local);
+		*entity_get_data_mut(node->id, Transform) = ctx_hierarchy.worlds[i];
+	}
+}
+
+// spatial index
+// optional uniform grid over `Transform` positions, for "entities near X" queries that don't scan every entity.
+// Cells live in a hash map (so the world has no bounds) and store a copy of the positions of their entities.
+// `itu_system_spatial_index` moves only the entities whose `Transform` changed since its last update.
+// Destroyed entities (and entities that lost their `Transform`) are not removed right away: queries skip them,
+// and they are dropped when their index is reused
+struct ITU_SpatialItem
+{
+	ITU_EntityId id;
+	vec2f position;
+};
+
+struct ITU_SpatialCell
+{
+	Sint32 x, y; // cell coordinates
+	stbds_arr(ITU_SpatialItem) items;
+};
+
+struct ITU_SpatialEntry
+{
+	Sint32 cell; // -1 if the entity is not in the index
+	Sint32 slot; // location in the cell's `items`
+};
+
+struct ITU_SpatialIndexContext
+{
+	float cell_size; // 0 if the index is disabled
+	stbds_hm(Uint64, Sint32) cells_map; // maps cell coordinates to the cell index in `cells`
+	stbds_arr(ITU_SpatialCell) cells;
+	stbds_arr(ITU_SpatialEntry) entries; // indexed by EntityId.index
+
+	// bounding box of the non-empty cells (in cell coordinates), so that queries don't visit empty space.
+	// Grows as cells are used, and shrinks back on every update
+	Sint32 cell_min_x, cell_min_y;
+	Sint32 cell_max_x, cell_max_y;
+
+	Uint32 tick_built; // storage tick of the last update (0 to reindex everything)
+	bool system_added; // `itu_system_spatial_index` is added to the world the first time the index is enabled
+};
+
+// every world has its own index (see `ITU_World`)
+ITU_SpatialIndexContext* itu_world_spatial_index();
+#define ctx_spatial (*itu_world_spatial_index())
+
+void itu_spatial_index_clear()
+{
+	for(int i = 0; i < stbds_arrlen(ctx_spatial.cells); ++i)
+		stbds_arrfree(ctx_spatial.cells[i].items);
+	stbds_arrfree(ctx_spatial.cells);
+	stbds_hmfree(ctx_spatial.cells_map);
+	stbds_arrfree(ctx_spatial.entries);
+	ctx_spatial.cell_min_x = ctx_spatial.cell_min_y = SDL_MAX_SINT32;
+	ctx_spatial.cell_max_x = ctx_spatial.cell_max_y = SDL_MIN_SINT32;
+	ctx_spatial.tick_built = 0;
+}
+
+void itu_system_spatial_index(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count);
+
+void itu_spatial_index_enable(float cell_size)
+{
+	SDL_assert(cell_size > 0);
+	itu_spatial_index_clear();
+	ctx_spatial.cell_size = cell_size;
+
+	// NOTE: it stays there when the index is disabled (it doesn't do anything then)
+	if(!ctx_spatial.system_added)
+	{
+		itu_sys_estorage_add_system({
+			"itu_system_spatial_index", itu_system_spatial_index, component_mask(Transform), 0,
+			component_mask(Transform), 0, ITU_SYSTEM_FLAG_QUERY, ITU_SYSTEM_PHASE_INPUT
+		});
+		ctx_spatial.system_added = true;
+	}
+}
+
+void itu_spatial_index_disable()
+{
+	itu_spatial_index_clear();
+	ctx_spatial.cell_size = 0;
+}
+
+bool itu_spatial_index_enabled()
+{
+	return ctx_spatial.cell_size > 0;
+}
+
+// NOTE: clamped, so that huge query areas don't overflow
+inline Sint32 itu_spatial_cell_coord(float value)
+{
+	float ret = SDL_floorf(value / ctx_spatial.cell_size);
+	return (Sint32)SDL_clamp(ret, -(float)(1 << 30), (float)(1 << 30));
+}
+
+inline Uint64 itu_spatial_cell_key(Sint32 x, Sint32 y)
+{
+	return ((Uint64)(Uint32)x << 32) | (Uint32)y;
+}
+
+// returns -1 if the cell doesn't exist
+inline Sint32 itu_spatial_cell_find(Sint32 x, Sint32 y)
+{
+	Uint64 key = itu_spatial_cell_key(x, y);
+	int loc = stbds_hmgeti(ctx_spatial.cells_map, key);
+	return loc >= 0 ? ctx_spatial.cells_map[loc].value : -1;
+}
+
+Sint32 itu_spatial_cell_get_or_create(Sint32 x, Sint32 y)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	Sint32 ret = itu_spatial_cell_find(x, y);
+	if(ret >= 0)
+		return ret;
+
+	ret = stbds_arrlen(ctx_spatial.cells);
+	ITU_SpatialCell cell = { x, y };
+	stbds_arrput(ctx_spatial.cells, cell);
+	Uint64 key = itu_spatial_cell_key(x, y);
+	stbds_hmput(ctx_spatial.cells_map, key, ret);
+	return ret;
+}
+
+void itu_spatial_bounds_add(Sint32 x, Sint32 y)
+{
+	ctx_spatial.cell_min_x = SDL_min(ctx_spatial.cell_min_x, x);
+	ctx_spatial.cell_min_y = SDL_min(ctx_spatial.cell_min_y, y);
+	ctx_spatial.cell_max_x = SDL_max(ctx_spatial.cell_max_x, x);
+	ctx_spatial.cell_max_y = SDL_max(ctx_spatial.cell_max_y, y);
+}
+
+// shrinks the bounds to the cells that still have something in them
+// NOTE: empty cells are kept (in the map), entities tend to come back to the same places
+void itu_spatial_bounds_rebuild()
+{
+	ctx_spatial.cell_min_x = ctx_spatial.cell_min_y = SDL_MAX_SINT32;
+	ctx_spatial.cell_max_x = ctx_spatial.cell_max_y = SDL_MIN_SINT32;
+	for(int i = 0; i < stbds_arrlen(ctx_spatial.cells); ++i)
+		if(stbds_arrlen(ctx_spatial.cells[i].items) > 0)
+			itu_spatial_bounds_add(ctx_spatial.cells[i].x, ctx_spatial.cells[i].y);
+}
+
+void itu_spatial_index_remove(Uint32 entity_index)
+{
+	ITU_SpatialEntry* entry = &ctx_spatial.entries[entity_index];
+	ITU_SpatialCell* cell = &ctx_spatial.cells[entry->cell];
+
+	// swap with last
+	ITU_SpatialItem* last = &stbds_arrlast(cell->items);
+	ctx_spatial.entries[last->id.index].slot = entry->slot;
+	cell->items[entry->slot] = *last;
+	stbds_arrpop(cell->items);
+
+	entry->cell = -1;
+}
+
+void itu_spatial_index_update(ITU_EntityId id, vec2f position)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	int entries_count = stbds_arrlen(ctx_spatial.entries);
+	if(id.index >= entries_count)
+	{
+		stbds_arrsetlen(ctx_spatial.entries, id.index + 1);
+		for(int i = entries_count; i <= id.index; ++i)
+			ctx_spatial.entries[i].cell = -1;
+	}
+
+	Sint32 cell = itu_spatial_cell_get_or_create(itu_spatial_cell_coord(position.x), itu_spatial_cell_coord(position.y));
+	ITU_SpatialEntry* entry = &ctx_spatial.entries[id.index];
+	if(entry->cell == cell)
+	{
+		// NOTE: the id is overwritten too, the slot could still belong to a destroyed entity with the same index
+		ITU_SpatialItem* item = &ctx_spatial.cells[cell].items[entry->slot];
+		item->id = id;
+		item->position = position;
+		return;
+	}
+
+	if(entry->cell >= 0)
+		itu_spatial_index_remove(id.index);
+
+	ITU_SpatialItem item = { id, position };
+	entry->cell = cell;
+	entry->slot = stbds_arrlen(ctx_spatial.cells[cell].items);
+	stbds_arrput(ctx_spatial.cells[cell].items, item);
+	itu_spatial_bounds_add(ctx_spatial.cells[cell].x, ctx_spatial.cells[cell].y);
+}
+
+void itu_system_spatial_index(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count)
+{
+	if(!itu_spatial_index_enabled())
+		return;
+
+	Uint32 tick = itu_sys_estorage_tick();
+	int moved_count = 0;
+	itu_query<Transform> query;
+	query.changed(component_mask(Transform), ctx_spatial.tick_built);
+	while(query.next())
+	{
+		Transform* transforms = query.column_read<Transform>();
+		ITU_EntityId* ids = query.entity_ids();
+		for(int i = 0; i < query.count(); ++i)
+			itu_spatial_index_update(ids[i], transforms[i].position);
+		moved_count += query.count();
+	}
+	ctx_spatial.tick_built = tick;
+
+	// entities may have left the cells at the border
+	if(moved_count > 0)
+		itu_spatial_bounds_rebuild();
+}
+
+// `Transform` is always required, so that entities that lost it are skipped
+inline bool itu_spatial_item_matches(ITU_SpatialItem* item, Uint64 component_mask, Uint64 tag_mask)
+{
+	return itu_entity_matches(item->id, component_mask | component_mask(Transform), tag_mask);
+}
+
+int itu_spatial_query_rect(vec2f min, vec2f max, Uint64 component_mask, Uint64 tag_mask, ITU_EntityId* out_ids, int out_ids_max)
+{
+	SDL_assert(itu_spatial_index_enabled());
+
+	Sint32 x_min = SDL_max(itu_spatial_cell_coord(min.x), ctx_spatial.cell_min_x);
+	Sint32 y_min = SDL_max(itu_spatial_cell_coord(min.y), ctx_spatial.cell_min_y);
+	Sint32 x_max = SDL_min(itu_spatial_cell_coord(max.x), ctx_spatial.cell_max_x);
+	Sint32 y_max = SDL_min(itu_spatial_cell_coord(max.y), ctx_spatial.cell_max_y);
+
+	int ret = 0;
+	for(Sint32 y = y_min; y <= y_max; ++y)
+	for(Sint32 x = x_min; x <= x_max; ++x)
+	{
+		Sint32 cell = itu_spatial_cell_find(x, y);
+		if(cell < 0)
+			continue;
+
+		stbds_arr(ITU_SpatialItem) items = ctx_spatial.cells[cell].items;
+		for(int i = 0; i < stbds_arrlen(items); ++i)
+		{
+			ITU_SpatialItem* item = &items[i];
+			bool inside = item->position.x >= min.x && item->position.x <= max.x && item->position.y >= min.y && item->position.y <= max.y;
+			if(!inside || !itu_spatial_item_matches(item, component_mask, tag_mask))
+				continue;
+
+			out_ids[ret++] = item->id;
+			if(ret == out_ids_max)
+				return ret;
+		}
+	}
+	return ret;
+}
+
+int itu_spatial_query_radius(vec2f center, float radius, Uint64 component_mask, Uint64 tag_mask, ITU_EntityId* out_ids, int out_ids_max)
+{
+	SDL_assert(itu_spatial_index_enabled());
+
+	Sint32 x_min = SDL_max(itu_spatial_cell_coord(center.x - radius), ctx_spatial.cell_min_x);
+	Sint32 y_min = SDL_max(itu_spatial_cell_coord(center.y - radius), ctx_spatial.cell_min_y);
+	Sint32 x_max = SDL_min(itu_spatial_cell_coord(center.x + radius), ctx_spatial.cell_max_x);
+	Sint32 y_max = SDL_min(itu_spatial_cell_coord(center.y + radius), ctx_spatial.cell_max_y);
+	float radius_sq = radius * radius;
+
+	int ret = 0;
+	for(Sint32 y = y_min; y <= y_max; ++y)
+	for(Sint32 x = x_min; x <= x_max; ++x)
+	{
+		Sint32 cell = itu_spatial_cell_find(x, y);
+		if(cell < 0)
+			continue;
+
+		stbds_arr(ITU_SpatialItem) items = ctx_spatial.cells[cell].items;
+		for(int i = 0; i < stbds_arrlen(items); ++i)
+		{
+			ITU_SpatialItem* item = &items[i];
+			if(distance_sq(center, item->position) > radius_sq || !itu_spatial_item_matches(item, component_mask, tag_mask))
+				continue;
+
+			out_ids[ret++] = item->id;
+			if(ret == out_ids_max)
+				return ret;
+		}
+	}
+	return ret;
+}
+
+int itu_spatial_query_nearest(vec2f center, float radius_max, int k, Uint64 component_mask, Uint64 tag_mask, ITU_EntityId* out_ids)
+{
+	SDL_assert(itu_spatial_index_enabled());
+	SDL_assert(k > 0 && k <= SPATIAL_QUERY_NEAREST_MAX);
+
+	// best `k` found so far, sorted by distance
+	float distances_sq[SPATIAL_QUERY_NEAREST_MAX];
+	int ret = 0;
+
+	if(radius_max <= 0)
+		radius_max = (float)(1 << 30) * ctx_spatial.cell_size;
+	float radius_max_sq = radius_max * radius_max;
+	Sint32 cx = itu_spatial_cell_coord(center.x);
+	Sint32 cy = itu_spatial_cell_coord(center.y);
+
+	// visit rings of cells around the center one, moving outwards.
+	// Everything in ring `r` is at least `(r - 1) * cell_size` away, so we can stop as soon as that's farther than
+	// the k-th best (or than `radius_max`), or when the ring doesn't touch any cell ever used
+	for(Sint32 r = 0; ; ++r)
+	{
+		float ring_distance = (r - 1) * ctx_spatial.cell_size;
+		if(r > 0 && (ring_distance > radius_max || (ret == k && ring_distance * ring_distance >= distances_sq[k - 1])))
+			break;
+		if(cx - r < ctx_spatial.cell_min_x && cx + r > ctx_spatial.cell_max_x && cy - r < ctx_spatial.cell_min_y && cy + r > ctx_spatial.cell_max_y)
+			break;
+
+		// NOTE: ring 0 is just the center cell, the others are walked one side at a time
+		int ring_cells_count = r == 0 ? 1 : 8 * r;
+		for(int c = 0; c < ring_cells_count; ++c)
+		{
+			Sint32 x, y;
+			if(r == 0)                { x = cx                    ; y = cy; }
+			else if(c < 2 * r + 1)    { x = cx - r + c            ; y = cy - r; }
+			else if(c < 4 * r + 2)    { x = cx - r + c - (2*r + 1); y = cy + r; }
+			else if(c < 6 * r + 1)    { x = cx - r                ; y = cy - r + 1 + c - (4*r + 2); }
+			else                      { x = cx + r                ; y = cy - r + 1 + c - (6*r + 1); }
+
+			if(x < ctx_spatial.cell_min_x || x > ctx_spatial.cell_max_x || y < ctx_spatial.cell_min_y || y > ctx_spatial.cell_max_y)
+				continue;
+			Sint32 cell = itu_spatial_cell_find(x, y);
+			if(cell < 0)
+				continue;
+
+			stbds_arr(ITU_SpatialItem) items = ctx_spatial.cells[cell].items;
+			for(int i = 0; i < stbds_arrlen(items); ++i)
+			{
+				ITU_SpatialItem* item = &items[i];
+				float curr_distance_sq = distance_sq(center, item->position);
+				if(curr_distance_sq > radius_max_sq || (ret == k && curr_distance_sq >= distances_sq[k - 1]))
+					continue;
+				if(!itu_spatial_item_matches(item, component_mask, tag_mask))
+					continue;
+
+				// insertion sort, `k` is small
+				int loc = ret < k ? ret++ : k - 1;
+				for(; loc > 0 && distances_sq[loc - 1] > curr_distance_sq; --loc)
+				{
+					distances_sq[loc] = distances_sq[loc - 1];
+					out_ids[loc] = out_ids[loc - 1];
+				}
+				distances_sq[loc] = curr_distance_sq;
+				out_ids[loc] = item->id;
+			}
+		}
+	}
+	return ret;
+}
+
+void itu_system_physics(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count)
+{
+	// only push to b2d what game code touched since the last time we ran
+	// (our own writes below happen during the same tick, so they don't count)
+	// NOTE: new bodies always show up here (adding a component counts as a change), so this is also
+	//       where they get their `PhysicsInterpolation`. It's a deferred add (we are iterating, and systems are updating),
+	//       so they start being interpolated from the next step, starting from the current state of the body
+	itu_query<PhysicsData> query_physics;
+	query_physics.changed(component_mask(PhysicsData), itu_sys_estorage_system_tick_last_run());
+	while(query_physics.next())
+	{
+		PhysicsData* physics_datas = query_physics.column_read<PhysicsData>();
+		ITU_EntityId* ids = query_physics.entity_ids();
+		for(int i = 0; i < query_physics.count(); ++i)
+		{
+			b2BodyId body_id = physics_datas[i].body_id;
+			if(!entity_get_data(ids[i], PhysicsInterpolation))
+			{
+				PhysicsInterpolation interpolation = { };
+				if(B2_IS_NON_NULL(body_id))
+				{
+					interpolation.fixed_step_position = value_cast(vec2f, b2Body_GetPosition(body_id));
+					interpolation.fixed_step_rotation = b2Rot_GetAngle(b2Body_GetRotation(body_id));
+				}
+				entity_add_component_deferred(ids[i], PhysicsInterpolation, interpolation);
+			}
+
+			// no body yet (e.g. just loaded from a snapshot)
+			if(B2_IS_NULL(body_id))
+				continue;
+
+			b2Body_SetLinearVelocity(body_id, value_cast(b2Vec2, physics_datas[i].velocity));
+			b2Body_SetAngularVelocity(body_id, physics_datas[i].torque);
+		}
+	}
+
+	// NOTE: this runs in `ITU_SYSTEM_PHASE_FIXED_UPDATE`, so once per physics step
+	itu_sys_physics_step(PHYSICS_TIMESTEP_SECS);
+
+	// update game state from b2d state, interpolating when physics step is out of synch with game logic
+	// NOTE: we need to read the b2d state every step in order to get a correct interpolation, even if it's wasteful
+	//       (there is definitely a way to adjust `t` and `t_inv` based on the numbers of steps done and do the reading only once,
+	//       marking it as a TODO for the future)
+	float t = itu_sys_estorage_phase_alpha(ITU_SYSTEM_PHASE_FIXED_UPDATE);
+	float t_inv = 1 - t;
+
+	itu_query<Transform, PhysicsData, PhysicsInterpolation> query;
+	while(query.next())
+	{
+		Transform*            transforms     = query.column<Transform>();
+		PhysicsData*          physics_datas  = query.column<PhysicsData>();
+		PhysicsInterpolation* interpolations = query.column<PhysicsInterpolation>();
+		for(int i = 0; i < query.count(); ++i)
+		{
+			Transform*            transform     = &transforms[i];
+			PhysicsData*          physics_data  = &physics_datas[i];
+			PhysicsInterpolation* interpolation = &interpolations[i];
+			if(B2_IS_NULL(physics_data->body_id))
+				continue;
 
 			b2Vec2 physics_vel = b2Body_GetLinearVelocity(physics_data->body_id);
 			float  physics_trq = b2Body_GetAngularVelocity(physics_data->body_id);
 			b2Vec2 physics_pos = b2Body_GetPosition(physics_data->body_id);
 			b2Rot  physics_rot = b2Body_GetRotation(physics_data->body_id);
 
-			physics_data->velocity = value_cast(vec2f, physics_vel) * t + physics_data->fixed_step_velocity * t_inv;
-			physics_data->torque   = physics_trq * t + physics_data->fixed_step_torque * t_inv;
+			physics_data->velocity = value_cast(vec2f, physics_vel) * t + interpolation->fixed_step_velocity * t_inv;
+			physics_data->torque   = physics_trq * t + interpolation->fixed_step_torque * t_inv;
 
 
 			if(!physics_data->ignore_position)
-				transform->position = value_cast(vec2f, physics_pos) * t + physics_data->fixed_step_position * t_inv;
+				transform->position = value_cast(vec2f, physics_pos) * t + interpolation->fixed_step_position * t_inv;
 
 			if(!physics_data->ignore_rotation)
-				transform->rotation = b2Rot_GetAngle(physics_rot) * t + physics_data->fixed_step_rotation * t_inv;
+				transform->rotation = b2Rot_GetAngle(physics_rot) * t + interpolation->fixed_step_rotation * t_inv;
 
-			physics_data->fixed_step_velocity = value_cast(vec2f, physics_vel);
-			physics_data->fixed_step_torque = physics_trq;
-			physics_data->fixed_step_position = value_cast(vec2f, physics_pos);
-			physics_data->fixed_step_rotation = b2Rot_GetAngle(physics_rot);
+			interpolation->fixed_step_velocity = value_cast(vec2f, physics_vel);
+			interpolation->fixed_step_torque = physics_trq;
+			interpolation->fixed_step_position = value_cast(vec2f, physics_pos);
+			interpolation->fixed_step_rotation = b2Rot_GetAngle(physics_rot);
 		}
 	}
 }
+
+// default snapshot hooks
+// textures are saved as resource storage ids, so they survive as long as textures are loaded in the same order
+void itu_snapshot_sprite_save(ITU_EntityId id, void* data)
+{
+	Sprite* sprite = (Sprite*)data;
+	sprite->texture = (SDL_Texture*)(uintptr_t)itu_sys_rstorage_texture_from_ptr(sprite->texture);
+}
+
+void itu_snapshot_sprite_load(ITU_EntityId id, void* data)
+{
+	Sprite* sprite = (Sprite*)data;
+	sprite->texture = itu_sys_rstorage_texture_get_ptr((ITU_IdTexture)(uintptr_t)sprite->texture);
+}
+
+// box2d objects are not part of the snapshot, so their ids would be dangling
+void itu_snapshot_physicsdata_save(ITU_EntityId id, void* data)
+{
+	((PhysicsData*)data)->body_id = b2_nullBodyId;
+}
+
+void itu_snapshot_physicsstaticdata_save(ITU_EntityId id, void* data)
+{
+	((PhysicsStaticData*)data)->body_id = b2_nullBodyId;
+}
+
+void itu_snapshot_shapedata_save(ITU_EntityId id, void* data)
+{
+	((ShapeData*)data)->shape_id = b2_nullShapeId;
+}
@@ -1,5 +1,6 @@
 ﻿#ifndef ITU_UNITY_BUILD
 #include <itu_entity_storage.hpp>
+#include <itu_lib_jobs.hpp>
 #include <imgui/imgui.h>
 #endif
 
@@ -9,30 +10,29 @@ struct ITU_Component
 	const char* name;
 	
 	Uint64 element_size;
-	int count_max;
+	int count_max; // current capacity of the dense arrays (they grow on demand)
 	int count_alive;
 
-	Uint64*       data_loc;   // maps EntityId.index to location in data array
-	ITU_EntityId* entity_ids; // maps data array location to an EntityId
-	void*         data;
+	// sparse part: maps EntityId.index to location in the dense arrays (-1 if the entity doesn't have the component).
+	// Split in pages of COMPONENT_POOL_PAGE_SIZE entries, each allocated only when an entity in its range gets the component
+	stbds_arr(Sint32*) data_loc_pages;
 
-	ITU_ComponendDebugUIRender fn_debug_ui_render;
-};
+	// dense part
+	ITU_EntityId* entity_ids;    // maps data array location to an EntityId
+	Uint32*       changed_ticks; // change tick of every element (see `itu_sys_estorage_tick`)
+	void*         data;          // ARCHETYPE_COLUMN_ALIGNMENT aligned
 
-struct ITU_ComponentTagStorage
-{
-	ITU_EntityId key;
+	ITU_ComponendDebugUIRender fn_debug_ui_render;
+	ITU_ComponentSnapshotFunction fn_snapshot_save;
+	ITU_ComponentSnapshotFunction fn_snapshot_load;
 };
 
-struct ITU_ComponentTag
+// dense set of entities, with constant time add/remove/lookup
+// Used both for tag members and for the cached system matches
+struct ITU_EntitySet
 {
-	ITU_ComponentType type;
-	const char* name;
-	
-	int count_max;
-	int count_alive;
-
-	ITU_ComponentTagStorage* entitiy_ids;
+	stbds_arr(ITU_EntityId) entities;
+	stbds_arr(Sint32)       entities_loc; // maps EntityId.index to location in `entities` (-1 if not in the set)
 };
 
 struct ITU_System
@@ -44,82 +44,562 @@ struct ITU_System
 	ITU_TagType tags[SYSTEM_TAGS_MAX];
 	int tags_count;
 
+	Uint64 component_mask;
+	Uint64 tag_mask;
+
+	Uint64 read_mask;
+	Uint64 write_mask;
+	Uint32 flags;
+	Uint32 phase;
+	int wave; // systems in the same wave (of the same phase) don't conflict with each other, and run concurrently
+	Uint32 time_slices;
+	Uint32 time_slice_next; // slice of the matching entities that the next run will get (if time sliced)
+
+	// timings, in nanoseconds (see `itu_sys_estorage_timings_export`)
+	Uint64 time_frame; // spent in `fn_update` during the current frame
+	Uint64 time_history[SYSTEM_TIMINGS_HISTORY_COUNT];
+	Uint32 tick_last_run;
+
+	// cached set of entities matching the system.
+	// This is kept up to date every time the signature (components or tags) of an entity changes,
+	// so updating the system doesn't require any query
+	ITU_EntitySet matches;
+
 	ITU_SystemUpdateFunction fn_update;
 };
 
+// table of all entities sharing the same `component_mask` (only used in `ITU_ESTORAGE_MODE_ARCHETYPE`)
+// Data is split in fixed-size chunks. Every chunk has the same layout:
+//   [entity ids][column 0][column 1]...[column N]
+// where each column is a dense array of `chunk_capacity` elements of a single component type.
+// Rows are kept packed: removing an entity moves the last row of the table into the freed slot
+struct ITU_Archetype
+{
+	Uint64 component_mask;
+
+	int columns_count;
+	ITU_ComponentType column_types[COMPONENTS_COUNT_MAX];
+	Uint64 column_sizes  [COMPONENTS_COUNT_MAX]; // size of a single element of each column
+	Uint64 column_offsets[COMPONENTS_COUNT_MAX]; // byte offset of each column from the start of the chunk
+	Sint8  column_loc    [COMPONENTS_COUNT_MAX]; // maps a component type to its column index (-1 if the archetype doesn't have it)
+
+	int chunk_capacity; // max number of rows in a single chunk
+	Uint64 chunk_size;  // size in bytes of a single chunk (only differs from ARCHETYPE_CHUNK_SIZE for very big components)
+	int count_alive;
+
+	stbds_arr(unsigned char*) chunks; // NOTE: can have one empty chunk after the last row (see `itu_archetype_row_remove`)
+	stbds_arr(Uint32) chunks_changed_ticks; // change tick of every column of every chunk (`columns_count` entries per chunk)
+
+	// cached transitions to the archetypes with one component more/less (-1 if not computed yet)
+	Sint32 edge_add   [COMPONENTS_COUNT_MAX];
+	Sint32 edge_remove[COMPONENTS_COUNT_MAX];
+};
+
 struct ITU_Entity
 {
 	ITU_EntityId id;
 	Uint64 component_mask;
+	Uint64 tag_mask;
+
+	// location of the entity data when using `ITU_ESTORAGE_MODE_ARCHETYPE`
+	Sint32 archetype;
+	Uint32 archetype_row;
+};
+
+enum ITU_CommandType
+{
+	ITU_COMMAND_TYPE_CREATE,
+	ITU_COMMAND_TYPE_DESTROY,
+	ITU_COMMAND_TYPE_COMPONENT_ADD,
+	ITU_COMMAND_TYPE_COMPONENT_REMOVE,
+	ITU_COMMAND_TYPE_TAG_ADD,
+	ITU_COMMAND_TYPE_TAG_REMOVE,
+};
+
+// a single recorded structural change
+struct ITU_Command
+{
+	ITU_CommandType type;
+	ITU_EntityId id;
+	Uint8 component_type_or_tag;
+	Sint32 data_offset; // location of the component init data in `ITU_CommandBuffer::data` (-1 if none)
+};
+
+// structural changes recorded by a single thread while systems are updating
+// Ids returned by `itu_entity_deferred_create` are placeholders: `generation` is ITU_ENTITY_GENERATION_DEFERRED,
+// `index` encodes the buffer and the creation order inside it (resolved into a real id on playback)
+struct ITU_CommandBuffer
+{
+	stbds_arr(ITU_Command)   commands;
+	stbds_arr(unsigned char) data;
+	int created_count;
+	stbds_arr(ITU_EntityId) created; // real ids of the entities created on playback
+};
+
+#define COMMAND_BUFFERS_COUNT (ITU_JOBS_WORKERS_MAX + 1)
+#define COMMAND_BUFFER_INDEX_SHIFT 24
+
+// per-phase rate and accumulator state (see `itu_sys_estorage_phase_set_rate`)
+struct ITU_PhaseState
+{
+	SDL_Time period; // 0 to run once per frame
+	int runs_max;    // per frame (only with a period)
+	SDL_Time accumulator;
+	int runs_count;  // during the current frame
+	int waves_count;
+};
+
+// phases in execution order (the enum starts with the default phase instead)
+static ITU_SystemPhase itu_system_phases_order[] = { ITU_SYSTEM_PHASE_INPUT, ITU_SYSTEM_PHASE_FIXED_UPDATE, ITU_SYSTEM_PHASE_UPDATE, ITU_SYSTEM_PHASE_RENDER };
+static const char* itu_system_phase_names[ITU_SYSTEM_PHASE_MAX] = { "update", "input", "fixed", "render" };
+
+// a single `fn_update` call, executed by the worker pool
+struct ITU_SystemJob
+{
+	ITU_World* world;
+	SDLContext* context;
+	ITU_System* system;
+	int first;
+	int count;
+	Uint64 time; // spent in `fn_update`, collected after the wave is done
+};
+
+// state of an in-progress `itu_sys_estorage_sort_begin`
+struct ITU_SortEntry
+{
+	Uint64 key;
+	ITU_EntityId id;
+	// sorted before the key.
+	//  - archetype mode: archetype of the entity when the sort began
+	//  - sparse mode: 0 if the entity has all the followed components, 1 otherwise
+	//    (so that shared entities end up at the start of every pool, in the same order)
+	Sint32 group;
+};
+
+struct ITU_SortState
+{
+	bool active;
+	stbds_arr(ITU_SortEntry) entries; // target order
+
+	// sparse mode: pools to reorder, one after the other (the sorted one first)
+	ITU_ComponentType pools[COMPONENTS_COUNT_MAX];
+	int pools_count;
+	int pool_current;
+
+	int entry_current;
+	Sint32 archetype_current;
+	Uint32 loc_write; // next location to fill in the current pool (or archetype)
 };
 
-struct ITU_EntityStorageContext
+// all the state of an entity storage. Every entity storage function works on the calling thread's current world
+// (`world_current`, accessed through `ctx_estorage`), which is `world_default` unless changed with `itu_world_set_current`
+struct ITU_World
 {
+	ITU_EStorageMode mode;
+
 	stbds_arr(ITU_Entity)   entities;
 	stbds_arr(ITU_EntityId) entities_free;
 
 	ITU_Component* components[COMPONENTS_COUNT_MAX];
 	int components_count;
 
-	ITU_ComponentTagStorage* tags[TAGS_COUNT_MAX];
+	// archetype tables (only used in `ITU_ESTORAGE_MODE_ARCHETYPE`)
+	stbds_arr(ITU_Archetype*)  archetypes;
+	stbds_hm(Uint64, Sint32)   archetypes_map; // maps a component mask to its archetype index
+
+	// members of each tag (the same information is in `ITU_Entity::tag_mask`, this is for iterating all the entities with a given tag)
+	ITU_EntitySet tags[TAGS_COUNT_MAX];
 
 	ITU_System systems[SYSTEMS_COUNT_MAX];
 	int systems_count;
+	ITU_PhaseState phases[ITU_SYSTEM_PHASE_MAX];
+
+	// system timings history (the per-system part is in `ITU_System`)
+	int timings_frame;        // slot of the history the current frame is written to
+	int timings_frames_count; // number of valid slots
+	Uint64 time_sync_frame;   // spent applying structural changes between waves during the current frame
+	Uint64 time_sync_history[SYSTEM_TIMINGS_HISTORY_COUNT];
+
+	// while systems are being updated, changes to the systems' entity sets are postponed,
+	// so that we don't change the array a system is currently iterating
+	bool systems_updating;
+	stbds_arr(Uint32) entities_dirty;
+
+	// true while systems of the same wave are running on multiple threads. No structural change is allowed in the meantime
+	bool systems_parallel;
+	stbds_arr(ITU_SystemJob) systems_jobs;
+
+	// one for each thread (see `itu_lib_jobs_thread_index`), so recording doesn't need any lock
+	ITU_CommandBuffer command_buffers[COMMAND_BUFFERS_COUNT];
+
+	// change tracking: every write access stamps the data with the current tick.
+	// The tick advances before every wave of systems, and after the last one
+	Uint32 tick;
+
+	ITU_SortState sort;
+
+	// if false, systems always run on the calling thread (see `itu_world_set_parallel_systems`)
+	bool systems_parallel_enabled;
+
+	// state of default systems
+	ITU_TransformHierarchyContext hierarchy;
+	ITU_SpatialIndexContext spatial;
 
 	// debug properties
-	stbds_hm(ITU_EntityId, char*) entities_debug_names;
+	// bumped every time an entity is created, destroyed, renamed or changes signature (so debug UI lists can be cached)
+	Uint32 entities_version;
+	// entity names are stored one after the other in a single arena, and `entities_debug_names` maps
+	// EntityId.index to the name location in the arena (-1 if unnamed). Names of destroyed entities are simply
+	// left in the arena as garbage, that gets compacted away once it's more than the live names
+	stbds_arr(char)   entities_debug_names_arena;
+	stbds_arr(Sint32) entities_debug_names;
+	int entities_debug_names_garbage;
 	stbds_hm(Sint32, const char*) tag_debug_names;
 };
 
-static ITU_ComponentType component_type_counter;
-ITU_EntityStorageContext ctx_estorage;
+static ITU_World world_default = { };
+static thread_local ITU_World* world_current = &world_default;
+#define ctx_estorage (*world_current)
 
-ITU_Component* itu_component_pool_create(size_t element_size, Uint64 total_num_component, const char* component_name);
+static thread_local ITU_System* system_current; // system being updated by the calling thread (if any)
+
+ITU_Component* itu_component_pool_create(size_t element_size, Uint64 capacity, const char* component_name);
+void  itu_component_pool_reserve(ITU_Component* component_pool, int capacity);
+Sint32 itu_component_pool_loc_get(ITU_Component* component_pool, Uint32 entity_index);
+void  itu_component_pool_loc_set(ITU_Component* component_pool, Uint32 entity_index, Sint32 loc);
 void  itu_component_pool_assign(ITU_Component* component_pool, ITU_EntityId entity);
 void  itu_component_pool_data_get(ITU_Component* component_pool, ITU_EntityId entity, void* out_data_copy);
 void  itu_component_pool_data_set(ITU_Component* component_pool, ITU_EntityId entity, void* in_data_copy);
 void  itu_component_pool_remove(ITU_Component* component_pool, ITU_EntityId entity);
 void  itu_component_pool_clear(ITU_Component* component_pool);
-int   itu_system_get_matching_entities(ITU_System* system, ITU_EntityId* out_entitiy_group);
-
-ITU_Component* itu_component_pool_create(Uint64 element_size, Uint64 total_num_component, const char* component_name)
+bool  itu_system_entity_matches(ITU_System* system, Uint32 entity_index);
+void  itu_system_entity_refresh(ITU_System* system, Uint32 entity_index);
+void  itu_systems_entity_signature_changed(Uint32 entity_index);
+bool  itu_system_is_exclusive(ITU_System* system);
+bool  itu_systems_conflict(ITU_System* a, ITU_System* b);
+
+Sint32 itu_entity_set_loc(ITU_EntitySet* set, Uint32 entity_index);
+void   itu_entity_set_add(ITU_EntitySet* set, ITU_EntityId id);
+void   itu_entity_set_remove(ITU_EntitySet* set, Uint32 entity_index);
+void   itu_entity_set_free(ITU_EntitySet* set);
+
+Sint32 itu_archetype_get_or_create(Uint64 component_mask);
+void*  itu_archetype_data_get(ITU_Archetype* archetype, Uint32 row, int column);
+Uint32 itu_archetype_row_add(ITU_Archetype* archetype, ITU_EntityId entity);
+void   itu_archetype_row_remove(ITU_Archetype* archetype, Uint32 row);
+void   itu_archetype_entity_move(ITU_Entity* entity, Sint32 archetype_dst_idx);
+void   itu_archetype_clear(ITU_Archetype* archetype);
+
+ITU_Component* itu_component_pool_create(Uint64 element_size, Uint64 capacity, const char* component_name)
 {
-	// common pattern: we are allocating enough space for the metadata (ITU_Component) + the array data
-	size_t size_metadata   = sizeof(ITU_Component);
-	size_t size_data_loc   = sizeof(Uint64) * ENTITIES_COUNT_MAX;
-	size_t size_entity_ids = sizeof(ITU_EntityId) * total_num_component;
-	size_t size_data       = element_size * total_num_component;
-	size_t total_size = size_metadata + size_data_loc + size_entity_ids + size_data;
-
-	ITU_Component* ret = (ITU_Component*)SDL_malloc(total_size);
-	SDL_memset(ret, -1, total_size);
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	ITU_Component* ret = (ITU_Component*)SDL_malloc(sizeof(ITU_Component));
+	SDL_memset(ret, 0, sizeof(ITU_Component));
 
 	ret->name = component_name;
 	ret->element_size = element_size;
-	ret->count_max = total_num_component;
-	ret->count_alive = 0;
+	ret->fn_debug_ui_render = NULL;
 
-	
-	//Uint64* valid = (Uint64*)((unsigned char*)ret + size_metadata);
+	// in archetype mode the actual data lives in the archetype tables, so we only need the metadata
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_SPARSE && capacity > 0)
+		itu_component_pool_reserve(ret, capacity);
+
+	return ret;
+}
 
-	ret->data_loc   = pointer_offset(Uint64, ret, size_metadata);                 // first array starts at the end of the metadata
-	ret->entity_ids = pointer_offset(ITU_EntityId, ret->data_loc, size_data_loc); // second array starts at the end of first array
-	ret->data       = pointer_offset(void, ret->entity_ids, size_entity_ids);     // third array starts at the end of second array
+// grows the dense arrays so that they can hold at least `capacity` components
+void itu_component_pool_reserve(ITU_Component* component_pool, int capacity)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	if(capacity <= component_pool->count_max)
+		return;
 
-	ret->fn_debug_ui_render = NULL;
+	// NOTE: not using realloc because we want the data to stay aligned
+	ITU_EntityId* entity_ids = (ITU_EntityId*)SDL_malloc(sizeof(ITU_EntityId) * capacity);
+	Uint32* changed_ticks = (Uint32*)SDL_malloc(sizeof(Uint32) * capacity);
+	void* data = SDL_aligned_alloc(ARCHETYPE_COLUMN_ALIGNMENT, component_pool->element_size * capacity);
+	if(component_pool->count_alive > 0)
+	{
+		SDL_memcpy(entity_ids, component_pool->entity_ids, sizeof(ITU_EntityId) * component_pool->count_alive);
+		SDL_memcpy(changed_ticks, component_pool->changed_ticks, sizeof(Uint32) * component_pool->count_alive);
+		SDL_memcpy(data, component_pool->data, component_pool->element_size * component_pool->count_alive);
+	}
+	SDL_free(component_pool->entity_ids);
+	SDL_free(component_pool->changed_ticks);
+	SDL_aligned_free(component_pool->data);
+
+	component_pool->entity_ids = entity_ids;
+	component_pool->changed_ticks = changed_ticks;
+	component_pool->data = data;
+	component_pool->count_max = capacity;
+}
+
+Sint32 itu_component_pool_loc_get(ITU_Component* component_pool, Uint32 entity_index)
+{
+	Uint32 page = entity_index / COMPONENT_POOL_PAGE_SIZE;
+	if(page >= stbds_arrlen(component_pool->data_loc_pages) || !component_pool->data_loc_pages[page])
+		return -1;
+	return component_pool->data_loc_pages[page][entity_index % COMPONENT_POOL_PAGE_SIZE];
+}
+
+// allocates the page containing `entity_index` if needed
+void itu_component_pool_loc_set(ITU_Component* component_pool, Uint32 entity_index, Sint32 loc)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	Uint32 page = entity_index / COMPONENT_POOL_PAGE_SIZE;
+	while(page >= stbds_arrlen(component_pool->data_loc_pages))
+		stbds_arrput(component_pool->data_loc_pages, NULL);
+
+	if(!component_pool->data_loc_pages[page])
+	{
+		component_pool->data_loc_pages[page] = (Sint32*)SDL_malloc(sizeof(Sint32) * COMPONENT_POOL_PAGE_SIZE);
+		SDL_memset(component_pool->data_loc_pages[page], -1, sizeof(Sint32) * COMPONENT_POOL_PAGE_SIZE);
+	}
+	component_pool->data_loc_pages[page][entity_index % COMPONENT_POOL_PAGE_SIZE] = loc;
+}
+
+// computes the columns and chunk layout of an archetype (`archetype` must be zero-initialized)
+void itu_archetype_layout_init(ITU_Archetype* archetype, Uint64 component_mask)
+{
+	archetype->component_mask = component_mask;
+	SDL_memset(archetype->column_loc , -1, sizeof(archetype->column_loc));
+	SDL_memset(archetype->edge_add   , -1, sizeof(archetype->edge_add));
+	SDL_memset(archetype->edge_remove, -1, sizeof(archetype->edge_remove));
+
+	Uint64 row_size = sizeof(ITU_EntityId);
+	for(int i = 0; i < ctx_estorage.components_count; ++i)
+	{
+		if(!(component_mask & (1ull << i)))
+			continue;
+
+		int column = archetype->columns_count++;
+		archetype->column_types[column] = i;
+		archetype->column_sizes[column] = ctx_estorage.components[i]->element_size;
+		archetype->column_loc[i] = column;
+		row_size += archetype->column_sizes[column];
+	}
+
+	// fit as many rows as possible in a chunk, leaving space for the padding needed to align each column
+	Uint64 size_padding = ARCHETYPE_COLUMN_ALIGNMENT * (archetype->columns_count + 1);
+	archetype->chunk_capacity = SDL_max(1, (int)((ARCHETYPE_CHUNK_SIZE - size_padding) / row_size));
+
+	// columns are laid out one after the other, right after the entity ids
+	Uint64 offset = sizeof(ITU_EntityId) * archetype->chunk_capacity;
+	for(int i = 0; i < archetype->columns_count; ++i)
+	{
+		offset = (offset + ARCHETYPE_COLUMN_ALIGNMENT - 1) & ~(Uint64)(ARCHETYPE_COLUMN_ALIGNMENT - 1);
+		archetype->column_offsets[i] = offset;
+		offset += archetype->column_sizes[i] * archetype->chunk_capacity;
+	}
+	archetype->chunk_size = SDL_max(offset, (Uint64)ARCHETYPE_CHUNK_SIZE);
+}
+
+// returns the index of the archetype matching the given component mask, creating it if it doesn't exist yet
+Sint32 itu_archetype_get_or_create(Uint64 component_mask)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	int loc = stbds_hmgeti(ctx_estorage.archetypes_map, component_mask);
+	if(loc != -1)
+		return ctx_estorage.archetypes_map[loc].value;
+
+	ITU_Archetype* archetype = (ITU_Archetype*)SDL_calloc(1, sizeof(ITU_Archetype));
+	itu_archetype_layout_init(archetype, component_mask);
+
+	Sint32 ret = stbds_arrlen(ctx_estorage.archetypes);
+	stbds_arrput(ctx_estorage.archetypes, archetype);
+	stbds_hmput(ctx_estorage.archetypes_map, component_mask, ret);
 
 	return ret;
 }
 
+void* itu_archetype_data_get(ITU_Archetype* archetype, Uint32 row, int column)
+{
+	unsigned char* chunk = archetype->chunks[row / archetype->chunk_capacity];
+	Uint32 loc = row % archetype->chunk_capacity;
+	return pointer_index(chunk + archetype->column_offsets[column], loc, archetype->column_sizes[column]);
+}
+
+// appends `count` rows at the end of the table (adding chunks if needed), returns the index of the first one.
+// The rows are marked as changed, but their content (entity ids included) is left to the caller
+Uint32 itu_archetype_rows_reserve(ITU_Archetype* archetype, int count)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	Uint32 row_first = archetype->count_alive;
+	archetype->count_alive += count;
+
+	Uint32 chunks_needed = (archetype->count_alive + archetype->chunk_capacity - 1) / archetype->chunk_capacity;
+	while(stbds_arrlen(archetype->chunks) < chunks_needed)
+	{
+		unsigned char* chunk = (unsigned char*)SDL_aligned_alloc(ARCHETYPE_COLUMN_ALIGNMENT, archetype->chunk_size);
+		stbds_arrput(archetype->chunks, chunk);
+		stbds_arraddnptr(archetype->chunks_changed_ticks, archetype->columns_count);
+	}
+
+	for(Uint32 chunk_idx = row_first / archetype->chunk_capacity; chunk_idx < chunks_needed; ++chunk_idx)
+		for(int i = 0; i < archetype->columns_count; ++i)
+			archetype->chunks_changed_ticks[chunk_idx * archetype->columns_count + i] = ctx_estorage.tick;
+
+	return row_first;
+}
+
+// appends a new (zero-initialized) row at the end of the table, returns its index
+Uint32 itu_archetype_row_add(ITU_Archetype* archetype, ITU_EntityId entity)
+{
+	Uint32 row = itu_archetype_rows_reserve(archetype, 1);
+	unsigned char* chunk = archetype->chunks[row / archetype->chunk_capacity];
+	Uint32 loc = row % archetype->chunk_capacity;
+
+	((ITU_EntityId*)chunk)[loc] = entity;
+	for(int i = 0; i < archetype->columns_count; ++i)
+		SDL_memset(pointer_index(chunk + archetype->column_offsets[i], loc, archetype->column_sizes[i]), 0, archetype->column_sizes[i]);
+
+	return row;
+}
+
+// removes a row by moving the last row of the table in its place (keeps the table packed)
+void itu_archetype_row_remove(ITU_Archetype* archetype, Uint32 row)
+{
+	SDL_assert(row < archetype->count_alive);
+
+	Uint32 row_last = --archetype->count_alive;
+	if(row != row_last)
+	{
+		unsigned char* chunk_curr = archetype->chunks[row      / archetype->chunk_capacity];
+		unsigned char* chunk_last = archetype->chunks[row_last / archetype->chunk_capacity];
+		Uint32 loc_curr = row      % archetype->chunk_capacity;
+		Uint32 loc_last = row_last % archetype->chunk_capacity;
+
+		ITU_EntityId moved = ((ITU_EntityId*)chunk_last)[loc_last];
+		((ITU_EntityId*)chunk_curr)[loc_curr] = moved;
+		for(int i = 0; i < archetype->columns_count; ++i)
+		{
+			Uint64 size = archetype->column_sizes[i];
+			void* ptr_curr = pointer_index(chunk_curr + archetype->column_offsets[i], loc_curr, size);
+			void* ptr_last = pointer_index(chunk_last + archetype->column_offsets[i], loc_last, size);
+			SDL_memcpy(ptr_curr, ptr_last, size);
+
+			// ticks are per chunk, so the destination chunk needs to be at least as recent as the moved row
+			Uint32* tick_curr = &archetype->chunks_changed_ticks[(row      / archetype->chunk_capacity) * archetype->columns_count + i];
+			Uint32  tick_last =  archetype->chunks_changed_ticks[(row_last / archetype->chunk_capacity) * archetype->columns_count + i];
+			*tick_curr = SDL_max(*tick_curr, tick_last);
+		}
+
+		ctx_estorage.entities[moved.index].archetype_row = row;
+	}
+
+	// the chunk that just got empty is kept as a spare (so that an entity going back and forth across a chunk boundary
+	// doesn't allocate and free a chunk every time), any other empty chunk after it is released
+	if(row_last % archetype->chunk_capacity == 0)
+	{
+		Uint32 chunks_kept = row_last / archetype->chunk_capacity + 1;
+		while(stbds_arrlen(archetype->chunks) > chunks_kept)
+			SDL_aligned_free(stbds_arrpop(archetype->chunks));
+		stbds_arrsetlen(archetype->chunks_changed_ticks, stbds_arrlen(archetype->chunks) * archetype->columns_count);
+	}
+}
+
+// swaps `size` bytes between two non-overlapping locations
+void itu_memswap(void* a, void* b, Uint64 size)
+{
+	unsigned char tmp[256];
+	unsigned char* ptr_a = (unsigned char*)a;
+	unsigned char* ptr_b = (unsigned char*)b;
+	while(size > 0)
+	{
+		Uint64 size_step = SDL_min(size, sizeof(tmp));
+		SDL_memcpy(tmp, ptr_a, size_step);
+		SDL_memcpy(ptr_a, ptr_b, size_step);
+		SDL_memcpy(ptr_b, tmp, size_step);
+		ptr_a += size_step;
+		ptr_b += size_step;
+		size -= size_step;
+	}
+}
+
+// swaps two rows of the same archetype, updating the rows stored in their entities
+void itu_archetype_row_swap(ITU_Archetype* archetype, Uint32 row_a, Uint32 row_b)
+{
+	Uint32 chunk_idx_a = row_a / archetype->chunk_capacity;
+	Uint32 chunk_idx_b = row_b / archetype->chunk_capacity;
+	unsigned char* chunk_a = archetype->chunks[chunk_idx_a];
+	unsigned char* chunk_b = archetype->chunks[chunk_idx_b];
+	Uint32 loc_a = row_a % archetype->chunk_capacity;
+	Uint32 loc_b = row_b % archetype->chunk_capacity;
+
+	ITU_EntityId id_a = ((ITU_EntityId*)chunk_a)[loc_a];
+	ITU_EntityId id_b = ((ITU_EntityId*)chunk_b)[loc_b];
+	((ITU_EntityId*)chunk_a)[loc_a] = id_b;
+	((ITU_EntityId*)chunk_b)[loc_b] = id_a;
+	ctx_estorage.entities[id_a.index].archetype_row = row_b;
+	ctx_estorage.entities[id_b.index].archetype_row = row_a;
+
+	for(int i = 0; i < archetype->columns_count; ++i)
+	{
+		Uint64 size = archetype->column_sizes[i];
+		itu_memswap(
+			pointer_index(chunk_a + archetype->column_offsets[i], loc_a, size),
+			pointer_index(chunk_b + archetype->column_offsets[i], loc_b, size),
+			size
+		);
+
+		// ticks are per chunk, both chunks need to be at least as recent as the rows they received
+		Uint32* tick_a = &archetype->chunks_changed_ticks[chunk_idx_a * archetype->columns_count + i];
+		Uint32* tick_b = &archetype->chunks_changed_ticks[chunk_idx_b * archetype->columns_count + i];
+		*tick_a = *tick_b = SDL_max(*tick_a, *tick_b);
+	}
+}
+
+// moves all the entity data to a different archetype.
+// Components that are not part of the destination archetype are discarded, new ones are zero-initialized
+void itu_archetype_entity_move(ITU_Entity* entity, Sint32 archetype_dst_idx)
+{
+	ITU_Archetype* archetype_src = ctx_estorage.archetypes[entity->archetype];
+	ITU_Archetype* archetype_dst = ctx_estorage.archetypes[archetype_dst_idx];
+	Uint32 row_src = entity->archetype_row;
+	Uint32 row_dst = itu_archetype_row_add(archetype_dst, entity->id);
+
+	for(int i = 0; i < archetype_dst->columns_count; ++i)
+	{
+		int column_src = archetype_src->column_loc[archetype_dst->column_types[i]];
+		if(column_src == -1)
+			continue;
+
+		void* ptr_src = itu_archetype_data_get(archetype_src, row_src, column_src);
+		void* ptr_dst = itu_archetype_data_get(archetype_dst, row_dst, i);
+		SDL_memcpy(ptr_dst, ptr_src, archetype_dst->column_sizes[i]);
+	}
+
+	itu_archetype_row_remove(archetype_src, row_src);
+
+	entity->archetype = archetype_dst_idx;
+	entity->archetype_row = row_dst;
+}
+
+void itu_archetype_clear(ITU_Archetype* archetype)
+{
+	for(int i = 0; i < stbds_arrlen(archetype->chunks); ++i)
+		SDL_aligned_free(archetype->chunks[i]);
+	stbds_arrfree(archetype->chunks);
+	stbds_arrfree(archetype->chunks_changed_ticks);
+	archetype->count_alive = 0;
+}
+
 ITU_ComponentType itu_sys_estorage_add_component_pool(Uint64 element_size, Uint64 total_num_component, ITU_ComponentType* ref_component_type, const char* component_name);
 void itu_sys_estorage_add_component_debug_ui_render(ITU_ComponentType component_type, ITU_ComponendDebugUIRender fn_debug_ui_render)
 ;
 
-void itu_sys_estorage_init(int starting_entities_count, bool enable_standard_components=true)
+void itu_sys_estorage_init(int starting_entities_count, bool enable_standard_components=true, ITU_EStorageMode mode=ITU_ESTORAGE_MODE_SPARSE)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	// NOTE: storage mode needs to be decided before any component pool is created
+	SDL_assert(ctx_estorage.components_count == 0);
+	ctx_estorage.mode = mode;
+	ctx_estorage.tick = 1; // so that "changed since 0" includes everything
+	ctx_estorage.systems_parallel_enabled = true;
+	itu_sys_estorage_phase_set_rate(ITU_SYSTEM_PHASE_FIXED_UPDATE, PHYSICS_TIMESTEP_NSECS, PHYSICS_MAX_TIMESTEPS_PER_FRAME);
+
 	// allocate a minimum of elements at initialization time, to minimize early reallocs
-	stbds_arrsetlen(ctx_estorage.entities, starting_entities_count);
-	//stbds_hmset(ctx_estorage.entities_debug_names, starting_entities_count);
+	stbds_arrsetcap(ctx_estorage.entities, starting_entities_count);
 
 	if(enable_standard_components)
 	{
@@ -128,71 +608,304 @@ void itu_sys_estorage_init(int starting_entities_count, bool enable_standard_com
 		enable_component(PhysicsData);
 		enable_component(PhysicsStaticData);
 		enable_component(ShapeData);
+		enable_component(TransformParent);
+		enable_component(SpriteCompact);
+		enable_component(PhysicsInterpolation);
 
 		add_component_debug_ui_render(ShapeData, itu_debug_ui_render_shapedata);
 		add_component_debug_ui_render(Transform, itu_debug_ui_render_transform);
 		add_component_debug_ui_render(Sprite, itu_debug_ui_render_sprite);
 		add_component_debug_ui_render(PhysicsData, itu_debug_ui_render_physicsdata);
 		add_component_debug_ui_render(PhysicsStaticData, itu_debug_ui_render_physicsstaticdata);
-
-		add_system(itu_system_physics       , component_mask(PhysicsData)                                  , 0);
-		add_system(itu_system_sprite_render , component_mask(Transform)   | component_mask(Sprite)         , 0);
+		add_component_debug_ui_render(TransformParent, itu_debug_ui_render_transformparent);
+		add_component_debug_ui_render(SpriteCompact, itu_debug_ui_render_spritecompact);
+		add_component_debug_ui_render(PhysicsInterpolation, itu_debug_ui_render_physicsinterpolation);
+
+		add_component_snapshot_hooks(Sprite, itu_snapshot_sprite_save, itu_snapshot_sprite_load);
+		add_component_snapshot_hooks(PhysicsData, itu_snapshot_physicsdata_save, NULL);
+		add_component_snapshot_hooks(PhysicsStaticData, itu_snapshot_physicsstaticdata_save, NULL);
+		add_component_snapshot_hooks(ShapeData, itu_snapshot_shapedata_save, NULL);
+
+		// NOTE: physics runs at a fixed rate, in its own phase (so before everything in the update phase).
+		//       Order matters for the others: the hierarchy needs to see the final position of physics bodies, and needs to be done
+		//       before rendering. The spatial index system is only added by `itu_spatial_index_enable`
+		itu_sys_estorage_add_system({ "itu_system_physics", itu_system_physics, component_mask(PhysicsData), 0, 0, 0, ITU_SYSTEM_FLAG_QUERY, ITU_SYSTEM_PHASE_FIXED_UPDATE });
+		add_system(itu_system_transform_hierarchy, component_mask(Transform) | component_mask(TransformParent), 0);
+		add_system_with_access(
+			itu_system_sprite_render,
+			component_mask(Transform) | component_mask(Sprite), 0,
+			component_mask(Transform) | component_mask(Sprite), 0, ITU_SYSTEM_FLAG_MAIN_THREAD | ITU_SYSTEM_FLAG_QUERY
+		);
+		add_system_with_access(
+			itu_system_sprite_compact_render,
+			component_mask(Transform) | component_mask(SpriteCompact), 0,
+			component_mask(Transform) | component_mask(SpriteCompact), 0, ITU_SYSTEM_FLAG_MAIN_THREAD | ITU_SYSTEM_FLAG_QUERY
+		);
 	}
 }
 
-ITU_ComponentType itu_sys_estorage_add_component_pool(Uint64 element_size, Uint64 total_num_component, ITU_ComponentType* ref_component_type, const char* component_name)
+// `capacity`: hint for the number of components to preallocate (0 to allocate on first use)
+ITU_ComponentType itu_sys_estorage_add_component_pool(Uint64 element_size, Uint64 capacity, ITU_ComponentType* ref_component_type, const char* component_name)
 {
-	ITU_Component* pool = itu_component_pool_create(element_size, total_num_component, component_name);
+	ITU_Component* pool = itu_component_pool_create(element_size, capacity, component_name);
 	pool->type = ctx_estorage.components_count++;
 	ctx_estorage.components[pool->type] = pool;
 
 	// make component type globally available
+	// NOTE: this is shared by all worlds, so all of them need to enable the same components in the same order
 	*ref_component_type = pool->type;
 
 	return pool->type;
 }
 
+// worlds
+ITU_World* itu_world_create(int starting_entities_count, bool enable_standard_components, ITU_EStorageMode mode)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	ITU_World* world = (ITU_World*)SDL_calloc(1, sizeof(ITU_World));
+	ITU_World* world_prev = itu_world_set_current(world);
+	itu_sys_estorage_init(starting_entities_count, enable_standard_components, mode);
+	ctx_estorage.systems_parallel_enabled = false;
+	itu_world_set_current(world_prev);
+	return world;
+}
+
+void itu_world_destroy(ITU_World* world)
+{
+	SDL_assert(world != &world_default);
+	SDL_assert(world != world_current);
+	SDL_assert(!world->systems_updating);
+
+	for(int i = 0; i < world->components_count; ++i)
+	{
+		ITU_Component* component_pool = world->components[i];
+		itu_component_pool_clear(component_pool);
+		SDL_free(component_pool->entity_ids);
+		SDL_free(component_pool->changed_ticks);
+		SDL_aligned_free(component_pool->data);
+		SDL_free(component_pool);
+	}
+
+	for(int i = 0; i < stbds_arrlen(world->archetypes); ++i)
+	{
+		itu_archetype_clear(world->archetypes[i]);
+		SDL_free(world->archetypes[i]);
+	}
+	stbds_arrfree(world->archetypes);
+	stbds_hmfree(world->archetypes_map);
+
+	for(int i = 0; i < TAGS_COUNT_MAX; ++i)
+		itu_entity_set_free(&world->tags[i]);
+	for(int i = 0; i < world->systems_count; ++i)
+		itu_entity_set_free(&world->systems[i].matches);
+
+	for(int i = 0; i < COMMAND_BUFFERS_COUNT; ++i)
+	{
+		stbds_arrfree(world->command_buffers[i].commands);
+		stbds_arrfree(world->command_buffers[i].data);
+		stbds_arrfree(world->command_buffers[i].created);
+	}
+
+	stbds_arrfree(world->entities);
+	stbds_arrfree(world->entities_free);
+	stbds_arrfree(world->entities_dirty);
+	stbds_arrfree(world->systems_jobs);
+	stbds_arrfree(world->sort.entries);
+	stbds_arrfree(world->hierarchy.nodes);
+	stbds_arrfree(world->hierarchy.worlds);
+	stbds_arrfree(world->hierarchy.dirty);
+	for(int i = 0; i < stbds_arrlen(world->spatial.cells); ++i)
+		stbds_arrfree(world->spatial.cells[i].items);
+	stbds_arrfree(world->spatial.cells);
+	stbds_hmfree(world->spatial.cells_map);
+	stbds_arrfree(world->spatial.entries);
+	stbds_arrfree(world->entities_debug_names_arena);
+	stbds_arrfree(world->entities_debug_names);
+	stbds_hmfree(world->tag_debug_names);
+
+	SDL_free(world);
+}
+
+ITU_World* itu_world_default()
+{
+	return &world_default;
+}
+
+ITU_World* itu_world_get_current()
+{
+	return world_current;
+}
+
+ITU_World* itu_world_set_current(ITU_World* world)
+{
+	ITU_World* ret = world_current;
+	world_current = world ? world : &world_default;
+	return ret;
+}
+
+void itu_world_set_parallel_systems(ITU_World* world, bool enabled)
+{
+	world->systems_parallel_enabled = enabled;
+}
+
+ITU_TransformHierarchyContext* itu_world_transform_hierarchy()
+{
+	return &ctx_estorage.hierarchy;
+}
+
+ITU_SpatialIndexContext* itu_world_spatial_index()
+{
+	return &ctx_estorage.spatial;
+}
+
+void itu_world_systems_update(ITU_World* world, SDLContext* context)
+{
+	ITU_WorldScope scope(world);
+	itu_sys_estorage_systems_update(context);
+}
+
+ITU_EntityId itu_world_entity_create(ITU_World* world)
+{
+	ITU_WorldScope scope(world);
+	return itu_entity_create();
+}
+
+void itu_world_entity_destroy(ITU_World* world, ITU_EntityId id)
+{
+	ITU_WorldScope scope(world);
+	itu_entity_destroy(id);
+}
+
+void itu_world_entity_component_add(ITU_World* world, ITU_EntityId id, ITU_ComponentType component_type, void* in_data_copy)
+{
+	ITU_WorldScope scope(world);
+	itu_entity_component_add(id, component_type, in_data_copy);
+}
+
+void itu_world_entity_component_remove(ITU_World* world, ITU_EntityId id, ITU_ComponentType component_type)
+{
+	ITU_WorldScope scope(world);
+	itu_entity_component_remove(id, component_type);
+}
+
+void* itu_world_entity_data_get(ITU_World* world, ITU_EntityId id, ITU_ComponentType component_type)
+{
+	ITU_WorldScope scope(world);
+	return itu_entity_data_get(id, component_type);
+}
+
 void itu_sys_estorage_add_component_debug_ui_render(ITU_ComponentType component_type, ITU_ComponendDebugUIRender fn_debug_ui_render)
 {
 	ctx_estorage.components[component_type]->fn_debug_ui_render = fn_debug_ui_render;
 }
 
+void itu_sys_estorage_add_component_snapshot_hooks(ITU_ComponentType component_type, ITU_ComponentSnapshotFunction fn_save, ITU_ComponentSnapshotFunction fn_load)
+{
+	ctx_estorage.components[component_type]->fn_snapshot_save = fn_save;
+	ctx_estorage.components[component_type]->fn_snapshot_load = fn_load;
+}
+
+Sint32 itu_entity_set_loc(ITU_EntitySet* set, Uint32 entity_index)
+{
+	if(entity_index >= stbds_arrlen(set->entities_loc))
+		return -1;
+	return set->entities_loc[entity_index];
+}
+
+// NOTE: if an entity with the same index is already in the set, its id gets overwritten
+//       (entity indices get recycled, so the one in the set may be of an older generation)
+void itu_entity_set_add(ITU_EntitySet* set, ITU_EntityId id)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	// grow the sparse array on demand
+	int loc_len = stbds_arrlen(set->entities_loc);
+	if(id.index >= loc_len)
+	{
+		stbds_arrsetlen(set->entities_loc, id.index + 1);
+		for(int i = loc_len; i <= id.index; ++i)
+			set->entities_loc[i] = -1;
+	}
+
+	Sint32 loc = set->entities_loc[id.index];
+	if(loc != -1)
+	{
+		set->entities[loc] = id;
+		return;
+	}
+
+	set->entities_loc[id.index] = stbds_arrlen(set->entities);
+	stbds_arrput(set->entities, id);
+}
+
+void itu_entity_set_remove(ITU_EntitySet* set, Uint32 entity_index)
+{
+	Sint32 loc = itu_entity_set_loc(set, entity_index);
+	if(loc == -1)
+		return;
+
+	// swap-remove (same as component pools)
+	ITU_EntityId entity_last = stbds_arrpop(set->entities);
+	if(loc < stbds_arrlen(set->entities))
+	{
+		set->entities[loc] = entity_last;
+		set->entities_loc[entity_last.index] = loc;
+	}
+	set->entities_loc[entity_index] = -1;
+}
+
+void itu_entity_set_free(ITU_EntitySet* set)
+{
+	stbds_arrfree(set->entities);
+	stbds_arrfree(set->entities_loc);
+}
+
 void itu_sys_estorage_clear_all_entities()
 {
+	for(int i = 0; i < stbds_arrlen(ctx_estorage.entities); ++i)
+	{
+		ITU_EntityId id = ctx_estorage.entities[i].id;
+		if(itu_entity_is_valid(id))
+			itu_entity_destroy(id);
+	}
+
+	for(int i = 0; i < ctx_estorage.components_count; ++i)
+		itu_component_pool_clear(ctx_estorage.components[i]);
+	for(int i = 0; i < stbds_arrlen(ctx_estorage.archetypes); ++i)
+		itu_archetype_clear(ctx_estorage.archetypes[i]);
+
 	stbds_arrfree(ctx_estorage.entities);
 	stbds_arrfree(ctx_estorage.entities_free);
+	ctx_estorage.entities_version++;
+
+	ctx_estorage.sort.active = false;
+	stbds_arrsetlen(ctx_estorage.sort.entries, 0);
+
+	itu_spatial_index_clear();
+
+	// all names are gone, no need to compact
+	stbds_arrsetlen(ctx_estorage.entities_debug_names_arena, 0);
+	stbds_arrsetlen(ctx_estorage.entities_debug_names, 0);
+	ctx_estorage.entities_debug_names_garbage = 0;
 }
 
 void itu_sys_estorage_set_systems(ITU_SystemDef* systems, int systems_count)
 {
 	SDL_assert(systems_count <= SYSTEMS_COUNT_MAX);
 
-	ctx_estorage.systems_count = systems_count;
-	for(int i = 0; i < systems_count; ++i)
-	{
-		ITU_System* system_runtime = &ctx_estorage.systems[i];
-		ITU_SystemDef* system_def  = &systems[i];
+	for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		itu_entity_set_free(&ctx_estorage.systems[i].matches);
+	SDL_memset(ctx_estorage.systems, 0, sizeof(ctx_estorage.systems));
+	ctx_estorage.systems_count = 0;
+	for(int i = 0; i < ITU_SYSTEM_PHASE_MAX; ++i)
+		ctx_estorage.phases[i].waves_count = 0;
 
-		// build component pool pointers (this requires component pools to be alredy set up)
-		for(int j = 0; j < COMPONENTS_COUNT_MAX; ++j)
-		{
-			Uint64 component_bitmask = 1ll << j;
-			if(system_def->component_mask & component_bitmask)
-				system_runtime->components[system_runtime->components_count++] = ctx_estorage.components[j];
-		}
-		for(int j = 0; j < TAGS_COUNT_MAX; ++j)
-		{
-			Uint64 tag_bitmask = 1ll << j;
-			if(system_def->tag_mask & tag_bitmask)
-				system_runtime->tags[system_runtime->tags_count++] = j;
-		}
-		system_runtime->fn_update = system_def->fn_update;
-		system_runtime->name = system_def->name;
-	}
+	for(int i = 0; i < systems_count; ++i)
+		itu_sys_estorage_add_system(systems[i]);
 }
 
 void itu_sys_estorage_add_system(ITU_SystemDef system_def)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
 	if(ctx_estorage.systems_count == SYSTEMS_COUNT_MAX)
 	{
 		SDL_Log("WARNING maximum number of systes reached");
@@ -214,78 +927,491 @@ void itu_sys_estorage_add_system(ITU_SystemDef system_def)
 		if(system_def.tag_mask & tag_bitmask)
 			system_runtime->tags[system_runtime->tags_count++] = j;
 	}
+	system_runtime->component_mask = system_def.component_mask;
+	system_runtime->tag_mask = system_def.tag_mask;
+	system_runtime->read_mask = system_def.read_mask;
+	system_runtime->write_mask = system_def.write_mask;
+	system_runtime->flags = system_def.flags;
+	system_runtime->phase = system_def.phase;
+	system_runtime->time_slices = SDL_max(system_def.time_slices, 1);
+	SDL_assert(!(system_runtime->flags & ITU_SYSTEM_FLAG_QUERY) || (!(system_runtime->flags & ITU_SYSTEM_FLAG_PARALLEL_FOR) && system_runtime->time_slices == 1)); // query systems can't be split
+	system_runtime->time_slice_next = 0;
 	system_runtime->fn_update = system_def.fn_update;
 	system_runtime->name = system_def.name;
+
+	// schedule the system right after the last (previously added) system of the same phase it conflicts with
+	SDL_assert(system_runtime->phase < ITU_SYSTEM_PHASE_MAX);
+	ITU_PhaseState* phase = &ctx_estorage.phases[system_runtime->phase];
+	system_runtime->wave = 0;
+	for(int i = 0; i < ctx_estorage.systems_count - 1; ++i)
+		if(ctx_estorage.systems[i].phase == system_runtime->phase && itu_systems_conflict(&ctx_estorage.systems[i], system_runtime))
+			system_runtime->wave = SDL_max(system_runtime->wave, ctx_estorage.systems[i].wave + 1);
+	phase->waves_count = SDL_max(phase->waves_count, system_runtime->wave + 1);
+
+	// systems can be added after entities have been created, so we need to do a full match once
+	for(int i = 0; i < stbds_arrlen(ctx_estorage.entities); ++i)
+		itu_system_entity_refresh(system_runtime, i);
 }
 
+bool itu_system_is_exclusive(ITU_System* system)
+{
+	return system->read_mask == 0 && system->write_mask == 0;
+}
 
-int itu_system_get_matching_entities(ITU_System* system, ITU_EntityId* out_entitiy_group)
+// two systems conflict if one writes something the other one reads or writes
+bool itu_systems_conflict(ITU_System* a, ITU_System* b)
 {
-	ITU_EntityId* min_component;
-	Uint64  min_component_size = ENTITIES_COUNT_MAX + 1;
-	int system_ids_count = 0;
+	if(itu_system_is_exclusive(a) || itu_system_is_exclusive(b))
+		return true;
 
-	for(int j = 0; j < system->components_count; ++j)
-		if(system->components[j]->count_alive < min_component_size)
-		{
-			min_component = system->components[j]->entity_ids;
-			min_component_size = system->components[j]->count_alive;
-		}
+	return (a->write_mask & (b->read_mask | b->write_mask)) || (b->write_mask & a->read_mask);
+}
 
-	for(int j = 0; j < system->tags_count; ++j)
-	{
-		auto tmp = ctx_estorage.tags[system->tags[j]];
-		if(!tmp)
-			continue;
-		if(stbds_hmlen(tmp) < min_component_size)
+bool itu_system_entity_matches(ITU_System* system, Uint32 entity_index)
+{
+	ITU_Entity* entity = &ctx_estorage.entities[entity_index];
+
+	// destroyed entity
+	if(entity->id.index == -1)
+		return false;
+
+	return (entity->component_mask & system->component_mask) == system->component_mask
+	    && (entity->tag_mask       & system->tag_mask)       == system->tag_mask;
+}
+
+// adds/removes the entity to/from the system entity set, based on its current signature
+void itu_system_entity_refresh(ITU_System* system, Uint32 entity_index)
+{
+	if(system->flags & ITU_SYSTEM_FLAG_QUERY)
+		return;
+
+	if(itu_system_entity_matches(system, entity_index))
+		itu_entity_set_add(&system->matches, ctx_estorage.entities[entity_index].id);
+	else
+		itu_entity_set_remove(&system->matches, entity_index);
+}
+
+// needs to be called every time an entity gains/loses a component or a tag, or gets destroyed
+void itu_systems_entity_signature_changed(Uint32 entity_index)
+{
+	ctx_estorage.entities_version++;
+	if(ctx_estorage.systems_updating)
+	{
+		stbds_arrput(ctx_estorage.entities_dirty, entity_index);
+		return;
+	}
+
+	for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		itu_system_entity_refresh(&ctx_estorage.systems[i], entity_index);
+}
+
+// returns the time spent in the update
+Uint64 itu_system_run(SDLContext* context, ITU_System* system, int first, int count)
+{
+	ITU_PROFILE_SCOPE(system->name);
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_GENERAL); // allocations made by game code are not ECS memory
+	Uint64 time_start = SDL_GetTicksNS();
+	system_current = system;
+	system->fn_update(context, system->matches.entities + first, count);
+	system_current = NULL;
+	return SDL_GetTicksNS() - time_start;
+}
+
+void itu_system_job_run(void* data)
+{
+	// jobs can run on any thread, so they need to bring their world with them
+	ITU_SystemJob* job = (ITU_SystemJob*)data;
+	ITU_World* world_prev = itu_world_set_current(job->world);
+	job->time = itu_system_run(job->context, job->system, job->first, job->count);
+	itu_world_set_current(world_prev);
+}
+
+// entities passed to the next run of `system` (a different slice every run, for time sliced systems)
+void itu_system_range_get(ITU_System* system, int* out_first, int* out_count)
+{
+	int entities_count = stbds_arrlen(system->matches.entities);
+	int first = (int)((Sint64)entities_count *  system->time_slice_next      / system->time_slices);
+	int last  = (int)((Sint64)entities_count * (system->time_slice_next + 1) / system->time_slices);
+	*out_first = first;
+	*out_count = last - first;
+}
+
+void itu_sys_estorage_phase_run(SDLContext* context, ITU_SystemPhase phase)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	ITU_PROFILE_SCOPE(itu_system_phase_names[phase]);
+	for(int wave = 0; wave < ctx_estorage.phases[phase].waves_count; ++wave)
+	{
+		ctx_estorage.tick++;
+
+		// split the wave in jobs for the worker pool. Main thread systems are run directly
+		stbds_arrsetlen(ctx_estorage.systems_jobs, 0);
+		int systems_main_count = 0;
+		ITU_System* systems_main[SYSTEMS_COUNT_MAX];
+		for(int i = 0; i < ctx_estorage.systems_count; ++i)
 		{
-			min_component = (ITU_EntityId*)tmp;
-			min_component_size = stbds_hmlen(tmp);
+			ITU_System* system = &ctx_estorage.systems[i];
+			if(system->phase != phase || system->wave != wave)
+				continue;
+
+			int first, count;
+			itu_system_range_get(system, &first, &count);
+			if(itu_system_is_exclusive(system) || (system->flags & ITU_SYSTEM_FLAG_MAIN_THREAD) || !ctx_estorage.systems_parallel_enabled)
+				systems_main[systems_main_count++] = system;
+			else if(system->flags & ITU_SYSTEM_FLAG_PARALLEL_FOR)
+				for(int offset = 0; offset < count; offset += SYSTEM_PARALLEL_FOR_CHUNK)
+					stbds_arrput(ctx_estorage.systems_jobs, (ITU_SystemJob{ world_current, context, system, first + offset, SDL_min(SYSTEM_PARALLEL_FOR_CHUNK, count - offset) }));
+			else
+				stbds_arrput(ctx_estorage.systems_jobs, (ITU_SystemJob{ world_current, context, system, first, count }));
+		}
+
+		int jobs_count = stbds_arrlen(ctx_estorage.systems_jobs);
+		ctx_estorage.systems_updating = true;
+		ctx_estorage.systems_parallel = systems_main_count + jobs_count > 1;
+
+		// NOTE: the job array is complete before pushing anything, so it can't be reallocated while workers read it
+		if(jobs_count > 0 && !itu_lib_jobs_is_initialized())
+			itu_lib_jobs_init(0);
+		for(int i = 0; i < jobs_count; ++i)
+			itu_lib_jobs_push(itu_system_job_run, &ctx_estorage.systems_jobs[i]);
+
+		for(int i = 0; i < systems_main_count; ++i)
+		{
+			int first, count;
+			itu_system_range_get(systems_main[i], &first, &count);
+			systems_main[i]->time_frame += itu_system_run(context, systems_main[i], first, count);
+		}
+
+		if(jobs_count > 0)
+			itu_lib_jobs_wait_all();
+		for(int i = 0; i < jobs_count; ++i)
+			ctx_estorage.systems_jobs[i].system->time_frame += ctx_estorage.systems_jobs[i].time;
+
+		for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		{
+			ITU_System* system = &ctx_estorage.systems[i];
+			if(system->phase != phase || system->wave != wave)
+				continue;
+			system->tick_last_run = ctx_estorage.tick;
+			system->time_slice_next = (system->time_slice_next + 1) % system->time_slices;
+		}
+
+		ctx_estorage.systems_parallel = false;
+		ctx_estorage.systems_updating = false;
+
+		// apply whatever structural change happened during the wave
+		{
+			ITU_PROFILE_SCOPE("structural_changes");
+			Uint64 time_sync_start = SDL_GetTicksNS();
+			for(int j = 0; j < stbds_arrlen(ctx_estorage.entities_dirty); ++j)
+				itu_systems_entity_signature_changed(ctx_estorage.entities_dirty[j]);
+			stbds_arrsetlen(ctx_estorage.entities_dirty, 0);
+
+			itu_sys_estorage_commands_playback();
+			ctx_estorage.time_sync_frame += SDL_GetTicksNS() - time_sync_start;
 		}
 	}
+}
+
+void itu_sys_estorage_systems_update(SDLContext* context)
+{
+	ITU_PROFILE_SCOPE("systems_update");
+	for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		ctx_estorage.systems[i].time_frame = 0;
+	ctx_estorage.time_sync_frame = 0;
 
-	// filter entities
-	for(int k = 0; k < min_component_size; ++k)
+	for(int i = 0; i < SDL_arraysize(itu_system_phases_order); ++i)
 	{
-		ITU_EntityId entity_curr = min_component[k];
-		bool filter_out = false;
-		for(int j = 0; j < system->components_count; ++j)
-		{
-			ITU_Component* filtered_component = system->components[j];
+		ITU_SystemPhase phase_type = itu_system_phases_order[i];
+		ITU_PhaseState* phase = &ctx_estorage.phases[phase_type];
+		phase->runs_count = 0;
 
-			if(filtered_component->data_loc[entity_curr.index] == -1)
-			{
-				filter_out = true;
-				break;
-			}
+		if(phase->period == 0)
+		{
+			phase->runs_count = 1;
+			itu_sys_estorage_phase_run(context, phase_type);
+			continue;
 		}
 
-		for(int j = 0; j < system->tags_count; ++j)
+		// decouple the phase from the framerate, running it 0, 1 or multiple times per frame
+		// NOTE: the accumulator is consumed before running, so that `itu_sys_estorage_phase_alpha` is already up to date during the run
+		phase->accumulator += context->elapsed_frame;
+		while(phase->accumulator >= phase->period && phase->runs_count < phase->runs_max)
 		{
-			ITU_TagType filtered_tag = system->tags[j];
-				
-			if(stbds_hmgeti(ctx_estorage.tags[filtered_tag], entity_curr) == -1)
-			{
-				filter_out = true;
-				break;
-			}
+			phase->accumulator -= phase->period;
+			phase->runs_count++;
+			itu_sys_estorage_phase_run(context, phase_type);
 		}
-		if(!filter_out)
-			out_entitiy_group[system_ids_count++] = entity_curr;
 	}
 
-	return system_ids_count;
+	// changes done outside of systems need to be seen by all systems
+	ctx_estorage.tick++;
+
+	if(ctx_estorage.sort.active)
+		itu_sys_estorage_sort_step(COMPONENT_SORT_MOVES_PER_FRAME);
+
+	int frame = ctx_estorage.timings_frame;
+	for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		ctx_estorage.systems[i].time_history[frame] = ctx_estorage.systems[i].time_frame;
+	ctx_estorage.time_sync_history[frame] = ctx_estorage.time_sync_frame;
+	ctx_estorage.timings_frame = (frame + 1) % SYSTEM_TIMINGS_HISTORY_COUNT;
+	ctx_estorage.timings_frames_count = SDL_min(ctx_estorage.timings_frames_count + 1, SYSTEM_TIMINGS_HISTORY_COUNT);
+}
+
+void itu_sys_estorage_phase_set_rate(ITU_SystemPhase phase, SDL_Time period, int runs_max)
+{
+	SDL_assert(phase < ITU_SYSTEM_PHASE_MAX);
+	ctx_estorage.phases[phase].period = period;
+	ctx_estorage.phases[phase].runs_max = SDL_max(runs_max, 1);
+	ctx_estorage.phases[phase].accumulator = 0;
+}
+
+float itu_sys_estorage_phase_alpha(ITU_SystemPhase phase)
+{
+	ITU_PhaseState* state = &ctx_estorage.phases[phase];
+	return state->period > 0 ? (float)state->accumulator / (float)state->period : 0;
+}
+
+int itu_sys_estorage_phase_runs_count(ITU_SystemPhase phase)
+{
+	return ctx_estorage.phases[phase].runs_count;
+}
+
+// timings
+struct ITU_TimingStats
+{
+	float min_ms;
+	float avg_ms;
+	float p99_ms;
+};
+
+// maps the i-th oldest recorded frame to its slot in the history
+int itu_timings_slot(int i)
+{
+	int oldest = ctx_estorage.timings_frame - ctx_estorage.timings_frames_count;
+	return (oldest + i + SYSTEM_TIMINGS_HISTORY_COUNT) % SYSTEM_TIMINGS_HISTORY_COUNT;
+}
+
+int itu_timings_compare(const void* a, const void* b)
+{
+	Uint64 va = *(const Uint64*)a;
+	Uint64 vb = *(const Uint64*)b;
+	return va < vb ? -1 : va > vb;
+}
+
+ITU_TimingStats itu_timings_stats(Uint64* history)
+{
+	ITU_TimingStats ret = { };
+	int count = ctx_estorage.timings_frames_count;
+	if(count == 0)
+		return ret;
+
+	Uint64 sorted[SYSTEM_TIMINGS_HISTORY_COUNT];
+	Uint64 sum = 0;
+	for(int i = 0; i < count; ++i)
+	{
+		sorted[i] = history[itu_timings_slot(i)];
+		sum += sorted[i];
+	}
+	SDL_qsort(sorted, count, sizeof(Uint64), itu_timings_compare);
+
+	ret.min_ms = (float)sorted[0] / (float)MILLIS(1);
+	ret.avg_ms = (float)sum / count / (float)MILLIS(1);
+	ret.p99_ms = (float)sorted[(count - 1) * 99 / 100] / (float)MILLIS(1);
+	return ret;
 }
 
-void itu_sys_estorage_systems_update(SDLContext* context)
+bool itu_sys_estorage_timings_export(const char* path)
+{
+	SDL_IOStream* stream = SDL_IOFromFile(path, "w");
+	if(!stream)
+	{
+		SDL_Log("ERROR could not open '%s': %s\n", path, SDL_GetError());
+		return false;
+	}
+
+	SDL_IOprintf(stream, "frame");
+	for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		SDL_IOprintf(stream, ",%s", ctx_estorage.systems[i].name);
+	SDL_IOprintf(stream, ",structural_changes\n");
+
+	for(int i = 0; i < ctx_estorage.timings_frames_count; ++i)
+	{
+		int slot = itu_timings_slot(i);
+		SDL_IOprintf(stream, "%d", i);
+		for(int j = 0; j < ctx_estorage.systems_count; ++j)
+			SDL_IOprintf(stream, ",%.4f", (float)ctx_estorage.systems[j].time_history[slot] / (float)MILLIS(1));
+		SDL_IOprintf(stream, ",%.4f\n", (float)ctx_estorage.time_sync_history[slot] / (float)MILLIS(1));
+	}
+
+	return SDL_CloseIO(stream);
+}
+
+Uint64 itu_sys_estorage_timings_last_total()
+{
+	if(ctx_estorage.timings_frames_count == 0)
+		return 0;
+
+	int slot = itu_timings_slot(ctx_estorage.timings_frames_count - 1);
+	Uint64 ret = ctx_estorage.time_sync_history[slot];
+	for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		ret += ctx_estorage.systems[i].time_history[slot];
+	return ret;
+}
+
+void itu_sys_estorage_timings_last_log()
 {
+	if(ctx_estorage.timings_frames_count == 0)
+		return;
+
+	int slot = itu_timings_slot(ctx_estorage.timings_frames_count - 1);
 	for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		if(ctx_estorage.systems[i].time_history[slot] > 0)
+			SDL_Log("    %8.3f ms  %s\n", (float)ctx_estorage.systems[i].time_history[slot] / (float)MILLIS(1), ctx_estorage.systems[i].name);
+	SDL_Log("    %8.3f ms  (structural changes)\n", (float)ctx_estorage.time_sync_history[slot] / (float)MILLIS(1));
+}
+
+ImU32 itu_timings_color(int system_index)
+{
+	// golden ratio hue steps, so that neighbouring systems get distinct colors
+	float hue = SDL_fmodf(system_index * 0.618034f, 1.0f);
+	return ImColor::HSV(hue, 0.6f, 0.9f);
+}
+
+// one stacked bar per recorded frame, one colored block per system (structural changes on top, in gray)
+void itu_timings_graph_render(float height)
+{
+	int frames_count = ctx_estorage.timings_frames_count;
+	ImVec2 size = ImVec2(ImGui::GetContentRegionAvail().x, height);
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImGui::InvisibleButton("##debug_estorage_timings_graph", size);
+	if(frames_count == 0)
+		return;
+
+	Uint64 frame_max = 1;
+	for(int f = 0; f < frames_count; ++f)
+	{
+		int slot = itu_timings_slot(f);
+		Uint64 frame_total = ctx_estorage.time_sync_history[slot];
+		for(int i = 0; i < ctx_estorage.systems_count; ++i)
+			frame_total += ctx_estorage.systems[i].time_history[slot];
+		frame_max = SDL_max(frame_max, frame_total);
+	}
+
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	draw_list->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(0, 0, 0, 128));
+
+	float bar_w = size.x / SYSTEM_TIMINGS_HISTORY_COUNT;
+	float scale = size.y / (float)frame_max;
+	for(int f = 0; f < frames_count; ++f)
+	{
+		int slot = itu_timings_slot(f);
+		float x = origin.x + (SYSTEM_TIMINGS_HISTORY_COUNT - frames_count + f) * bar_w;
+		float y = origin.y + size.y;
+		for(int i = 0; i <= ctx_estorage.systems_count; ++i)
+		{
+			bool is_sync = i == ctx_estorage.systems_count;
+			float h = (is_sync ? ctx_estorage.time_sync_history[slot] : ctx_estorage.systems[i].time_history[slot]) * scale;
+			draw_list->AddRectFilled(ImVec2(x, y - h), ImVec2(x + bar_w, y), is_sync ? IM_COL32(128, 128, 128, 255) : itu_timings_color(i));
+			y -= h;
+		}
+	}
+
+	if(ImGui::IsItemHovered() && ImGui::BeginTooltip())
 	{
-		ITU_System* system = &ctx_estorage.systems[i];
-		ITU_EntityId system_ids[ENTITIES_COUNT_MAX];
-		int system_ids_count = itu_system_get_matching_entities(system, system_ids);
+		int f = (int)((ImGui::GetIO().MousePos.x - origin.x) / bar_w) - (SYSTEM_TIMINGS_HISTORY_COUNT - frames_count);
+		if(f >= 0 && f < frames_count)
+		{
+			int slot = itu_timings_slot(f);
+			for(int i = 0; i < ctx_estorage.systems_count; ++i)
+				ImGui::Text("%6.3f ms  %s", (float)ctx_estorage.systems[i].time_history[slot] / (float)MILLIS(1), ctx_estorage.systems[i].name);
+			ImGui::Text("%6.3f ms  (structural changes)", (float)ctx_estorage.time_sync_history[slot] / (float)MILLIS(1));
+		}
+		ImGui::EndTooltip();
+	}
+}
+
+Uint32 itu_sys_estorage_tick()
+{
+	return ctx_estorage.tick;
+}
+
+Uint32 itu_sys_estorage_system_tick_last_run()
+{
+	return system_current ? system_current->tick_last_run : 0;
+}
+
+// rows of the debug UI entity list, rebuilt only when the filter or the entities change
+struct ITU_DebugEntityList
+{
+	stbds_arr(Sint32) rows; // indices of the (valid) entities passing the filter
+	char filter_name[64];
+	Uint64 filter_component_mask;
+	bool filter_changed;
+
+	ITU_World* world_built;
+	Uint32 version_built;
+};
+
+static ITU_DebugEntityList debug_entity_list = { };
+
+void itu_debug_entity_list_refresh()
+{
+	ITU_DebugEntityList* list = &debug_entity_list;
+	if(!list->filter_changed && list->world_built == world_current && list->version_built == ctx_estorage.entities_version)
+		return;
+
+	stbds_arrsetlen(list->rows, 0);
+	for(int i = 0; i < stbds_arrlen(ctx_estorage.entities); ++i)
+	{
+		ITU_Entity* entity = &ctx_estorage.entities[i];
+		if(!itu_entity_is_valid(entity->id))
+			continue;
+		if((entity->component_mask & list->filter_component_mask) != list->filter_component_mask)
+			continue;
+		if(list->filter_name[0])
+		{
+			const char* debug_name = itu_entity_get_debug_name(entity->id);
+			if(!debug_name || !SDL_strcasestr(debug_name, list->filter_name))
+				continue;
+		}
+		stbds_arrput(list->rows, i);
+	}
+
+	list->filter_changed = false;
+	list->world_built = world_current;
+	list->version_built = ctx_estorage.entities_version;
+}
 
-		system->fn_update(context, system_ids, system_ids_count);
+void itu_debug_entity_list_filter_render()
+{
+	ITU_DebugEntityList* list = &debug_entity_list;
+	ImGui::SetNextItemWidth(-FLT_MIN);
+	if(ImGui::InputTextWithHint("##debug_estorage_master_entities_filter_name", "filter by name", list->filter_name, sizeof(list->filter_name)))
+		list->filter_changed = true;
+
+	int filter_components_count = 0;
+	for(Uint64 mask = list->filter_component_mask; mask; mask &= mask - 1)
+		++filter_components_count;
+	char preview[32];
+	if(filter_components_count == 0)
+		SDL_strlcpy(preview, "any component", sizeof(preview));
+	else
+		SDL_snprintf(preview, sizeof(preview), "%d component(s)", filter_components_count);
+
+	ImGui::SetNextItemWidth(-FLT_MIN);
+	if(ImGui::BeginCombo("##debug_estorage_master_entities_filter_components", preview))
+	{
+		for(int i = 0; i < ctx_estorage.components_count; ++i)
+		{
+			bool selected = list->filter_component_mask & (1ull << i);
+			if(ImGui::Selectable(ctx_estorage.components[i]->name, selected, ImGuiSelectableFlags_DontClosePopups))
+			{
+				list->filter_component_mask ^= 1ull << i;
+				list->filter_changed = true;
+			}
+		}
+		ImGui::EndCombo();
 	}
 }
 
@@ -302,10 +1428,11 @@ void itu_sys_estorage_debug_render_detail_entity(SDLContext* context, ITU_Entity
 	{
 		ImGui::CollapsingHeader("tags", ImGuiTreeNodeFlags_Leaf);
 		int num_tags = 0;
-		for(int i = 0; i < TAGS_COUNT_MAX; ++i)
+		Uint64 tag_mask = ctx_estorage.entities[id.index].tag_mask;
+		while(tag_mask)
 		{
-			if(stbds_hmgeti(ctx_estorage.tags[i], id) == -1)
-				continue;
+			int i = bit_index_lowest(tag_mask);
+			tag_mask &= tag_mask - 1;
 
 			++num_tags;
 			// TODO also wrap single tag (idx + name) rendering in appropriate function
@@ -329,15 +1456,26 @@ void itu_sys_estorage_debug_render_detail_entity(SDLContext* context, ITU_Entity
 		ImGui::CollapsingHeader(ctx_estorage.components[i]->name, ImGuiTreeNodeFlags_Leaf);
 		{
 			if(ctx_estorage.components[i]->fn_debug_ui_render)
+			{
+				// NOTE: the group forwards the "edited" state of the widgets inside it, so that only an actual edit
+				//       marks the component as changed (just looking at an entity must not trigger change detection)
+				ImGui::BeginGroup();
 				ctx_estorage.components[i]->fn_debug_ui_render(context, component_data);
+				ImGui::EndGroup();
+				if(ImGui::IsItemEdited())
+					itu_entity_mark_changed(id, i);
+			}
 			else
 				ImGui::Text("TODO NotYetImplemented");
 		}
 	}
 }
 
-void itu_sys_estorage_debug_render_detail_system(SDLContext* context, ITU_System* system, ITU_EntityId* system_ids, int system_ids_count)
+void itu_sys_estorage_debug_render_detail_system(SDLContext* context, ITU_System* system)
 {
+	ITU_EntityId* system_ids = system->matches.entities;
+	int system_ids_count = stbds_arrlen(system->matches.entities);
+
 	ImGui::CollapsingHeader("components", ImGuiTreeNodeFlags_Leaf);
 	for(int i = 0; i < system->components_count; ++i)
 		ImGui::Text("%s", system->components[i]->name);
@@ -363,79 +1501,87 @@ void itu_sys_estorage_debug_render_detail_system(SDLContext* context, ITU_System
 
 	ImGui::CollapsingHeader("currently iterated entities", ImGuiTreeNodeFlags_Leaf);
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
-	for(int i = 0; i < system_ids_count; ++i)
+	ImGuiListClipper clipper;
+	clipper.Begin(system_ids_count);
+	while(clipper.Step())
 	{
-		char buf[8];
-		SDL_snprintf(buf, 8, "%d", i);
-		itu_debug_ui_widget_entityid((char*)buf, system_ids[i]);
+		for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+		{
+			char buf[8];
+			SDL_snprintf(buf, 8, "%d", i);
+			itu_debug_ui_widget_entityid((char*)buf, system_ids[i]);
+		}
 	}
 	ImGui::PopStyleVar();
 }
 
 void itu_sys_estorage_debug_render(SDLContext* context)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_UI);
 	static ITU_SysEstorageDebugDetailCategory detail_category = ITU_SYS_ESTORAGE_DETAIL_CATEGORY_MAX;
 	static int loc_selected = -1;
 
-	ITU_EntityId selected_system_ids[ENTITIES_COUNT_MAX];
-	int selected_system_ids_count;
-
 	ImGui::BeginChild("debug_estorage_master", ImVec2(200, 0), ImGuiChildFlags_Border | ImGuiChildFlags_ResizeX);
 	{
 		if(ImGui::CollapsingHeader("Entities", ImGuiTreeNodeFlags_DefaultOpen))
 		{
-			int entities_count = stbds_arrlen(ctx_estorage.entities);
+			itu_debug_entity_list_filter_render();
+			itu_debug_entity_list_refresh();
+
 			if(ImGui::BeginTable("debug_estorage_master_entities", 5, ImGuiTableFlags_SizingFixedFit))
 			{
-
 				ImGui::TableSetupColumn("");
 				ImGui::TableSetupColumn("");
 				ImGui::TableSetupColumn("name");
 				ImGui::TableSetupColumn("gen");
 				ImGui::TableSetupColumn("idx");
 				ImGui::TableHeadersRow();
-				int row_idx = 0;
-				for(int i = 0; i < entities_count; ++i)
-				{
-					ITU_EntityId id = ctx_estorage.entities[i].id;
-					if(!itu_entity_is_valid(id))
-						continue;
-					ImGui::TableNextRow();
 
-					ImGui::TableNextColumn();
-					char buf_del[48];
-					SDL_snprintf(buf_del, 48, "X##%3ddebug_estorage_master_entities", row_idx);
-					if(ImGui::Button(buf_del))
-					{
-						itu_entity_destroy(id);
-						loc_selected = -1;
-					}
-
-					ImGui::TableNextColumn();
-					char buf_id[48];
-					SDL_snprintf(buf_id, 48, "%3d##debug_estorage_master_entities", row_idx);
-					if(ImGui::Selectable(
-						buf_id,
-						detail_category == ITU_SYS_ESTORAGE_DETAIL_CATEGORY_ENTITY && row_idx == loc_selected,
-						ImGuiSelectableFlags_SpanAllColumns
-					))
+				// NOTE: only visible rows are built
+				ImGuiListClipper clipper;
+				clipper.Begin(stbds_arrlen(debug_entity_list.rows));
+				while(clipper.Step())
+				{
+					for(int row_idx = clipper.DisplayStart; row_idx < clipper.DisplayEnd; ++row_idx)
 					{
-						loc_selected = i;
-						detail_category = ITU_SYS_ESTORAGE_DETAIL_CATEGORY_ENTITY;
+						int i = debug_entity_list.rows[row_idx];
+						ITU_EntityId id = ctx_estorage.entities[i].id;
+						ImGui::PushID(row_idx);
+						ImGui::TableNextRow();
+
+						ImGui::TableNextColumn();
+						if(ImGui::Button("X"))
+						{
+							itu_entity_destroy(id);
+							loc_selected = -1;
+						}
+
+						ImGui::TableNextColumn();
+						if(ImGui::Selectable(
+							"##debug_estorage_master_entities",
+							detail_category == ITU_SYS_ESTORAGE_DETAIL_CATEGORY_ENTITY && i == loc_selected,
+							ImGuiSelectableFlags_SpanAllColumns
+						))
+						{
+							loc_selected = i;
+							detail_category = ITU_SYS_ESTORAGE_DETAIL_CATEGORY_ENTITY;
+						}
+						ImGui::SameLine();
+						ImGui::Text("%3d", row_idx);
+
+						ImGui::TableNextColumn();
+						const char* debug_name = itu_entity_get_debug_name(id);
+						if(debug_name)
+							ImGui::TextUnformatted(debug_name);
+
+						ImGui::TableNextColumn();
+						ImGui::Text("%d", id.generation);
+
+						ImGui::TableNextColumn();
+						ImGui::Text("%d", id.index);
+
+						ImGui::PopID();
 					}
-
-					ImGui::TableNextColumn();
-					int pos_debug_name = stbds_hmgeti(ctx_estorage.entities_debug_names, id);
-					if(pos_debug_name != -1)
-						ImGui::Text("%s", ctx_estorage.entities_debug_names[pos_debug_name].value);
-
-					ImGui::TableNextColumn();
-					ImGui::Text("%d", id.generation);
-
-					ImGui::TableNextColumn();
-					ImGui::Text("%d", id.index);
-
-					++row_idx;
 				}
 
 				ImGui::EndTable();
@@ -444,9 +1590,11 @@ void itu_sys_estorage_debug_render(SDLContext* context)
 
 		if(ImGui::CollapsingHeader("Systems", ImGuiTreeNodeFlags_DefaultOpen))
 		{
-			if(ImGui::BeginTable("debug_estorage_master_systems", 5, ImGuiTableFlags_SizingFixedFit))
+			if(ImGui::BeginTable("debug_estorage_master_systems", 7, ImGuiTableFlags_SizingFixedFit))
 			{
 				ImGui::TableSetupColumn("");
+				ImGui::TableSetupColumn("phase");
+				ImGui::TableSetupColumn("wave");
 				ImGui::TableSetupColumn("name");
 				ImGui::TableSetupColumn("comp");
 				ImGui::TableSetupColumn("tags");
@@ -470,6 +1618,18 @@ void itu_sys_estorage_debug_render(SDLContext* context)
 						detail_category = ITU_SYS_ESTORAGE_DETAIL_CATEGORY_SYSTEM;
 					}
 
+					ImGui::TableNextColumn();
+					if(system->time_slices > 1)
+						ImGui::Text("%s (1/%d)", itu_system_phase_names[system->phase], system->time_slices);
+					else
+						ImGui::Text("%s", itu_system_phase_names[system->phase]);
+
+					ImGui::TableNextColumn();
+					if(itu_system_is_exclusive(system))
+						ImGui::Text("%d (excl)", system->wave);
+					else
+						ImGui::Text("%d", system->wave);
+
 					ImGui::TableNextColumn();
 					ImGui::Text("%s", system->name);
 
@@ -480,27 +1640,89 @@ void itu_sys_estorage_debug_render(SDLContext* context)
 					ImGui::Text("%d", system->tags_count);
 
 					ImGui::TableNextColumn();
-					ITU_EntityId scratch_system_ids[ENTITIES_COUNT_MAX];
-					int scratch_system_ids_count;
+					ImGui::Text("%d", (int)stbds_arrlen(system->matches.entities));
+				}
 
-					ITU_EntityId* system_ids;
-					int* system_ids_count;
+				ImGui::EndTable();
+			}
+		}
 
-					if(detail_category == ITU_SYS_ESTORAGE_DETAIL_CATEGORY_SYSTEM && i == loc_selected)
-					{
-						system_ids = selected_system_ids;
-						system_ids_count = &selected_system_ids_count;
-					}
-					else
+		if(ImGui::CollapsingHeader("Timings"))
+		{
+			itu_timings_graph_render(80);
+
+			if(ImGui::BeginTable("debug_estorage_master_timings", 5, ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("");
+				ImGui::TableSetupColumn("name");
+				ImGui::TableSetupColumn("min");
+				ImGui::TableSetupColumn("avg");
+				ImGui::TableSetupColumn("p99");
+				ImGui::TableHeadersRow();
+				for(int i = 0; i <= ctx_estorage.systems_count; ++i)
+				{
+					bool is_sync = i == ctx_estorage.systems_count;
+					ITU_TimingStats stats = itu_timings_stats(is_sync ? ctx_estorage.time_sync_history : ctx_estorage.systems[i].time_history);
+					ImGui::TableNextRow();
+					ImGui::PushID(i);
+
+					ImGui::TableNextColumn();
+					ImU32 color = is_sync ? IM_COL32(128, 128, 128, 255) : itu_timings_color(i);
+					ImGui::ColorButton("##debug_estorage_master_timings_color", ImGui::ColorConvertU32ToFloat4(color), ImGuiColorEditFlags_NoTooltip, ImVec2(10, 10));
+
+					ImGui::TableNextColumn();
+					ImGui::Text("%s", is_sync ? "(structural changes)" : ctx_estorage.systems[i].name);
+
+					ImGui::TableNextColumn();
+					ImGui::Text("%6.3f", stats.min_ms);
+
+					ImGui::TableNextColumn();
+					ImGui::Text("%6.3f", stats.avg_ms);
+
+					ImGui::TableNextColumn();
+					ImGui::Text("%6.3f", stats.p99_ms);
+					ImGui::PopID();
+				}
+
+				ImGui::EndTable();
+			}
+
+			if(ImGui::Button("export CSV##debug_estorage_master_timings"))
+				itu_sys_estorage_timings_export("system_timings.csv");
+		}
+
+		if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE && ImGui::CollapsingHeader("Archetypes"))
+		{
+			if(ImGui::BeginTable("debug_estorage_master_archetypes", 4, ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("mask");
+				ImGui::TableSetupColumn("comp");
+				ImGui::TableSetupColumn("entities");
+				ImGui::TableSetupColumn("chunks");
+				ImGui::TableHeadersRow();
+				for(int i = 0; i < stbds_arrlen(ctx_estorage.archetypes); ++i)
+				{
+					ITU_Archetype* archetype = ctx_estorage.archetypes[i];
+					ImGui::TableNextRow();
+
+					ImGui::TableNextColumn();
+					ImGui::Text("%016llx", archetype->component_mask);
+					if(ImGui::IsItemHovered() && ImGui::BeginTooltip())
 					{
-						system_ids = scratch_system_ids;
-						system_ids_count = &scratch_system_ids_count;
+						for(int j = 0; j < archetype->columns_count; ++j)
+							ImGui::Text("%s", ctx_estorage.components[archetype->column_types[j]]->name);
+						ImGui::EndTooltip();
 					}
 
-					*system_ids_count = itu_system_get_matching_entities(system, system_ids);
-					ImGui::Text("%d", *system_ids_count);
-				}
+					ImGui::TableNextColumn();
+					ImGui::Text("%d", archetype->columns_count);
 
+					ImGui::TableNextColumn();
+					ImGui::Text("%d", archetype->count_alive);
+
+					ImGui::TableNextColumn();
+					ImGui::Text("%d (%d/chunk)", (int)stbds_arrlen(archetype->chunks), archetype->chunk_capacity);
+				}
 				ImGui::EndTable();
 			}
 		}
@@ -514,7 +1736,7 @@ void itu_sys_estorage_debug_render(SDLContext* context)
 			switch(detail_category)
 			{
 				case ITU_SYS_ESTORAGE_DETAIL_CATEGORY_ENTITY: itu_sys_estorage_debug_render_detail_entity(context, ctx_estorage.entities[loc_selected].id); break;
-				case ITU_SYS_ESTORAGE_DETAIL_CATEGORY_SYSTEM: itu_sys_estorage_debug_render_detail_system(context, &ctx_estorage.systems[loc_selected], selected_system_ids, selected_system_ids_count); break;
+				case ITU_SYS_ESTORAGE_DETAIL_CATEGORY_SYSTEM: itu_sys_estorage_debug_render_detail_system(context, &ctx_estorage.systems[loc_selected]); break;
 				default: /* do nothing */ break;
 			}
 		ImGui::EndChild();
@@ -525,19 +1747,22 @@ void itu_sys_estorage_debug_render(SDLContext* context)
 
 void itu_sys_estorage_tag_set_debug_name(int tag, const char* tag_debug_name)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
 	stbds_hmput(ctx_estorage.tag_debug_names, tag, tag_debug_name);
 }
 
 void itu_component_pool_assign(ITU_Component* component_pool, ITU_EntityId entity)
 {
 	SDL_assert(component_pool);
-	SDL_assert(component_pool->count_alive < component_pool->count_max);
+	SDL_assert(itu_component_pool_loc_get(component_pool, entity.index) == -1);
 
-	// TODO check that requested entry is actually free
+	if(component_pool->count_alive == component_pool->count_max)
+		itu_component_pool_reserve(component_pool, SDL_max(component_pool->count_max * 2, COMPONENT_POOL_CAPACITY_DEFAULT));
 
-	Uint64 i = component_pool->count_alive++;
-	component_pool->data_loc[entity.index] = i;
+	Sint32 i = component_pool->count_alive++;
+	itu_component_pool_loc_set(component_pool, entity.index, i);
 	component_pool->entity_ids[i] = entity;
+	component_pool->changed_ticks[i] = ctx_estorage.tick;
 	SDL_memset((unsigned char*)component_pool->data + component_pool->element_size * i, 0, component_pool->element_size);
 }
 
@@ -545,7 +1770,7 @@ void itu_component_pool_data_get(ITU_Component* component_pool, ITU_EntityId ent
 {
 	SDL_assert(component_pool);
 
-	Uint64 loc = component_pool->data_loc[entity.index];
+	Sint32 loc = itu_component_pool_loc_get(component_pool, entity.index);
 	void* data = pointer_offset(void, component_pool->data, component_pool->element_size * loc);
 	SDL_memcpy(out_data_copy, data, component_pool->element_size);
 }
@@ -554,7 +1779,7 @@ void itu_component_pool_data_set(ITU_Component* component_pool, ITU_EntityId ent
 {
 	SDL_assert(component_pool);
 
-	Uint64 loc = component_pool->data_loc[entity.index];
+	Sint32 loc = itu_component_pool_loc_get(component_pool, entity.index);
 	void* data = pointer_offset(void, component_pool->data, component_pool->element_size * loc);
 	SDL_memcpy(data, in_data_copy, component_pool->element_size);
 }
@@ -562,11 +1787,16 @@ void itu_component_pool_data_set(ITU_Component* component_pool, ITU_EntityId ent
 void itu_component_pool_remove(ITU_Component* component_pool, ITU_EntityId entity)
 {
 	SDL_assert(component_pool);
-	SDL_assert(component_pool->data_loc[entity.index] != -1);
 
-	Uint64 loc_curr = entity.index;
-	Uint64 loc_last = component_pool->count_alive - 1;
-	component_pool->entity_ids[loc_curr] = component_pool->entity_ids[loc_last];
+	Sint32 loc_curr = itu_component_pool_loc_get(component_pool, entity.index);
+	Sint32 loc_last = component_pool->count_alive - 1;
+	SDL_assert(loc_curr != -1);
+
+	ITU_EntityId entity_last = component_pool->entity_ids[loc_last];
+	component_pool->entity_ids[loc_curr] = entity_last;
+	component_pool->changed_ticks[loc_curr] = component_pool->changed_ticks[loc_last];
+	itu_component_pool_loc_set(component_pool, entity_last.index, loc_curr);
+	itu_component_pool_loc_set(component_pool, entity.index, -1);
 
 	void* ptr_curr = pointer_offset(void, component_pool->data, loc_curr * component_pool->element_size);
 	void* ptr_last = pointer_offset(void, component_pool->data, loc_last * component_pool->element_size);
@@ -575,47 +1805,289 @@ void itu_component_pool_remove(ITU_Component* component_pool, ITU_EntityId entit
 	component_pool->count_alive--;
 }
 
+void itu_component_pool_swap(ITU_Component* component_pool, Sint32 loc_a, Sint32 loc_b)
+{
+	ITU_EntityId id_a = component_pool->entity_ids[loc_a];
+	ITU_EntityId id_b = component_pool->entity_ids[loc_b];
+	component_pool->entity_ids[loc_a] = id_b;
+	component_pool->entity_ids[loc_b] = id_a;
+	itu_component_pool_loc_set(component_pool, id_a.index, loc_b);
+	itu_component_pool_loc_set(component_pool, id_b.index, loc_a);
+
+	Uint32 tick_a = component_pool->changed_ticks[loc_a];
+	component_pool->changed_ticks[loc_a] = component_pool->changed_ticks[loc_b];
+	component_pool->changed_ticks[loc_b] = tick_a;
+
+	itu_memswap(
+		pointer_offset(void, component_pool->data, loc_a * component_pool->element_size),
+		pointer_offset(void, component_pool->data, loc_b * component_pool->element_size),
+		component_pool->element_size
+	);
+}
+
+// NOTE: keeps the dense arrays allocated (we'll likely need them again), but frees the sparse pages
 void itu_component_pool_clear(ITU_Component* component_pool)
 {
 	SDL_assert(component_pool);
 
 	component_pool->count_alive = 0;
+	for(int i = 0; i < stbds_arrlen(component_pool->data_loc_pages); ++i)
+		SDL_free(component_pool->data_loc_pages[i]);
+	stbds_arrfree(component_pool->data_loc_pages);
 }
 
 
-ITU_EntityId itu_entity_create()
+// takes a free entity slot (recycled if possible), with no components and no tags
+ITU_Entity* itu_entity_slot_alloc()
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	ctx_estorage.entities_version++;
 	if(stbds_arrlen(ctx_estorage.entities_free) > 0)
 	{
 		ITU_EntityId id_recycled = stbds_arrpop(ctx_estorage.entities_free);
-		ctx_estorage.entities[id_recycled.index].id.index = id_recycled.index;
-		ctx_estorage.entities[id_recycled.index].id.generation = id_recycled.generation + 1;
-		return ctx_estorage.entities[id_recycled.index].id;
+		ITU_Entity* entity = &ctx_estorage.entities[id_recycled.index];
+		entity->id.index = id_recycled.index;
+		entity->id.generation = id_recycled.generation + 1;
+		return entity;
 	}
 
 	ITU_Entity entity_data;
 	entity_data.id.generation = 0;
 	entity_data.id.index = stbds_arrlen(ctx_estorage.entities);
 	entity_data.component_mask = 0;
+	entity_data.tag_mask = 0;
+	entity_data.archetype = -1;
+	entity_data.archetype_row = 0;
 	stbds_arrput(ctx_estorage.entities, entity_data);
 
-	return entity_data.id;
+	return &stbds_arrlast(ctx_estorage.entities);
 }
 
-void  itu_entity_set_debug_name(ITU_EntityId id, const char* debug_name)
+ITU_EntityId itu_entity_create()
 {
-	// NOTE: allocating every single name is BAD, but we haven't looked in allocaiton startegies and memory arenas yet
-	int len = SDL_strlen(debug_name);
-	char* name_storage = (char*)SDL_malloc(len + 1);
-	SDL_memcpy(name_storage, debug_name, len);
-	name_storage[len] = 0;
+	SDL_assert(!ctx_estorage.systems_parallel); // only exclusive systems can do immediate structural changes (use `itu_entity_deferred_*`)
 
-	stbds_hmput(ctx_estorage.entities_debug_names, id, name_storage);
-}
+	ITU_Entity* entity = itu_entity_slot_alloc();
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		// new entities start in the empty archetype
+		entity->archetype = itu_archetype_get_or_create(0);
+		entity->archetype_row = itu_archetype_row_add(ctx_estorage.archetypes[entity->archetype], entity->id);
+	}
+
+	return entity->id;
+}
+
+void itu_prefab_component_set(ITU_Prefab* prefab, ITU_ComponentType component_type, void* in_data_copy)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	SDL_assert(component_type < ctx_estorage.components_count);
+	Uint64 element_size = ctx_estorage.components[component_type]->element_size;
+
+	if(!(prefab->component_mask & (1ull << component_type)))
+	{
+		prefab->component_mask |= 1ull << component_type;
+		prefab->data_offsets[component_type] = stbds_arrlen(prefab->data);
+		stbds_arraddnptr(prefab->data, element_size);
+	}
+
+	void* data = prefab->data + prefab->data_offsets[component_type];
+	if(in_data_copy)
+		SDL_memcpy(data, in_data_copy, element_size);
+	else
+		SDL_memset(data, 0, element_size);
+}
+
+void itu_prefab_tag_add(ITU_Prefab* prefab, ITU_TagType tag)
+{
+	SDL_assert(tag < TAGS_COUNT_MAX);
+	prefab->tag_mask |= 1ull << tag;
+}
+
+void itu_prefab_free(ITU_Prefab* prefab)
+{
+	stbds_arrfree(prefab->data);
+	SDL_memset(prefab, 0, sizeof(ITU_Prefab));
+}
+
+// fills `count` consecutive elements with copies of `value`, doubling the size of every copy
+void itu_memfill(void* dst, void* value, Uint64 element_size, int count)
+{
+	if(count == 0)
+		return;
+
+	SDL_memcpy(dst, value, element_size);
+	Uint64 size_filled = element_size;
+	Uint64 size_total = element_size * count;
+	while(size_filled < size_total)
+	{
+		Uint64 size_copy = SDL_min(size_filled, size_total - size_filled);
+		SDL_memcpy((unsigned char*)dst + size_filled, dst, size_copy);
+		size_filled += size_copy;
+	}
+}
+
+void itu_entity_create_batch(ITU_Prefab* prefab, int count, ITU_EntityId* out_ids)
+{
+	SDL_assert(!ctx_estorage.systems_parallel); // only exclusive systems can do immediate structural changes (use `itu_entity_deferred_*`)
+
+	// reserve all ids first
+	for(int i = 0; i < count; ++i)
+	{
+		ITU_Entity* entity = itu_entity_slot_alloc();
+		entity->component_mask = prefab->component_mask;
+		entity->tag_mask = prefab->tag_mask;
+		out_ids[i] = entity->id;
+	}
+
+	// one pass per pool (or per archetype column)
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		Sint32 archetype_idx = itu_archetype_get_or_create(prefab->component_mask);
+		ITU_Archetype* archetype = ctx_estorage.archetypes[archetype_idx];
+		// NOTE: rows are reserved in one go and written only once below (no zero-initialization first)
+		Uint32 row_first = itu_archetype_rows_reserve(archetype, count);
+		for(int i = 0; i < count; ++i)
+		{
+			Uint32 row = row_first + i;
+			ITU_Entity* entity = &ctx_estorage.entities[out_ids[i].index];
+			entity->archetype = archetype_idx;
+			entity->archetype_row = row;
+			((ITU_EntityId*)archetype->chunks[row / archetype->chunk_capacity])[row % archetype->chunk_capacity] = entity->id;
+		}
+
+		// rows are consecutive, but they may span multiple chunks
+		for(int column = 0; column < archetype->columns_count; ++column)
+		{
+			ITU_ComponentType component_type = archetype->column_types[column];
+			ITU_Component* component = ctx_estorage.components[component_type];
+			component->count_alive += count;
+
+			void* value = prefab->data + prefab->data_offsets[component_type];
+			for(Uint32 row = row_first; row < row_first + count; )
+			{
+				Uint32 rows_in_chunk = SDL_min(archetype->chunk_capacity - row % archetype->chunk_capacity, row_first + count - row);
+				itu_memfill(itu_archetype_data_get(archetype, row, column), value, component->element_size, rows_in_chunk);
+				row += rows_in_chunk;
+			}
+		}
+	}
+	else
+	{
+		for(int i = 0; i < ctx_estorage.components_count; ++i)
+		{
+			if(!(prefab->component_mask & (1ull << i)))
+				continue;
+
+			ITU_Component* component = ctx_estorage.components[i];
+			itu_component_pool_reserve(component, component->count_alive + count);
+
+			Sint32 loc_first = component->count_alive;
+			for(int j = 0; j < count; ++j)
+			{
+				itu_component_pool_loc_set(component, out_ids[j].index, loc_first + j);
+				component->entity_ids[loc_first + j] = out_ids[j];
+				component->changed_ticks[loc_first + j] = ctx_estorage.tick;
+			}
+			itu_memfill(pointer_index(component->data, loc_first, component->element_size), prefab->data + prefab->data_offsets[i], component->element_size, count);
+			component->count_alive += count;
+		}
+	}
+
+	Uint64 tag_mask = prefab->tag_mask;
+	while(tag_mask)
+	{
+		int tag = bit_index_lowest(tag_mask);
+		tag_mask &= tag_mask - 1;
+		for(int i = 0; i < count; ++i)
+			itu_entity_set_add(&ctx_estorage.tags[tag], out_ids[i]);
+	}
+
+	for(int i = 0; i < count; ++i)
+		itu_systems_entity_signature_changed(out_ids[i].index);
+}
+
+#if ITU_ENTITY_DEBUG_NAMES
+void itu_entity_debug_name_clear(Uint32 entity_index)
+{
+	if(entity_index >= stbds_arrlen(ctx_estorage.entities_debug_names) || ctx_estorage.entities_debug_names[entity_index] == -1)
+		return;
+
+	Sint32 loc = ctx_estorage.entities_debug_names[entity_index];
+	ctx_estorage.entities_debug_names_garbage += SDL_strlen(ctx_estorage.entities_debug_names_arena + loc) + 1;
+	ctx_estorage.entities_debug_names[entity_index] = -1;
+}
+
+// moves all live names at the beginning of the arena
+void itu_entity_debug_names_compact()
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	stbds_arr(char) arena_new = NULL;
+	stbds_arrsetcap(arena_new, stbds_arrlen(ctx_estorage.entities_debug_names_arena) - ctx_estorage.entities_debug_names_garbage);
+	for(int i = 0; i < stbds_arrlen(ctx_estorage.entities_debug_names); ++i)
+	{
+		Sint32 loc = ctx_estorage.entities_debug_names[i];
+		if(loc == -1)
+			continue;
+
+		const char* name = ctx_estorage.entities_debug_names_arena + loc;
+		int len = SDL_strlen(name) + 1;
+		ctx_estorage.entities_debug_names[i] = stbds_arrlen(arena_new);
+		SDL_memcpy(stbds_arraddnptr(arena_new, len), name, len);
+	}
+	stbds_arrfree(ctx_estorage.entities_debug_names_arena);
+	ctx_estorage.entities_debug_names_arena = arena_new;
+	ctx_estorage.entities_debug_names_garbage = 0;
+}
+#endif
+
+void  itu_entity_set_debug_name(ITU_EntityId id, const char* debug_name)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+#if ITU_ENTITY_DEBUG_NAMES
+	ctx_estorage.entities_version++;
+
+	// NOTE: `debug_name` could point inside the names arena (e.g. the name of another entity),
+	//       which gets compacted or reallocated below, so we work on a copy
+	ITU_ArenaTemp scratch = itu_arena_scratch_begin();
+	debug_name = itu_arena_strdup(scratch.arena, debug_name);
+
+	// grow the index on demand
+	int names_len = stbds_arrlen(ctx_estorage.entities_debug_names);
+	if(id.index >= names_len)
+	{
+		stbds_arrsetlen(ctx_estorage.entities_debug_names, id.index + 1);
+		for(int i = names_len; i <= id.index; ++i)
+			ctx_estorage.entities_debug_names[i] = -1;
+	}
+
+	itu_entity_debug_name_clear(id.index);
+	if(ctx_estorage.entities_debug_names_garbage > stbds_arrlen(ctx_estorage.entities_debug_names_arena) / 2)
+		itu_entity_debug_names_compact();
+
+	int len = SDL_strlen(debug_name) + 1;
+	ctx_estorage.entities_debug_names[id.index] = stbds_arrlen(ctx_estorage.entities_debug_names_arena);
+	SDL_memcpy(stbds_arraddnptr(ctx_estorage.entities_debug_names_arena, len), debug_name, len);
+	itu_arena_scratch_end(scratch);
+#endif
+}
+
+// returns NULL if the entity has no name
+// NOTE: the returned string is only valid until the next `itu_entity_set_debug_name` call
+const char* itu_entity_get_debug_name(ITU_EntityId id)
+{
+#if ITU_ENTITY_DEBUG_NAMES
+	if(!itu_entity_is_valid(id) || id.index >= stbds_arrlen(ctx_estorage.entities_debug_names) || ctx_estorage.entities_debug_names[id.index] == -1)
+		return NULL;
+	return ctx_estorage.entities_debug_names_arena + ctx_estorage.entities_debug_names[id.index];
+#else
+	return NULL;
+#endif
+}
 
 bool itu_entity_equals(ITU_EntityId a, ITU_EntityId b)
 {
-	return a.generation == b.generation && a.generation == b.generation;
+	return a.generation == b.generation && a.index == b.index;
 }
 
 bool itu_entity_is_valid(ITU_EntityId id)
@@ -632,6 +2104,7 @@ void itu_entity_id_to_stringid(ITU_EntityId id, char* buffer, int max_len)
 // `in_data_copy`: default component init. Can be null
 void itu_entity_component_add(ITU_EntityId id, ITU_ComponentType component_type, void* in_data_copy)
 {
+	SDL_assert(!ctx_estorage.systems_parallel); // only exclusive systems can do immediate structural changes (use `itu_entity_deferred_*`)
 	SDL_assert(component_type < COMPONENTS_COUNT_MAX);
 	Uint64 component_bit = 1ll << component_type;
 
@@ -650,13 +2123,39 @@ void itu_entity_component_add(ITU_EntityId id, ITU_ComponentType component_type,
 	ctx_estorage.entities[id.index].component_mask |= component_bit;
 
 	ITU_Component* component = ctx_estorage.components[component_type];
-	itu_component_pool_assign(component, id);
-	if(in_data_copy)
-		itu_component_pool_data_set(component, id, in_data_copy);
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		ITU_Entity* entity = &ctx_estorage.entities[id.index];
+		ITU_Archetype* archetype_src = ctx_estorage.archetypes[entity->archetype];
+		if(archetype_src->edge_add[component_type] == -1)
+		{
+			Sint32 archetype_dst_idx = itu_archetype_get_or_create(entity->component_mask);
+			archetype_src->edge_add[component_type] = archetype_dst_idx;
+			ctx_estorage.archetypes[archetype_dst_idx]->edge_remove[component_type] = entity->archetype;
+		}
+		itu_archetype_entity_move(entity, archetype_src->edge_add[component_type]);
+
+		component->count_alive++;
+		if(in_data_copy)
+		{
+			ITU_Archetype* archetype = ctx_estorage.archetypes[entity->archetype];
+			void* data = itu_archetype_data_get(archetype, entity->archetype_row, archetype->column_loc[component_type]);
+			SDL_memcpy(data, in_data_copy, component->element_size);
+		}
+	}
+	else
+	{
+		itu_component_pool_assign(component, id);
+		if(in_data_copy)
+			itu_component_pool_data_set(component, id, in_data_copy);
+	}
+
+	itu_systems_entity_signature_changed(id.index);
 }
 
 void itu_entity_component_remove(ITU_EntityId id, ITU_ComponentType component_type)
 {
+	SDL_assert(!ctx_estorage.systems_parallel); // only exclusive systems can do immediate structural changes (use `itu_entity_deferred_*`)
 	SDL_assert(component_type < COMPONENTS_COUNT_MAX);
 	Uint64 component_bit = 1ll << component_type;
 	
@@ -675,7 +2174,26 @@ void itu_entity_component_remove(ITU_EntityId id, ITU_ComponentType component_ty
 	ctx_estorage.entities[id.index].component_mask &= ~component_bit; // keeps all bits of `id.component_mask` the same except for component_bit, which is set to 0
 
 	ITU_Component* component = ctx_estorage.components[component_type];
-	itu_component_pool_remove(component, id);
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		ITU_Entity* entity = &ctx_estorage.entities[id.index];
+		ITU_Archetype* archetype_src = ctx_estorage.archetypes[entity->archetype];
+		if(archetype_src->edge_remove[component_type] == -1)
+		{
+			Sint32 archetype_dst_idx = itu_archetype_get_or_create(entity->component_mask);
+			archetype_src->edge_remove[component_type] = archetype_dst_idx;
+			ctx_estorage.archetypes[archetype_dst_idx]->edge_add[component_type] = entity->archetype;
+		}
+		itu_archetype_entity_move(entity, archetype_src->edge_remove[component_type]);
+
+		component->count_alive--;
+	}
+	else
+	{
+		itu_component_pool_remove(component, id);
+	}
+
+	itu_systems_entity_signature_changed(id.index);
 }
 
 void* itu_entity_data_get(ITU_EntityId id, ITU_ComponentType component_type)
@@ -695,33 +2213,132 @@ void* itu_entity_data_get(ITU_EntityId id, ITU_ComponentType component_type)
 		return NULL;
 	}
 
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		ITU_Entity* entity = &ctx_estorage.entities[id.index];
+		ITU_Archetype* archetype = ctx_estorage.archetypes[entity->archetype];
+		return itu_archetype_data_get(archetype, entity->archetype_row, archetype->column_loc[component_type]);
+	}
+
 	ITU_Component* component = ctx_estorage.components[component_type];
 	
-	Uint64 loc = component->data_loc[id.index];
+	Sint32 loc = itu_component_pool_loc_get(component, id.index);
 	return pointer_index(component->data, loc, component->element_size);
 }
 
+// same as `itu_entity_data_get`, but also marks the component as changed
+void* itu_entity_data_get_mut(ITU_EntityId id, ITU_ComponentType component_type)
+{
+	void* ret = itu_entity_data_get(id, component_type);
+	if(ret)
+		itu_entity_mark_changed(id, component_type);
+	return ret;
+}
+
+void itu_entity_mark_changed(ITU_EntityId id, ITU_ComponentType component_type)
+{
+	SDL_assert(itu_entity_is_valid(id));
+	SDL_assert(ctx_estorage.entities[id.index].component_mask & (1ull << component_type));
+
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		ITU_Entity* entity = &ctx_estorage.entities[id.index];
+		ITU_Archetype* archetype = ctx_estorage.archetypes[entity->archetype];
+		int chunk = entity->archetype_row / archetype->chunk_capacity;
+		archetype->chunks_changed_ticks[chunk * archetype->columns_count + archetype->column_loc[component_type]] = ctx_estorage.tick;
+	}
+	else
+	{
+		ITU_Component* component = ctx_estorage.components[component_type];
+		component->changed_ticks[itu_component_pool_loc_get(component, id.index)] = ctx_estorage.tick;
+	}
+}
+
+Uint32 itu_entity_changed_tick(ITU_EntityId id, ITU_ComponentType component_type)
+{
+	SDL_assert(itu_entity_is_valid(id));
+	SDL_assert(ctx_estorage.entities[id.index].component_mask & (1ull << component_type));
+
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		ITU_Entity* entity = &ctx_estorage.entities[id.index];
+		ITU_Archetype* archetype = ctx_estorage.archetypes[entity->archetype];
+		int chunk = entity->archetype_row / archetype->chunk_capacity;
+		return archetype->chunks_changed_ticks[chunk * archetype->columns_count + archetype->column_loc[component_type]];
+	}
+
+	ITU_Component* component = ctx_estorage.components[component_type];
+	return component->changed_ticks[itu_component_pool_loc_get(component, id.index)];
+}
+
 void itu_entity_tag_add(ITU_EntityId id, ITU_TagType tag)
 {
+	SDL_assert(!ctx_estorage.systems_parallel); // only exclusive systems can do immediate structural changes (use `itu_entity_deferred_*`)
 	SDL_assert(tag < TAGS_COUNT_MAX);
-	ITU_ComponentTagStorage foo = { id };
-	stbds_hmputs(ctx_estorage.tags[tag], foo);
+	Uint64 tag_bit = 1ull << tag;
+
+	if(!itu_entity_is_valid(id))
+	{
+		SDL_Log("WARNING invalid entity\n");
+		return;
+	}
+
+	ITU_Entity* entity = &ctx_estorage.entities[id.index];
+	if(entity->tag_mask & tag_bit)
+		return;
+
+	entity->tag_mask |= tag_bit;
+	itu_entity_set_add(&ctx_estorage.tags[tag], id);
+
+	itu_systems_entity_signature_changed(id.index);
 }
 
 void itu_entity_tag_remove(ITU_EntityId id, ITU_TagType tag)
 {
+	SDL_assert(!ctx_estorage.systems_parallel); // only exclusive systems can do immediate structural changes (use `itu_entity_deferred_*`)
 	SDL_assert(tag < TAGS_COUNT_MAX);
-	stbds_hmdel(ctx_estorage.tags[tag], id);
+	Uint64 tag_bit = 1ull << tag;
+
+	if(!itu_entity_is_valid(id))
+	{
+		SDL_Log("WARNING invalid entity\n");
+		return;
+	}
+
+	ITU_Entity* entity = &ctx_estorage.entities[id.index];
+	if(!(entity->tag_mask & tag_bit))
+		return;
+
+	entity->tag_mask &= ~tag_bit;
+	itu_entity_set_remove(&ctx_estorage.tags[tag], id.index);
+
+	itu_systems_entity_signature_changed(id.index);
 }
 
 bool itu_entity_tag_has(ITU_EntityId id, ITU_TagType tag)
 {
 	SDL_assert(tag < TAGS_COUNT_MAX);
-	return stbds_hmgeti(ctx_estorage.tags[tag], id) != -1;
+	return itu_entity_is_valid(id) && (ctx_estorage.entities[id.index].tag_mask & (1ull << tag));
+}
+
+bool itu_entity_matches(ITU_EntityId id, Uint64 component_mask, Uint64 tag_mask)
+{
+	if(!itu_entity_is_valid(id))
+		return false;
+	ITU_Entity* entity = &ctx_estorage.entities[id.index];
+	return (entity->component_mask & component_mask) == component_mask && (entity->tag_mask & tag_mask) == tag_mask;
+}
+
+ITU_EntityId* itu_entity_tag_members(ITU_TagType tag, int* out_count)
+{
+	SDL_assert(tag < TAGS_COUNT_MAX);
+	*out_count = stbds_arrlen(ctx_estorage.tags[tag].entities);
+	return ctx_estorage.tags[tag].entities;
 }
 
 void itu_entity_destroy(ITU_EntityId id)
 {
+	SDL_assert(!ctx_estorage.systems_parallel); // only exclusive systems can do immediate structural changes (use `itu_entity_deferred_*`)
 	if(!itu_entity_is_valid(id))
 	{
 		SDL_Log("WARNING invalid entity\n");
@@ -744,41 +2361,1031 @@ void itu_entity_destroy(ITU_EntityId id)
 	Uint64 component_mask = ctx_estorage.entities[id.index].component_mask;
 
 	// free all components
-	// TODO faster way to do this?
-	for(int i = 0; i < ctx_estorage.components_count; ++i)
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
 	{
-		Uint64 component_bit = 1ll << i;
-		if(!(component_mask & component_bit))
-			continue;
-		itu_entity_component_remove(id, i);
+		// all the data lives in a single row, no need to move the entity through intermediate archetypes
+		ITU_Entity* entity = &ctx_estorage.entities[id.index];
+		itu_archetype_row_remove(ctx_estorage.archetypes[entity->archetype], entity->archetype_row);
+		entity->archetype = -1;
+
+		for(int i = 0; i < ctx_estorage.components_count; ++i)
+			if(component_mask & (1ll << i))
+				ctx_estorage.components[i]->count_alive--;
+	}
+	else
+	{
+		// TODO faster way to do this?
+		for(int i = 0; i < ctx_estorage.components_count; ++i)
+		{
+			Uint64 component_bit = 1ll << i;
+			if(!(component_mask & component_bit))
+				continue;
+			itu_component_pool_remove(ctx_estorage.components[i], id);
+		}
 	}
 
-	// free all tags
-	// TODO faster way to do this?
-	for(int i = 0; i < TAGS_COUNT_MAX; ++i)
-		itu_entity_tag_remove(id, i);
-
-	// clear debug name
-	int pos_name_storage = stbds_hmgeti(ctx_estorage.entities_debug_names, id);
-	if(pos_name_storage != -1)
+	// free all tags (only the ones the entity actually has)
+	Uint64 tag_mask = ctx_estorage.entities[id.index].tag_mask;
+	while(tag_mask)
 	{
-		// NOTE: as mentioned when allocating this, doing alloc/dealloc of every single name in isolation is not good for peformance
-		//       we'll give ourself a pass for this since this is a debug feature, but it's worth to keep in mind
-		SDL_free(ctx_estorage.entities_debug_names[pos_name_storage].value);
-		stbds_hmdel(ctx_estorage.entities_debug_names, id);
+		itu_entity_set_remove(&ctx_estorage.tags[bit_index_lowest(tag_mask)], id.index);
+		tag_mask &= tag_mask - 1;
 	}
 
+#if ITU_ENTITY_DEBUG_NAMES
+	itu_entity_debug_name_clear(id.index);
+#endif
+
 	ctx_estorage.entities[id.index].id.index = -1;
 	ctx_estorage.entities[id.index].id.generation++;
 	ctx_estorage.entities[id.index].component_mask = 0;
+	ctx_estorage.entities[id.index].tag_mask = 0;
 	stbds_arrput(ctx_estorage.entities_free, id);
+
+	itu_systems_entity_signature_changed(id.index);
 }
 
 
-void itu_debug_ui_widget_entityid(const char* label, ITU_EntityId id)
+ITU_CommandBuffer* itu_command_buffer_get()
 {
-	if(!itu_entity_is_valid(id))
-		ImGui::LabelText(label, "INVALID ENTITY");
+	int thread_index = itu_lib_jobs_thread_index();
+	SDL_assert(thread_index < COMMAND_BUFFERS_COUNT);
+	return &ctx_estorage.command_buffers[thread_index];
+}
+
+void itu_command_buffer_record(ITU_CommandType type, ITU_EntityId id, Uint8 component_type_or_tag, void* in_data_copy, Uint64 data_size)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	ITU_CommandBuffer* buffer = itu_command_buffer_get();
+
+	ITU_Command command;
+	command.type = type;
+	command.id = id;
+	command.component_type_or_tag = component_type_or_tag;
+	command.data_offset = -1;
+	if(in_data_copy)
+	{
+		command.data_offset = stbds_arrlen(buffer->data);
+		SDL_memcpy(stbds_arraddnptr(buffer->data, data_size), in_data_copy, data_size);
+	}
+	stbds_arrput(buffer->commands, command);
+}
+
+// maps placeholder ids (from `itu_entity_deferred_create`) to the real entity created on playback
+ITU_EntityId itu_command_id_resolve(ITU_EntityId id)
+{
+	if(id.generation != ITU_ENTITY_GENERATION_DEFERRED)
+		return id;
+
+	// NOTE: a placeholder kept past the playback of its wave doesn't refer to anything we created
+	Uint32 buffer_idx = id.index >> COMMAND_BUFFER_INDEX_SHIFT;
+	Uint32 created_idx = id.index & ((1 << COMMAND_BUFFER_INDEX_SHIFT) - 1);
+	if(buffer_idx >= COMMAND_BUFFERS_COUNT || created_idx >= stbds_arrlen(ctx_estorage.command_buffers[buffer_idx].created))
+	{
+		SDL_Log("WARNING stale deferred entity id (placeholders are only valid until the end of the wave that created them)\n");
+		ITU_EntityId ret = ITU_ENTITY_ID_NULL;
+		return ret;
+	}
+	return ctx_estorage.command_buffers[buffer_idx].created[created_idx];
+}
+
+ITU_EntityId itu_entity_deferred_create()
+{
+	if(!ctx_estorage.systems_updating)
+		return itu_entity_create();
+
+	ITU_CommandBuffer* buffer = itu_command_buffer_get();
+	SDL_assert(buffer->created_count < (1 << COMMAND_BUFFER_INDEX_SHIFT));
+
+	ITU_EntityId id;
+	id.generation = ITU_ENTITY_GENERATION_DEFERRED;
+	id.index = (itu_lib_jobs_thread_index() << COMMAND_BUFFER_INDEX_SHIFT) | buffer->created_count++;
+	itu_command_buffer_record(ITU_COMMAND_TYPE_CREATE, id, 0, NULL, 0);
+	return id;
+}
+
+void itu_entity_deferred_destroy(ITU_EntityId id)
+{
+	if(!ctx_estorage.systems_updating)
+		itu_entity_destroy(id);
+	else
+		itu_command_buffer_record(ITU_COMMAND_TYPE_DESTROY, id, 0, NULL, 0);
+}
+
+void itu_entity_deferred_component_add(ITU_EntityId id, ITU_ComponentType component_type, void* in_data_copy)
+{
+	SDL_assert(component_type < ctx_estorage.components_count);
+	if(!ctx_estorage.systems_updating)
+		itu_entity_component_add(id, component_type, in_data_copy);
+	else
+		itu_command_buffer_record(ITU_COMMAND_TYPE_COMPONENT_ADD, id, component_type, in_data_copy, ctx_estorage.components[component_type]->element_size);
+}
+
+void itu_entity_deferred_component_remove(ITU_EntityId id, ITU_ComponentType component_type)
+{
+	if(!ctx_estorage.systems_updating)
+		itu_entity_component_remove(id, component_type);
+	else
+		itu_command_buffer_record(ITU_COMMAND_TYPE_COMPONENT_REMOVE, id, component_type, NULL, 0);
+}
+
+void itu_entity_deferred_tag_add(ITU_EntityId id, ITU_TagType tag)
+{
+	if(!ctx_estorage.systems_updating)
+		itu_entity_tag_add(id, tag);
+	else
+		itu_command_buffer_record(ITU_COMMAND_TYPE_TAG_ADD, id, tag, NULL, 0);
+}
+
+void itu_entity_deferred_tag_remove(ITU_EntityId id, ITU_TagType tag)
+{
+	if(!ctx_estorage.systems_updating)
+		itu_entity_tag_remove(id, tag);
+	else
+		itu_command_buffer_record(ITU_COMMAND_TYPE_TAG_REMOVE, id, tag, NULL, 0);
+}
+
+void itu_sys_estorage_commands_playback()
+{
+	SDL_assert(!ctx_estorage.systems_updating);
+
+	// create all entities first, so that commands from any buffer can reference them
+	for(int i = 0; i < COMMAND_BUFFERS_COUNT; ++i)
+	{
+		ITU_CommandBuffer* buffer = &ctx_estorage.command_buffers[i];
+		for(int j = 0; j < stbds_arrlen(buffer->commands); ++j)
+			if(buffer->commands[j].type == ITU_COMMAND_TYPE_CREATE)
+				stbds_arrput(buffer->created, itu_entity_create());
+	}
+
+	for(int i = 0; i < COMMAND_BUFFERS_COUNT; ++i)
+	{
+		ITU_CommandBuffer* buffer = &ctx_estorage.command_buffers[i];
+		for(int j = 0; j < stbds_arrlen(buffer->commands); ++j)
+		{
+			ITU_Command* command = &buffer->commands[j];
+			ITU_EntityId id = itu_command_id_resolve(command->id);
+
+			// NOTE: the same entity may be destroyed more than once (ie, by two different systems), so we skip invalid ids silently
+			if(command->type == ITU_COMMAND_TYPE_CREATE || !itu_entity_is_valid(id))
+				continue;
+
+			switch(command->type)
+			{
+				case ITU_COMMAND_TYPE_DESTROY:          itu_entity_destroy(id); break;
+				case ITU_COMMAND_TYPE_COMPONENT_ADD:    itu_entity_component_add(id, command->component_type_or_tag, command->data_offset == -1 ? NULL : buffer->data + command->data_offset); break;
+				case ITU_COMMAND_TYPE_COMPONENT_REMOVE: itu_entity_component_remove(id, command->component_type_or_tag); break;
+				case ITU_COMMAND_TYPE_TAG_ADD:          itu_entity_tag_add(id, command->component_type_or_tag); break;
+				case ITU_COMMAND_TYPE_TAG_REMOVE:       itu_entity_tag_remove(id, command->component_type_or_tag); break;
+				default: /* do nothing */ break;
+			}
+		}
+	}
+
+	// NOTE: cleared only at the end, commands from any buffer can reference entities created by any other
+	for(int i = 0; i < COMMAND_BUFFERS_COUNT; ++i)
+	{
+		ITU_CommandBuffer* buffer = &ctx_estorage.command_buffers[i];
+		stbds_arrsetlen(buffer->commands, 0);
+		stbds_arrsetlen(buffer->data, 0);
+		stbds_arrsetlen(buffer->created, 0);
+		buffer->created_count = 0;
+	}
+}
+
+int itu_sort_entry_compare(const void* a, const void* b)
+{
+	const ITU_SortEntry* entry_a = (const ITU_SortEntry*)a;
+	const ITU_SortEntry* entry_b = (const ITU_SortEntry*)b;
+	if(entry_a->group != entry_b->group)
+		return entry_a->group < entry_b->group ? -1 : 1;
+	if(entry_a->key != entry_b->key)
+		return entry_a->key < entry_b->key ? -1 : 1;
+	return entry_a->id.index < entry_b->id.index ? -1 : (entry_a->id.index > entry_b->id.index);
+}
+
+void itu_sys_estorage_sort_begin(ITU_ComponentType component_type, ITU_ComponentSortKeyFunction fn_key, Uint64 follow_mask)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	SDL_assert(component_type < ctx_estorage.components_count);
+	SDL_assert(!ctx_estorage.systems_parallel);
+
+	ITU_SortState* sort = &ctx_estorage.sort;
+	stbds_arrsetlen(sort->entries, 0);
+	sort->pools_count = 0;
+	sort->pool_current = 0;
+	sort->entry_current = 0;
+	sort->archetype_current = -1;
+	sort->loc_write = 0;
+
+	// NOTE: keys are computed (and sorted) all at once, only the actual data moves are spread over time
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		for(int i = 0; i < stbds_arrlen(ctx_estorage.archetypes); ++i)
+		{
+			ITU_Archetype* archetype = ctx_estorage.archetypes[i];
+			int column = archetype->column_loc[component_type];
+			if(column < 0)
+				continue;
+
+			for(int row = 0; row < archetype->count_alive; ++row)
+			{
+				ITU_SortEntry entry;
+				entry.id = ((ITU_EntityId*)archetype->chunks[row / archetype->chunk_capacity])[row % archetype->chunk_capacity];
+				entry.key = fn_key(entry.id, itu_archetype_data_get(archetype, row, column));
+				entry.group = i;
+				stbds_arrput(sort->entries, entry);
+			}
+		}
+	}
 	else
-		ImGui::LabelText(label, "%s (%d, %d)", ctx_estorage.entities_debug_names[id.index].value, id.generation, id.index);
+	{
+		follow_mask &= ~(1ull << component_type);
+
+		ITU_Component* component_pool = ctx_estorage.components[component_type];
+		for(int i = 0; i < component_pool->count_alive; ++i)
+		{
+			ITU_SortEntry entry;
+			entry.id = component_pool->entity_ids[i];
+			entry.key = fn_key(entry.id, pointer_offset(void, component_pool->data, i * component_pool->element_size));
+			entry.group = (ctx_estorage.entities[entry.id.index].component_mask & follow_mask) == follow_mask ? 0 : 1;
+			stbds_arrput(sort->entries, entry);
+		}
+
+		sort->pools[sort->pools_count++] = component_type;
+		for(Uint64 mask = follow_mask; mask; mask &= mask - 1)
+			sort->pools[sort->pools_count++] = bit_index_lowest(mask);
+	}
+
+	SDL_qsort(sort->entries, stbds_arrlen(sort->entries), sizeof(ITU_SortEntry), itu_sort_entry_compare);
+	sort->active = true;
+}
+
+// every entry in the target order gets swapped to the next location to fill, unless a removal
+// already moved it inside the sorted part (in which case it's left where it is, slightly less sorted but still valid)
+bool itu_sys_estorage_sort_step(int moves_max)
+{
+	SDL_assert(!ctx_estorage.systems_parallel);
+
+	ITU_SortState* sort = &ctx_estorage.sort;
+	if(!sort->active)
+		return true;
+
+	int entries_count = stbds_arrlen(sort->entries);
+	int moves = 0;
+	bool done;
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		while(sort->entry_current < entries_count && moves < moves_max)
+		{
+			ITU_SortEntry* entry = &sort->entries[sort->entry_current++];
+			if(entry->group != sort->archetype_current)
+			{
+				sort->archetype_current = entry->group;
+				sort->loc_write = 0;
+			}
+
+			if(!itu_entity_is_valid(entry->id))
+				continue;
+			ITU_Entity* entity = &ctx_estorage.entities[entry->id.index];
+			ITU_Archetype* archetype = ctx_estorage.archetypes[entry->group];
+			if(entity->archetype != entry->group || entity->archetype_row < sort->loc_write || sort->loc_write >= archetype->count_alive)
+				continue;
+
+			if(entity->archetype_row != sort->loc_write)
+			{
+				itu_archetype_row_swap(archetype, sort->loc_write, entity->archetype_row);
+				moves++;
+			}
+			sort->loc_write++;
+		}
+		done = sort->entry_current == entries_count;
+	}
+	else
+	{
+		while(sort->pool_current < sort->pools_count && moves < moves_max)
+		{
+			if(sort->entry_current == entries_count)
+			{
+				sort->pool_current++;
+				sort->entry_current = 0;
+				sort->loc_write = 0;
+				continue;
+			}
+
+			ITU_SortEntry* entry = &sort->entries[sort->entry_current++];
+			ITU_ComponentType component_type = sort->pools[sort->pool_current];
+			if(!itu_entity_is_valid(entry->id) || !(ctx_estorage.entities[entry->id.index].component_mask & (1ull << component_type)))
+				continue;
+
+			ITU_Component* component_pool = ctx_estorage.components[component_type];
+			Sint32 loc = itu_component_pool_loc_get(component_pool, entry->id.index);
+			if(loc < (Sint32)sort->loc_write)
+				continue;
+
+			if(loc != sort->loc_write)
+			{
+				itu_component_pool_swap(component_pool, loc, sort->loc_write);
+				moves++;
+			}
+			sort->loc_write++;
+		}
+		done = sort->pool_current == sort->pools_count;
+	}
+
+	if(done)
+	{
+		sort->active = false;
+		stbds_arrsetlen(sort->entries, 0);
+	}
+	return done;
+}
+
+bool itu_sys_estorage_sort_in_progress()
+{
+	return ctx_estorage.sort.active;
+}
+
+// snapshots
+// file layout (everything in native endianness, sections one after the other):
+//   ITU_SnapshotHeader
+//   ITU_SnapshotComponent  x components_count
+//   ITU_Entity             x entities_count
+//   ITU_EntityId           x entities_free_count
+//   sparse mode:    for every component: ITU_EntityId x count, then data x count
+//   archetype mode: for every archetype: ITU_SnapshotArchetype, then its chunks (raw)
+//   debug names:    Sint32 x entities_count, then the names arena (only if `names_arena_size` > 0)
+#define ITU_SNAPSHOT_MAGIC   0x53555449 // "ITUS"
+#define ITU_SNAPSHOT_VERSION 1
+
+struct ITU_SnapshotHeader
+{
+	Uint32 magic;
+	Uint32 version;
+	Uint32 mode;
+	Uint32 components_count;
+	Uint32 entities_count;
+	Uint32 entities_free_count;
+	Uint32 archetypes_count;
+	Uint32 names_arena_size;
+};
+
+struct ITU_SnapshotComponent
+{
+	char   name[32];
+	Uint64 element_size;
+	Uint32 count; // sparse mode only
+	Uint32 padding;
+};
+
+struct ITU_SnapshotArchetype
+{
+	Uint64 component_mask;
+	Uint32 count_alive;
+	Uint32 chunks_count;
+};
+
+struct ITU_SnapshotReader
+{
+	unsigned char* data;
+	size_t size;
+	size_t cursor;
+};
+
+void itu_snapshot_write(stbds_arr(unsigned char)* buffer, const void* data, Uint64 size)
+{
+	if(size == 0)
+		return;
+	SDL_memcpy(stbds_arraddnptr(*buffer, size), data, size);
+}
+
+// returns NULL if the file is too short
+void* itu_snapshot_read(ITU_SnapshotReader* reader, Uint64 size)
+{
+	if(reader->cursor + size > reader->size)
+		return NULL;
+	void* ret = reader->data + reader->cursor;
+	reader->cursor += size;
+	return ret;
+}
+
+bool itu_sys_estorage_snapshot_save(const char* path)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	SDL_assert(!ctx_estorage.systems_updating);
+
+	stbds_arr(unsigned char) buffer = NULL;
+
+	ITU_SnapshotHeader header = { 0 };
+	header.magic = ITU_SNAPSHOT_MAGIC;
+	header.version = ITU_SNAPSHOT_VERSION;
+	header.mode = ctx_estorage.mode;
+	header.components_count = ctx_estorage.components_count;
+	header.entities_count = stbds_arrlen(ctx_estorage.entities);
+	header.entities_free_count = stbds_arrlen(ctx_estorage.entities_free);
+	header.archetypes_count = stbds_arrlen(ctx_estorage.archetypes);
+#if ITU_ENTITY_DEBUG_NAMES
+	header.names_arena_size = stbds_arrlen(ctx_estorage.entities_debug_names_arena);
+#endif
+	itu_snapshot_write(&buffer, &header, sizeof(header));
+
+	for(int i = 0; i < ctx_estorage.components_count; ++i)
+	{
+		ITU_Component* component_pool = ctx_estorage.components[i];
+		ITU_SnapshotComponent info = { 0 };
+		SDL_strlcpy(info.name, component_pool->name, sizeof(info.name));
+		info.element_size = component_pool->element_size;
+		info.count = ctx_estorage.mode == ITU_ESTORAGE_MODE_SPARSE ? component_pool->count_alive : 0;
+		itu_snapshot_write(&buffer, &info, sizeof(info));
+	}
+
+	itu_snapshot_write(&buffer, ctx_estorage.entities, sizeof(ITU_Entity) * header.entities_count);
+	itu_snapshot_write(&buffer, ctx_estorage.entities_free, sizeof(ITU_EntityId) * header.entities_free_count);
+
+	// component data is block-copied, then save hooks patch the copy (the live data is never touched)
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_SPARSE)
+	{
+		for(int i = 0; i < ctx_estorage.components_count; ++i)
+		{
+			ITU_Component* component_pool = ctx_estorage.components[i];
+			itu_snapshot_write(&buffer, component_pool->entity_ids, sizeof(ITU_EntityId) * component_pool->count_alive);
+
+			Uint64 data_offset = stbds_arrlen(buffer);
+			itu_snapshot_write(&buffer, component_pool->data, component_pool->element_size * component_pool->count_alive);
+			if(component_pool->fn_snapshot_save)
+				for(int j = 0; j < component_pool->count_alive; ++j)
+					component_pool->fn_snapshot_save(component_pool->entity_ids[j], buffer + data_offset + j * component_pool->element_size);
+		}
+	}
+	else
+	{
+		for(int i = 0; i < header.archetypes_count; ++i)
+		{
+			ITU_Archetype* archetype = ctx_estorage.archetypes[i];
+			ITU_SnapshotArchetype info;
+			info.component_mask = archetype->component_mask;
+			info.count_alive = archetype->count_alive;
+			info.chunks_count = (archetype->count_alive + archetype->chunk_capacity - 1) / archetype->chunk_capacity; // NOTE: no spare chunk
+			itu_snapshot_write(&buffer, &info, sizeof(info));
+
+			for(int chunk_idx = 0; chunk_idx < info.chunks_count; ++chunk_idx)
+			{
+				Uint64 chunk_offset = stbds_arrlen(buffer);
+				itu_snapshot_write(&buffer, archetype->chunks[chunk_idx], archetype->chunk_size);
+
+				int rows_in_chunk = SDL_min(archetype->chunk_capacity, archetype->count_alive - chunk_idx * archetype->chunk_capacity);
+				for(int column = 0; column < archetype->columns_count; ++column)
+				{
+					ITU_Component* component_pool = ctx_estorage.components[archetype->column_types[column]];
+					if(!component_pool->fn_snapshot_save)
+						continue;
+					unsigned char* chunk = buffer + chunk_offset;
+					for(int loc = 0; loc < rows_in_chunk; ++loc)
+						component_pool->fn_snapshot_save(((ITU_EntityId*)chunk)[loc], pointer_index(chunk + archetype->column_offsets[column], loc, archetype->column_sizes[column]));
+				}
+			}
+		}
+	}
+
+#if ITU_ENTITY_DEBUG_NAMES
+	if(header.names_arena_size > 0)
+	{
+		// NOTE: the offsets array only grows as far as the highest named entity
+		for(int i = 0; i < header.entities_count; ++i)
+		{
+			Sint32 offset = i < stbds_arrlen(ctx_estorage.entities_debug_names) ? ctx_estorage.entities_debug_names[i] : -1;
+			itu_snapshot_write(&buffer, &offset, sizeof(offset));
+		}
+		itu_snapshot_write(&buffer, ctx_estorage.entities_debug_names_arena, header.names_arena_size);
+	}
+#endif
+
+	bool ret = SDL_SaveFile(path, buffer, stbds_arrlen(buffer));
+	if(!ret)
+		SDL_Log("WARNING could not save snapshot '%s': %s\n", path, SDL_GetError());
+
+	stbds_arrfree(buffer);
+	return ret;
+}
+
+// walks the rest of the file (everything after the free list) without touching the current state:
+// every section must fit in the file, and every index must point inside the data being loaded
+bool itu_snapshot_validate(ITU_SnapshotReader reader, ITU_SnapshotHeader* header, ITU_SnapshotComponent* infos, ITU_Entity* entities, ITU_EntityId* entities_free)
+{
+	Uint32 entities_count = header->entities_count;
+	Uint64 components_mask_all = ctx_estorage.components_count == 64 ? ~0ull : (1ull << ctx_estorage.components_count) - 1;
+
+	// alive entities are stored at their own index, dead ones have index -1
+	for(Uint32 i = 0; i < entities_count; ++i)
+		if(entities[i].id.index != -1 && (entities[i].id.index != i || (entities[i].component_mask & ~components_mask_all)))
+			return false;
+	for(Uint32 i = 0; i < header->entities_free_count; ++i)
+		if(entities_free[i].index >= entities_count || entities[entities_free[i].index].id.index != -1)
+			return false;
+
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_SPARSE)
+	{
+		// every pool must hold exactly the alive entities with its bit set, each one once
+		// (otherwise an entity could end up with a component bit but no data)
+		Uint32 components_owners[COMPONENTS_COUNT_MAX] = { 0 };
+		for(Uint32 i = 0; i < entities_count; ++i)
+			if(entities[i].id.index != -1)
+				for(Uint64 mask = entities[i].component_mask; mask; mask &= mask - 1)
+					components_owners[bit_index_lowest(mask)]++;
+
+		ITU_ArenaTemp scratch = itu_arena_scratch_begin();
+		Uint8* entities_seen = arena_push_array(scratch.arena, Uint8, entities_count);
+		bool ret = true;
+		for(int i = 0; ret && i < header->components_count; ++i)
+		{
+			ITU_EntityId* entity_ids = (ITU_EntityId*)itu_snapshot_read(&reader, sizeof(ITU_EntityId) * infos[i].count);
+			void* data = itu_snapshot_read(&reader, infos[i].element_size * infos[i].count);
+			if(infos[i].count != components_owners[i] || !entity_ids || !data)
+			{
+				ret = false;
+				break;
+			}
+
+			SDL_memset(entities_seen, 0, entities_count);
+			for(Uint32 j = 0; ret && j < infos[i].count; ++j)
+			{
+				Uint32 index = entity_ids[j].index;
+				ret = index < entities_count && entities[index].id.index == index && (entities[index].component_mask & (1ull << i)) && !entities_seen[index];
+				if(ret)
+					entities_seen[index] = 1;
+			}
+		}
+		itu_arena_scratch_end(scratch);
+		if(!ret)
+			return false;
+	}
+	else
+	{
+		ITU_ArenaTemp scratch = itu_arena_scratch_begin();
+		Uint32* archetypes_count_alive = arena_push_array(scratch.arena, Uint32, header->archetypes_count);
+		Uint64* archetypes_mask        = arena_push_array(scratch.arena, Uint64, header->archetypes_count);
+		Uint8*  entities_seen          = arena_push_array(scratch.arena, Uint8, entities_count);
+		SDL_memset(entities_seen, 0, entities_count);
+		bool ret = true;
+		for(int i = 0; ret && i < header->archetypes_count; ++i)
+		{
+			ITU_SnapshotArchetype* info = (ITU_SnapshotArchetype*)itu_snapshot_read(&reader, sizeof(ITU_SnapshotArchetype));
+			if(!info || (info->component_mask & ~components_mask_all))
+			{
+				ret = false;
+				break;
+			}
+			archetypes_count_alive[i] = info->count_alive;
+			archetypes_mask[i] = info->component_mask;
+
+			// two archetypes with the same mask would be loaded into the same one
+			for(int j = 0; ret && j < i; ++j)
+				ret = archetypes_mask[j] != info->component_mask;
+			if(!ret)
+				break;
+
+			// NOTE: same layout the archetype is going to have once loaded, without creating it
+			ITU_Archetype layout = { 0 };
+			itu_archetype_layout_init(&layout, info->component_mask);
+			Uint64 chunks_needed = ((Uint64)info->count_alive + layout.chunk_capacity - 1) / layout.chunk_capacity;
+			if(info->chunks_count < chunks_needed)
+			{
+				ret = false;
+				break;
+			}
+
+			// every row must belong to an entity that points back at it
+			for(Uint32 chunk_idx = 0; ret && chunk_idx < info->chunks_count; ++chunk_idx)
+			{
+				ITU_EntityId* chunk_ids = (ITU_EntityId*)itu_snapshot_read(&reader, layout.chunk_size);
+				if(!chunk_ids)
+				{
+					ret = false;
+					break;
+				}
+
+				Uint32 row_first = chunk_idx * layout.chunk_capacity;
+				for(Uint32 loc = 0; ret && loc < layout.chunk_capacity && row_first + loc < info->count_alive; ++loc)
+				{
+					Uint32 index = chunk_ids[loc].index;
+					ret = index < entities_count && entities[index].id.index == index && entities[index].archetype == i &&
+					      entities[index].archetype_row == row_first + loc && entities[index].component_mask == info->component_mask;
+					if(ret)
+						entities_seen[index] = 1;
+				}
+			}
+		}
+
+		// ...and every alive entity must be in the row it points at (so no two entities share a row).
+		// A row is only marked as seen if its entity points back at it, with the archetype mask matching the entity mask
+		for(Uint32 i = 0; ret && i < entities_count; ++i)
+			if(entities[i].id.index != -1)
+				ret = entities_seen[i];
+
+		itu_arena_scratch_end(scratch);
+		if(!ret)
+			return false;
+	}
+
+#if ITU_ENTITY_DEBUG_NAMES
+	if(header->names_arena_size > 0)
+	{
+		Sint32* offsets = (Sint32*)itu_snapshot_read(&reader, sizeof(Sint32) * entities_count);
+		char* arena = (char*)itu_snapshot_read(&reader, header->names_arena_size);
+		if(!offsets || !arena || arena[header->names_arena_size - 1] != 0)
+			return false;
+		for(Uint32 i = 0; i < entities_count; ++i)
+			if(offsets[i] < -1 || offsets[i] >= (Sint32)header->names_arena_size)
+				return false;
+	}
+#endif
+
+	return true;
+}
+
+// drops all entities without destroying them one by one (everything is going to be overwritten anyway)
+void itu_sys_estorage_reset_fast()
+{
+	for(int i = 0; i < ctx_estorage.components_count; ++i)
+		itu_component_pool_clear(ctx_estorage.components[i]);
+	for(int i = 0; i < stbds_arrlen(ctx_estorage.archetypes); ++i)
+		itu_archetype_clear(ctx_estorage.archetypes[i]);
+	for(int i = 0; i < TAGS_COUNT_MAX; ++i)
+		itu_entity_set_free(&ctx_estorage.tags[i]);
+	for(int i = 0; i < ctx_estorage.systems_count; ++i)
+		itu_entity_set_free(&ctx_estorage.systems[i].matches);
+
+	stbds_arrsetlen(ctx_estorage.entities, 0);
+	stbds_arrsetlen(ctx_estorage.entities_free, 0);
+	stbds_arrsetlen(ctx_estorage.entities_dirty, 0);
+	ctx_estorage.entities_version++;
+	stbds_arrsetlen(ctx_estorage.entities_debug_names_arena, 0);
+	stbds_arrsetlen(ctx_estorage.entities_debug_names, 0);
+	ctx_estorage.entities_debug_names_garbage = 0;
+
+	ctx_estorage.sort.active = false;
+	stbds_arrsetlen(ctx_estorage.sort.entries, 0);
+
+	itu_spatial_index_clear();
+}
+
+bool itu_sys_estorage_snapshot_load(const char* path)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ECS);
+	SDL_assert(!ctx_estorage.systems_updating);
+
+	ITU_SnapshotReader reader = { 0 };
+	reader.data = (unsigned char*)SDL_LoadFile(path, &reader.size);
+	if(!reader.data)
+	{
+		SDL_Log("WARNING could not load snapshot '%s': %s\n", path, SDL_GetError());
+		return false;
+	}
+
+	// validate everything before touching the current state
+	bool valid = true;
+	ITU_SnapshotHeader* header = (ITU_SnapshotHeader*)itu_snapshot_read(&reader, sizeof(ITU_SnapshotHeader));
+	ITU_SnapshotComponent* infos = NULL;
+	if(!header || header->magic != ITU_SNAPSHOT_MAGIC || header->version != ITU_SNAPSHOT_VERSION)
+	{
+		SDL_Log("WARNING snapshot '%s' is not a valid snapshot (or has an unsupported version)\n", path);
+		valid = false;
+	}
+	else if(header->mode != ctx_estorage.mode || header->components_count != ctx_estorage.components_count)
+	{
+		SDL_Log("WARNING snapshot '%s' was saved with a different storage setup\n", path);
+		valid = false;
+	}
+	else
+	{
+		infos = (ITU_SnapshotComponent*)itu_snapshot_read(&reader, sizeof(ITU_SnapshotComponent) * header->components_count);
+		for(int i = 0; valid && infos && i < header->components_count; ++i)
+		{
+			if(infos[i].element_size != ctx_estorage.components[i]->element_size || SDL_strncmp(infos[i].name, ctx_estorage.components[i]->name, sizeof(infos[i].name) - 1) != 0)
+			{
+				SDL_Log("WARNING snapshot '%s': component %d (%s) does not match\n", path, i, infos[i].name);
+				valid = false;
+			}
+		}
+		valid &= infos != NULL;
+	}
+
+	ITU_Entity*   entities      = valid ? (ITU_Entity*)  itu_snapshot_read(&reader, sizeof(ITU_Entity)   * header->entities_count)      : NULL;
+	ITU_EntityId* entities_free = valid ? (ITU_EntityId*)itu_snapshot_read(&reader, sizeof(ITU_EntityId) * header->entities_free_count) : NULL;
+	if(valid && (!entities || !entities_free || !itu_snapshot_validate(reader, header, infos, entities, entities_free)))
+	{
+		SDL_Log("WARNING snapshot '%s' is truncated or corrupt\n", path);
+		valid = false;
+	}
+	if(!valid)
+	{
+		SDL_free(reader.data);
+		return false;
+	}
+
+	itu_sys_estorage_reset_fast();
+
+	stbds_arrsetlen(ctx_estorage.entities, header->entities_count);
+	stbds_arrsetlen(ctx_estorage.entities_free, header->entities_free_count);
+	SDL_memcpy(ctx_estorage.entities, entities, sizeof(ITU_Entity) * header->entities_count);
+	SDL_memcpy(ctx_estorage.entities_free, entities_free, sizeof(ITU_EntityId) * header->entities_free_count);
+
+	// everything loaded counts as changed
+	ctx_estorage.tick++;
+
+	// NOTE: `itu_snapshot_validate` already checked every read below
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_SPARSE)
+	{
+		for(int i = 0; i < header->components_count; ++i)
+		{
+			ITU_Component* component_pool = ctx_estorage.components[i];
+			int count = infos[i].count;
+			ITU_EntityId* entity_ids = (ITU_EntityId*)itu_snapshot_read(&reader, sizeof(ITU_EntityId) * count);
+			void* data = itu_snapshot_read(&reader, component_pool->element_size * count);
+
+			if(count > component_pool->count_max)
+				itu_component_pool_reserve(component_pool, count);
+			SDL_memcpy(component_pool->entity_ids, entity_ids, sizeof(ITU_EntityId) * count);
+			SDL_memcpy(component_pool->data, data, component_pool->element_size * count);
+			component_pool->count_alive = count;
+
+			// the sparse part is rebuilt instead of saved (it's mostly empty space)
+			for(int j = 0; j < count; ++j)
+			{
+				itu_component_pool_loc_set(component_pool, entity_ids[j].index, j);
+				component_pool->changed_ticks[j] = ctx_estorage.tick;
+				if(component_pool->fn_snapshot_load)
+					component_pool->fn_snapshot_load(entity_ids[j], pointer_offset(void, component_pool->data, j * component_pool->element_size));
+			}
+		}
+	}
+	else
+	{
+		// archetype indices in the file don't necessarily match ours
+		ITU_ArenaTemp scratch = itu_arena_scratch_begin();
+		Sint32* archetypes_remap = arena_push_array(scratch.arena, Sint32, header->archetypes_count);
+		for(int i = 0; i < header->archetypes_count; ++i)
+		{
+			ITU_SnapshotArchetype* info = (ITU_SnapshotArchetype*)itu_snapshot_read(&reader, sizeof(ITU_SnapshotArchetype));
+			archetypes_remap[i] = itu_archetype_get_or_create(info->component_mask);
+			ITU_Archetype* archetype = ctx_estorage.archetypes[archetypes_remap[i]];
+			for(int chunk_idx = 0; chunk_idx < info->chunks_count; ++chunk_idx)
+			{
+				void* chunk_data = itu_snapshot_read(&reader, archetype->chunk_size);
+
+				// NOTE: empty chunks past the last row are not needed
+				if(chunk_idx * archetype->chunk_capacity >= info->count_alive)
+					continue;
+
+				unsigned char* chunk = (unsigned char*)SDL_aligned_alloc(ARCHETYPE_COLUMN_ALIGNMENT, archetype->chunk_size);
+				SDL_memcpy(chunk, chunk_data, archetype->chunk_size);
+				stbds_arrput(archetype->chunks, chunk);
+				Uint32* ticks = stbds_arraddnptr(archetype->chunks_changed_ticks, archetype->columns_count);
+				for(int column = 0; column < archetype->columns_count; ++column)
+					ticks[column] = ctx_estorage.tick;
+			}
+			archetype->count_alive = info->count_alive;
+
+			for(int column = 0; column < archetype->columns_count; ++column)
+			{
+				// NOTE: pools don't hold data in archetype mode, but their `count_alive` is still kept up to date
+				ITU_Component* component_pool = ctx_estorage.components[archetype->column_types[column]];
+				component_pool->count_alive += archetype->count_alive;
+				if(!component_pool->fn_snapshot_load)
+					continue;
+				for(int row = 0; row < archetype->count_alive; ++row)
+				{
+					ITU_EntityId id = ((ITU_EntityId*)archetype->chunks[row / archetype->chunk_capacity])[row % archetype->chunk_capacity];
+					component_pool->fn_snapshot_load(id, itu_archetype_data_get(archetype, row, column));
+				}
+			}
+		}
+
+		for(int i = 0; i < header->entities_count; ++i)
+			if(itu_entity_is_valid(ctx_estorage.entities[i].id))
+				ctx_estorage.entities[i].archetype = archetypes_remap[ctx_estorage.entities[i].archetype];
+		itu_arena_scratch_end(scratch);
+	}
+
+#if ITU_ENTITY_DEBUG_NAMES
+	if(header->names_arena_size > 0)
+	{
+		Sint32* offsets = (Sint32*)itu_snapshot_read(&reader, sizeof(Sint32) * header->entities_count);
+		char* arena = (char*)itu_snapshot_read(&reader, header->names_arena_size);
+		stbds_arrsetlen(ctx_estorage.entities_debug_names, header->entities_count);
+		stbds_arrsetlen(ctx_estorage.entities_debug_names_arena, header->names_arena_size);
+		SDL_memcpy(ctx_estorage.entities_debug_names, offsets, sizeof(Sint32) * header->entities_count);
+		SDL_memcpy(ctx_estorage.entities_debug_names_arena, arena, header->names_arena_size);
+	}
+#endif
+
+	SDL_free(reader.data);
+
+	// tag sets and system matches are derived data, rebuild them
+	for(int i = 0; i < stbds_arrlen(ctx_estorage.entities); ++i)
+	{
+		ITU_Entity* entity = &ctx_estorage.entities[i];
+		if(!itu_entity_is_valid(entity->id))
+			continue;
+		for(Uint64 mask = entity->tag_mask; mask; mask &= mask - 1)
+			itu_entity_set_add(&ctx_estorage.tags[bit_index_lowest(mask)], entity->id);
+		itu_systems_entity_signature_changed(i);
+	}
+
+	return true;
+}
+
+void itu_query_begin(ITU_QueryIterator* it, ITU_ComponentType* component_types, int components_count, Uint64 tag_mask)
+{
+	SDL_assert(components_count > 0 && components_count <= SYSTEM_COMPONENTS_MAX);
+
+	SDL_memset(it, 0, sizeof(ITU_QueryIterator));
+	it->components_count = components_count;
+	it->tag_mask = tag_mask;
+	for(int i = 0; i < components_count; ++i)
+	{
+		SDL_assert(component_types[i] < ctx_estorage.components_count);
+		it->component_types[i] = component_types[i];
+		it->component_mask |= 1ull << component_types[i];
+
+		// the smallest pool is the one with fewer entities to reject
+		if(ctx_estorage.components[component_types[i]]->count_alive < ctx_estorage.components[component_types[it->driver]]->count_alive)
+			it->driver = i;
+	}
+	it->driver = component_types[it->driver];
+}
+
+void itu_query_filter_changed(ITU_QueryIterator* it, Uint64 changed_mask, Uint32 changed_since)
+{
+	SDL_assert((changed_mask & it->component_mask) == changed_mask);
+	it->changed_mask = changed_mask;
+	it->changed_since = changed_since;
+}
+
+bool itu_query_tags_match(ITU_QueryIterator* it, ITU_EntityId id)
+{
+	return (ctx_estorage.entities[id.index].tag_mask & it->tag_mask) == it->tag_mask;
+}
+
+bool itu_query_chunk_changed(ITU_QueryIterator* it, ITU_Archetype* archetype, int chunk)
+{
+	if(!it->changed_mask)
+		return true;
+
+	for(int i = 0; i < archetype->columns_count; ++i)
+		if((it->changed_mask & (1ull << archetype->column_types[i])) && archetype->chunks_changed_ticks[chunk * archetype->columns_count + i] > it->changed_since)
+			return true;
+	return false;
+}
+
+bool itu_query_sparse_match(ITU_QueryIterator* it, ITU_EntityId id)
+{
+	if((ctx_estorage.entities[id.index].component_mask & it->component_mask) != it->component_mask || !itu_query_tags_match(it, id))
+		return false;
+
+	if(!it->changed_mask)
+		return true;
+
+	for(int i = 0; i < it->components_count; ++i)
+	{
+		if(!(it->changed_mask & (1ull << it->component_types[i])))
+			continue;
+		ITU_Component* component = ctx_estorage.components[it->component_types[i]];
+		if(component->changed_ticks[itu_component_pool_loc_get(component, id.index)] > it->changed_since)
+			return true;
+	}
+	return false;
+}
+
+// stamps the current run of the `column`-th component of the query with the current tick
+void itu_query_mark_changed(ITU_QueryIterator* it, int column)
+{
+	SDL_assert(it->count > 0);
+	ITU_ComponentType component_type = it->component_types[column];
+
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+	{
+		ITU_Archetype* archetype = ctx_estorage.archetypes[it->archetype];
+		archetype->chunks_changed_ticks[it->chunk * archetype->columns_count + archetype->column_loc[component_type]] = ctx_estorage.tick;
+	}
+	else
+	{
+		Uint32* changed_ticks = ctx_estorage.components[component_type]->changed_ticks + it->run_locs[column];
+		for(int i = 0; i < it->count; ++i)
+			changed_ticks[i] = ctx_estorage.tick;
+	}
+}
+
+bool itu_query_next_archetype(ITU_QueryIterator* it)
+{
+	while(it->archetype < stbds_arrlen(ctx_estorage.archetypes))
+	{
+		ITU_Archetype* archetype = ctx_estorage.archetypes[it->archetype];
+		int rows_in_chunk = SDL_min(archetype->chunk_capacity, archetype->count_alive - it->chunk * archetype->chunk_capacity);
+		if((archetype->component_mask & it->component_mask) != it->component_mask || rows_in_chunk <= 0)
+		{
+			it->archetype++;
+			it->chunk = 0;
+			it->row = 0;
+			continue;
+		}
+
+		if(it->row == 0 && !itu_query_chunk_changed(it, archetype, it->chunk))
+		{
+			it->chunk++;
+			continue;
+		}
+
+		unsigned char* chunk = archetype->chunks[it->chunk];
+		ITU_EntityId* chunk_ids = (ITU_EntityId*)chunk;
+
+		// tags are not part of the archetype, so they can split a chunk in multiple runs
+		while(it->row < rows_in_chunk && !itu_query_tags_match(it, chunk_ids[it->row]))
+			it->row++;
+		int row_start = it->row;
+		while(it->row < rows_in_chunk && itu_query_tags_match(it, chunk_ids[it->row]))
+			it->row++;
+
+		if(it->row == row_start)
+		{
+			it->chunk++;
+			it->row = 0;
+			continue;
+		}
+
+		it->entity_ids = chunk_ids + row_start;
+		it->count = it->row - row_start;
+		for(int i = 0; i < it->components_count; ++i)
+		{
+			int column = archetype->column_loc[it->component_types[i]];
+			it->columns[i] = pointer_index(chunk + archetype->column_offsets[column], row_start, archetype->column_sizes[column]);
+		}
+		return true;
+	}
+	return false;
+}
+
+bool itu_query_next_sparse(ITU_QueryIterator* it)
+{
+	ITU_Component* driver = ctx_estorage.components[it->driver];
+
+	while(it->loc < driver->count_alive)
+	{
+		ITU_EntityId id = driver->entity_ids[it->loc];
+		if(!itu_query_sparse_match(it, id))
+		{
+			it->loc++;
+			continue;
+		}
+
+		// extend the run as long as every pool stores the next entity right after the previous one
+		Sint32* locs = it->run_locs;
+		for(int i = 0; i < it->components_count; ++i)
+			locs[i] = itu_component_pool_loc_get(ctx_estorage.components[it->component_types[i]], id.index);
+
+		int loc_start = it->loc++;
+		for(; it->loc < driver->count_alive; it->loc++)
+		{
+			ITU_EntityId id_next = driver->entity_ids[it->loc];
+			if(!itu_query_sparse_match(it, id_next))
+				break;
+
+			int run_length = it->loc - loc_start;
+			bool contiguous = true;
+			for(int i = 0; i < it->components_count && contiguous; ++i)
+				contiguous = itu_component_pool_loc_get(ctx_estorage.components[it->component_types[i]], id_next.index) == locs[i] + run_length;
+			if(!contiguous)
+				break;
+		}
+
+		it->entity_ids = driver->entity_ids + loc_start;
+		it->count = it->loc - loc_start;
+		for(int i = 0; i < it->components_count; ++i)
+		{
+			ITU_Component* component = ctx_estorage.components[it->component_types[i]];
+			it->columns[i] = pointer_index(component->data, locs[i], component->element_size);
+		}
+		return true;
+	}
+	return false;
+}
+
+// moves the iterator to the next run of entities. Returns false when there are no more entities to iterate
+bool itu_query_next(ITU_QueryIterator* it)
+{
+	it->count = 0;
+	if(ctx_estorage.mode == ITU_ESTORAGE_MODE_ARCHETYPE)
+		return itu_query_next_archetype(it);
+	return itu_query_next_sparse(it);
+}
+
+void itu_debug_ui_widget_entityid(const char* label, ITU_EntityId id)
+{
+	if(!itu_entity_is_valid(id))
+		ImGui::LabelText(label, "INVALID ENTITY");
+	else
+	{
+		const char* debug_name = itu_entity_get_debug_name(id);
+		ImGui::LabelText(label, "%s (%d, %d)", debug_name ? debug_name : "", id.generation, id.index);
+	}
 }
\ No newline at end of file
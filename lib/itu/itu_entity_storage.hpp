@@ -19,10 +19,33 @@
 #define SYSTEMS_COUNT_MAX     64
 #define SYSTEM_COMPONENTS_MAX  8
 #define SYSTEM_TAGS_MAX        8
-#define ENTITIES_COUNT_MAX 4096 * 4
+#define SYSTEM_TIMINGS_HISTORY_COUNT 128 // number of frames of per-system timings kept (see `itu_sys_estorage_timings_export`)
+#define SYSTEM_PARALLEL_FOR_CHUNK 256 // number of entities processed by a single job, for systems flagged with `ITU_SYSTEM_FLAG_PARALLEL_FOR`
+#define ENTITIES_COUNT_MAX 4096 * 4 // NOTE: component pools grow on demand, so this is not a hard limit anymore
+
+// set this to 0 to compile out entity debug names (ie, in release builds)
+#ifndef ITU_ENTITY_DEBUG_NAMES
+#define ITU_ENTITY_DEBUG_NAMES 1
+#endif
+
+#define COMPONENT_POOL_PAGE_SIZE        1024 // number of entity indices covered by a single (lazily allocated) page of a pool's sparse array
+#define COMPONENT_POOL_CAPACITY_DEFAULT   64 // first allocation of a pool's dense arrays, if no capacity hint is given
+
+// max number of element swaps done by an in-progress pool sort every frame (see `itu_sys_estorage_sort_begin`)
+#ifndef COMPONENT_SORT_MOVES_PER_FRAME
+#define COMPONENT_SORT_MOVES_PER_FRAME 2048
+#endif
+
+// size in bytes of a single chunk of an archetype table (only used in `ITU_ESTORAGE_MODE_ARCHETYPE`)
+#define ARCHETYPE_CHUNK_SIZE      (16 * 1024)
+// alignment of every column inside an archetype chunk (cache line size, so that columns never share a line)
+#define ARCHETYPE_COLUMN_ALIGNMENT 64
 
 #define ITU_ENTITY_ID_NULL { (Uint32)-1, (Uint32)-1 }
 
+// generation used by the placeholder ids returned by `itu_entity_deferred_create`
+#define ITU_ENTITY_GENERATION_DEFERRED ((Uint32)-2)
+
 // unique identifier for an entity. This sould be treated as an opaque handle
 struct ITU_EntityId
 {
@@ -33,11 +56,58 @@ struct ITU_EntityId
 typedef Uint8 ITU_ComponentType;
 typedef Uint8 ITU_TagType;
 
+// how component data is laid out in memory
+enum ITU_EStorageMode
+{
+	// every component type lives in its own sparse pool (`ITU_Component`).
+	// Cheap to add/remove components, but iterating multiple components requires a lookup per entity per component
+	ITU_ESTORAGE_MODE_SPARSE,
+
+	// entities with the same `component_mask` share a table (archetype) of contiguous component columns, split in chunks.
+	// Iterating multiple components streams dense arrays, but adding/removing a component moves the entity to a different table
+	ITU_ESTORAGE_MODE_ARCHETYPE,
+};
+
+// a set of components (with default values) and tags, used to create many identical entities at once
+// NOTE: zero-initialize it (`ITU_Prefab prefab = { };`) before use, and release it with `itu_prefab_free`
+struct ITU_Prefab
+{
+	Uint64 component_mask;
+	Uint64 tag_mask;
+
+	stbds_arr(unsigned char) data;               // default values of all components, one after the other
+	Sint32 data_offsets[COMPONENTS_COUNT_MAX];   // location in `data` of each component in `component_mask`
+};
+
 // signature for a system-like update function
 typedef void (*ITU_SystemUpdateFunction)(SDLContext* context, ITU_EntityId* entity_ids, int entity_ids_count);
 
 // signature for a component debug UI render function
 typedef void (*ITU_ComponendDebugUIRender)(SDLContext* context, void* data);
+// called on every component when saving/loading a snapshot (see `itu_sys_estorage_snapshot_save`)
+typedef void (*ITU_ComponentSnapshotFunction)(ITU_EntityId id, void* data);
+
+enum ITU_SystemFlags
+{
+	ITU_SYSTEM_FLAG_NONE         = 0,
+	ITU_SYSTEM_FLAG_MAIN_THREAD  = 1 << 0, // the system always runs on the main thread (ie, anything using the SDL renderer)
+	ITU_SYSTEM_FLAG_PARALLEL_FOR = 1 << 1, // the entity list can be split in chunks, updated concurrently by separate `fn_update` calls
+	ITU_SYSTEM_FLAG_QUERY        = 1 << 2, // the system iterates its own `itu_query` instead of the entity list, so no list is kept
+	                                       // (`fn_update` always gets an empty one). Can't be combined with PARALLEL_FOR or `time_slices`
+};
+
+// systems are grouped in phases, that run in this order: input, fixed update, update, render.
+// Every phase has its own rate (see `itu_sys_estorage_phase_set_rate`): by default the fixed update runs
+// every `PHYSICS_TIMESTEP_NSECS` (so 0, 1 or more times per frame), and all the others run once per frame
+// NOTE: update is the default phase (0), so existing system definitions don't need to change
+enum ITU_SystemPhase
+{
+	ITU_SYSTEM_PHASE_UPDATE = 0,
+	ITU_SYSTEM_PHASE_INPUT,
+	ITU_SYSTEM_PHASE_FIXED_UPDATE,
+	ITU_SYSTEM_PHASE_RENDER,
+	ITU_SYSTEM_PHASE_MAX
+};
 
 struct ITU_SystemDef
 {
@@ -45,17 +115,44 @@ struct ITU_SystemDef
 	ITU_SystemUpdateFunction fn_update;
 	Uint64 component_mask;
 	Uint64 tag_mask;
+
+	// components read/written by the system, used to decide which systems can run concurrently.
+	// NOTE: a system that declares no access is "exclusive": it runs alone on the main thread, and it is the only
+	//       kind of system allowed to do immediate structural changes (the others have to use the `itu_entity_deferred_*` functions)
+	Uint64 read_mask;
+	Uint64 write_mask;
+	Uint32 flags; // ITU_SystemFlags
+
+	Uint32 phase; // ITU_SystemPhase
+	// if > 1, every run only gets a slice of `1/time_slices` of the matching entities (a different one each time),
+	// for expensive work that doesn't need to be up to date every frame (AI, target acquisition, ...)
+	// NOTE: it only affects the entity list passed to `fn_update`, queries done inside the system still see everything
+	Uint32 time_slices;
 };
 
-#define register_component(T) ITU_ComponentType ITU_COMPONENT_TYPE_##T; const char* ITU_COMPONENT_NAME_##T = #T;
-#define enable_component(T) itu_sys_estorage_add_component_pool(sizeof(T), ENTITIES_COUNT_MAX, &ITU_COMPONENT_TYPE_##T, ITU_COMPONENT_NAME_##T)
+// maps a component struct to its component type (specialized by `register_component`, used by `itu_query`)
+// NOTE: `register_component` forward declares `T`, so components must be `struct`s (no typedefs)
+template<typename T> struct ITU_ComponentTypeOf;
+
+#define register_component(T) ITU_ComponentType ITU_COMPONENT_TYPE_##T; const char* ITU_COMPONENT_NAME_##T = #T; struct T; template<> struct ITU_ComponentTypeOf<T> { static ITU_ComponentType get() { return ITU_COMPONENT_TYPE_##T; } };
+#define enable_component(T) itu_sys_estorage_add_component_pool(sizeof(T), 0, &ITU_COMPONENT_TYPE_##T, ITU_COMPONENT_NAME_##T)
+// same as `enable_component`, but preallocates room for `capacity` components (the pool can still grow past it)
+#define enable_component_with_capacity(T, capacity) itu_sys_estorage_add_component_pool(sizeof(T), capacity, &ITU_COMPONENT_TYPE_##T, ITU_COMPONENT_NAME_##T)
 
 #define add_component_debug_ui_render(T, fn_debug_ui_render) itu_sys_estorage_add_component_debug_ui_render( ITU_COMPONENT_TYPE_##T, fn_debug_ui_render);
+#define add_component_snapshot_hooks(T, fn_save, fn_load) itu_sys_estorage_add_component_snapshot_hooks(ITU_COMPONENT_TYPE_##T, fn_save, fn_load);
 
-#define entity_get_data(id, T) (T*)itu_entity_data_get((id), ITU_COMPONENT_TYPE_##T)
+#define entity_get_data(id, T) ((T*)itu_entity_data_get((id), ITU_COMPONENT_TYPE_##T))
+// same as `entity_get_data`, but also marks the component as changed (use it when writing, see "change tracking")
+#define entity_get_data_mut(id, T) ((T*)itu_entity_data_get_mut((id), ITU_COMPONENT_TYPE_##T))
 
 #define add_system(fn_update, component_mask, tag_mask) itu_sys_estorage_add_system({ #fn_update, fn_update, component_mask, tag_mask })
+#define add_system_with_access(fn_update, component_mask, tag_mask, read_mask, write_mask, flags) itu_sys_estorage_add_system({ #fn_update, fn_update, component_mask, tag_mask, read_mask, write_mask, flags })
+#define add_system_in_phase(fn_update, component_mask, tag_mask, phase) itu_sys_estorage_add_system({ #fn_update, fn_update, component_mask, tag_mask, 0, 0, 0, phase })
+#define add_system_time_sliced(fn_update, component_mask, tag_mask, phase, time_slices) itu_sys_estorage_add_system({ #fn_update, fn_update, component_mask, tag_mask, 0, 0, 0, phase, time_slices })
 #define entity_add_component(id, T, value) { type_check_struct(T, value); itu_entity_component_add((id), ITU_COMPONENT_TYPE_##T, &value); }
+#define prefab_set_component(prefab, T, value) { type_check_struct(T, value); itu_prefab_component_set((prefab), ITU_COMPONENT_TYPE_##T, &value); }
+#define entity_add_component_deferred(id, T, value) { type_check_struct(T, value); itu_entity_deferred_component_add((id), ITU_COMPONENT_TYPE_##T, &value); }
 
 #define component_mask(T) (1ull << ITU_COMPONENT_TYPE_##T)
 #define component_type(T) ITU_COMPONENT_TYPE_##T
@@ -64,34 +161,276 @@ struct ITU_SystemDef
 #define set_tag_debug_name(tag, name) 
 
 
+// makes an entity's `Transform` relative to another entity.
+// The child's `Transform` becomes a cache of its world transform, recomputed by `itu_system_transform_hierarchy`
+// from the parent's `Transform` and `local` (so game code should modify `local`, not `Transform`)
+// NOTE: change `parent` through `itu_transform_set_parent`
+struct TransformParent
+{
+	ITU_EntityId parent;
+	Transform local;
+};
+
+#define TRANSFORM_HIERARCHY_DEPTH_MAX 64
+#define SPATIAL_QUERY_NEAREST_MAX     64 // max `k` of `itu_spatial_query_nearest`
+
 // register default components
 register_component(Transform)
 register_component(Sprite)
 register_component(PhysicsData)
 register_component(PhysicsStaticData)
 register_component(ShapeData)
+register_component(TransformParent)
+register_component(SpriteCompact)
+register_component(PhysicsInterpolation)
+
+// worlds
+// a world is a whole independent entity storage (entities, components, systems, ...).
+// All the functions in this file work on the calling thread's current world, which is the default one unless changed:
+// to run multiple worlds side by side (e.g. headless simulations, one per core), create them with `itu_world_create`
+// and either make them current (see `ITU_WorldScope`) or use the `itu_world_*` versions of the functions below.
+// NOTE: component types are global, so all worlds need to enable the same components in the same order
+// NOTE: worlds created with `itu_world_create` run their systems on the calling thread, because the worker pool
+//       is shared. Only enable parallel systems on a world if no other world uses them at the same time
+struct ITU_World;
+
+ITU_World* itu_world_create(int starting_entities_count, bool enable_standard_components, ITU_EStorageMode mode);
+void       itu_world_destroy(ITU_World* world);
+ITU_World* itu_world_default();
+ITU_World* itu_world_get_current();
+// `world` can be NULL (default world). Returns the previous current world
+ITU_World* itu_world_set_current(ITU_World* world);
+void       itu_world_set_parallel_systems(ITU_World* world, bool enabled);
+
+void         itu_world_systems_update         (ITU_World* world, SDLContext* context);
+ITU_EntityId itu_world_entity_create          (ITU_World* world);
+void         itu_world_entity_destroy         (ITU_World* world, ITU_EntityId id);
+void         itu_world_entity_component_add   (ITU_World* world, ITU_EntityId id, ITU_ComponentType component_type, void* in_data_copy);
+void         itu_world_entity_component_remove(ITU_World* world, ITU_EntityId id, ITU_ComponentType component_type);
+void*        itu_world_entity_data_get        (ITU_World* world, ITU_EntityId id, ITU_ComponentType component_type);
 
-void itu_sys_estorage_init(int starting_entities_count, bool enable_standard_components);
+// makes `world` current until the end of the scope
+struct ITU_WorldScope
+{
+	ITU_World* world_prev;
+
+	ITU_WorldScope(ITU_World* world) { world_prev = itu_world_set_current(world); }
+	~ITU_WorldScope() { itu_world_set_current(world_prev); }
+};
+
+void itu_sys_estorage_init(int starting_entities_count, bool enable_standard_components, ITU_EStorageMode mode);
 void itu_sys_estorage_clear_all_entities();
 void itu_sys_estorage_add_system(ITU_SystemDef system_def);
 void itu_sys_estorage_set_systems(ITU_SystemDef* systems, int systems_count);
 void itu_sys_estorage_systems_update(SDLContext* context);
 
+// phases
+// `period`: time between two runs of the phase (0 to run it once per frame). A phase with a period
+// runs as many times as needed to catch up with the elapsed time, but at most `runs_max` times per frame
+void  itu_sys_estorage_phase_set_rate(ITU_SystemPhase phase, SDL_Time period, int runs_max);
+// fraction of the phase period elapsed but not run yet (0 for phases without a period). Used to interpolate fixed rate state
+float itu_sys_estorage_phase_alpha(ITU_SystemPhase phase);
+// number of times the phase has run during the current frame (so far)
+int   itu_sys_estorage_phase_runs_count(ITU_SystemPhase phase);
+
+// timings
+// every frame, the time spent in each system (summed over all its runs and jobs) and the time spent applying
+// structural changes between waves are recorded in a rolling history of `SYSTEM_TIMINGS_HISTORY_COUNT` frames.
+// The debug UI shows them, and this writes them as CSV (one row per frame, oldest first, times in milliseconds)
+bool  itu_sys_estorage_timings_export(const char* path);
+// total time spent in systems (and structural changes) during the last update
+Uint64 itu_sys_estorage_timings_last_total();
+// logs how the last update was spent, system by system (ie when a frame hitches)
+void  itu_sys_estorage_timings_last_log();
+
+// change tracking
+// every component has a change tick, set to the current tick whenever it's accessed for writing
+// (`itu_entity_data_get_mut`, `itu_query::column`) or added. Ticks are per entity in `ITU_ESTORAGE_MODE_SPARSE`,
+// and per chunk in `ITU_ESTORAGE_MODE_ARCHETYPE` (so there a change marks the whole chunk)
+Uint32 itu_sys_estorage_tick();
+// tick of the last update of the system currently running on the calling thread (0 if none, or if it never ran).
+// Used as `since` in `itu_query::changed` it selects everything changed since the system looked at it the last time
+Uint32 itu_sys_estorage_system_tick_last_run();
+
 void itu_sys_estorage_tag_set_debug_name(int tag, const char* tag_debug_name);
+void itu_sys_estorage_add_component_snapshot_hooks(ITU_ComponentType component_type, ITU_ComponentSnapshotFunction fn_save, ITU_ComponentSnapshotFunction fn_load);
+
+// snapshots
+// saves/loads all entities (with their components, tags and debug names) to/from a versioned binary file.
+// Component data is block-copied, so components holding pointers or handles need hooks:
+//  - `fn_save` patches the copy being written (e.g. replacing a pointer with a stable id), the live data is untouched
+//  - `fn_load` patches the loaded data in place
+// Loading replaces all current entities, and needs the same storage mode and the same components (same order and size).
+// Returns false if the file can't be loaded (missing, truncated, corrupt, or not matching): the whole file is checked
+// before anything is loaded, so in that case the current state is kept
+// NOTE: default hooks translate `Sprite::texture` to a resource storage id, and clear box2d ids (box2d objects are not
+//       part of the snapshot: override the hooks to recreate bodies and shapes on load)
+bool itu_sys_estorage_snapshot_save(const char* path);
+bool itu_sys_estorage_snapshot_load(const char* path);
 void itu_sys_estorage_debug_render(SDLContext* context);
 
 ITU_EntityId itu_entity_create();
 void  itu_entity_set_debug_name  (ITU_EntityId id, const char* debug_name);
+const char* itu_entity_get_debug_name(ITU_EntityId id);
 bool  itu_entity_equals          (ITU_EntityId a, ITU_EntityId b);
 bool  itu_entity_is_valid        (ITU_EntityId id);
 void  itu_entity_id_to_stringid  (ITU_EntityId id, char* buffer, int max_len);
 void* itu_entity_data_get        (ITU_EntityId id, ITU_ComponentType component_type);
+void* itu_entity_data_get_mut    (ITU_EntityId id, ITU_ComponentType component_type);
+void  itu_entity_mark_changed    (ITU_EntityId id, ITU_ComponentType component_type);
+Uint32 itu_entity_changed_tick   (ITU_EntityId id, ITU_ComponentType component_type);
 void  itu_entity_tag_add         (ITU_EntityId id, ITU_TagType tag);
 void  itu_entity_tag_remove      (ITU_EntityId id, ITU_TagType tag);
 bool  itu_entity_tag_has         (ITU_EntityId id, ITU_TagType tag);
+// true if `id` is valid and has all the components in `component_mask` and all the tags in `tag_mask`
+bool  itu_entity_matches         (ITU_EntityId id, Uint64 component_mask, Uint64 tag_mask);
+// returns all the entities that currently have `tag` (the array is invalidated by any tag add/remove)
+ITU_EntityId* itu_entity_tag_members(ITU_TagType tag, int* out_count);
 void  itu_entity_component_add   (ITU_EntityId id, ITU_ComponentType component_type, void* in_data_copy);
 void  itu_entity_component_remove(ITU_EntityId id, ITU_ComponentType component_type);
 void  itu_entity_destroy         (ITU_EntityId id);
 
+// `in_data_copy`: default value for the component. Can be null (zero-initialized)
+void itu_prefab_component_set(ITU_Prefab* prefab, ITU_ComponentType component_type, void* in_data_copy);
+void itu_prefab_tag_add      (ITU_Prefab* prefab, ITU_TagType tag);
+void itu_prefab_free         (ITU_Prefab* prefab);
+
+// creates `count` entities with all the components (and tags) of `prefab`, writing their ids in `out_ids`.
+// Way faster than creating them one by one: ids are reserved in one go, and component data is block-copied once per pool
+void itu_entity_create_batch(ITU_Prefab* prefab, int count, ITU_EntityId* out_ids);
+
+// attaches `child` to `parent`, with `local` relative to it (adds `TransformParent` if needed).
+// Passing `ITU_ENTITY_ID_NULL` as `parent` detaches `child`, leaving it at its current world transform
+// NOTE: can be called from systems: adding/removing `TransformParent` goes through the deferred commands, so while systems
+//       are updating the child is attached/detached at the end of the current wave (changing an existing parent is immediate)
+void itu_transform_set_parent(ITU_EntityId child, ITU_EntityId parent, Transform local);
+
+// spatial index
+// optional grid over `Transform` positions (per world, disabled by default), updated once per frame by
+// `itu_system_spatial_index` for the entities whose `Transform` changed. Queries only visit the cells around
+// the searched area, and only return entities that have all the components in `component_mask` and all the tags in `tag_mask`.
+// NOTE: the system is added by the first `itu_spatial_index_enable`, in the input phase: the index is updated at the start
+//       of the frame, so queries see the positions at the end of the previous one (don't query it from input systems)
+// NOTE: `cell_size` should be around the typical query radius. Enabling (again) rebuilds the index from scratch
+void itu_spatial_index_enable(float cell_size);
+void itu_spatial_index_disable();
+bool itu_spatial_index_enabled();
+// these return the number of ids written in `out_ids`
+int itu_spatial_query_rect   (vec2f min, vec2f max, Uint64 component_mask, Uint64 tag_mask, ITU_EntityId* out_ids, int out_ids_max);
+int itu_spatial_query_radius (vec2f center, float radius, Uint64 component_mask, Uint64 tag_mask, ITU_EntityId* out_ids, int out_ids_max);
+// the (up to) `k` entities closest to `center` and not farther than `radius_max` (0 for no limit), sorted by distance
+int itu_spatial_query_nearest(vec2f center, float radius_max, int k, Uint64 component_mask, Uint64 tag_mask, ITU_EntityId* out_ids);
+
+// deferred structural changes
+// While systems are updating, structural changes would invalidate the arrays systems are iterating (and they are not thread safe).
+// These record the change in a per-thread command buffer instead, and buffers are played back after every wave of systems.
+// Outside of system updates they are applied immediately
+// NOTE: while updating, `itu_entity_deferred_create` returns a placeholder id, that can only be used with other deferred calls
+//       made during the same wave (it means nothing after the playback)
+ITU_EntityId itu_entity_deferred_create();
+void itu_entity_deferred_destroy         (ITU_EntityId id);
+void itu_entity_deferred_component_add   (ITU_EntityId id, ITU_ComponentType component_type, void* in_data_copy);
+void itu_entity_deferred_component_remove(ITU_EntityId id, ITU_ComponentType component_type);
+void itu_entity_deferred_tag_add         (ITU_EntityId id, ITU_TagType tag);
+void itu_entity_deferred_tag_remove      (ITU_EntityId id, ITU_TagType tag);
+
+// applies all the recorded deferred changes (called automatically between waves of systems)
+void itu_sys_estorage_commands_playback();
+
+// pool sorting
+// reorders the storage of `component_type` by a user key (e.g. texture pointer for render batching, or spatial cell),
+// so that iterating it walks memory in key order.
+//  - in `ITU_ESTORAGE_MODE_SPARSE` the pools in `follow_mask` get the same relative order for the entities they share
+//    with `component_type`, so queries over them get long contiguous runs again
+//  - in `ITU_ESTORAGE_MODE_ARCHETYPE` the rows of every archetype with `component_type` are sorted (columns move together,
+//    so `follow_mask` is not needed)
+// Keys are computed once in `itu_sys_estorage_sort_begin`, while data moves are spread over time:
+// `itu_sys_estorage_systems_update` does up to COMPONENT_SORT_MOVES_PER_FRAME of them every frame
+// (call `itu_sys_estorage_sort_step` directly to go faster). Starting a new sort drops the one in progress
+// NOTE: structural changes while sorting are fine, the result will just be a bit less sorted
+typedef Uint64 (*ITU_ComponentSortKeyFunction)(ITU_EntityId id, void* data);
+
+void itu_sys_estorage_sort_begin(ITU_ComponentType component_type, ITU_ComponentSortKeyFunction fn_key, Uint64 follow_mask);
+// does up to `moves_max` element swaps, returns true when the sort is complete
+bool itu_sys_estorage_sort_step(int moves_max);
+bool itu_sys_estorage_sort_in_progress();
+
+// iterates all entities having a set of components (and tags), one run at a time.
+// A run is a range of entities whose components are all stored contiguously, so the caller
+// gets raw arrays (`columns`) and a `count`, without any per-entity lookup.
+//  - in `ITU_ESTORAGE_MODE_ARCHETYPE` a run is (up to) a whole archetype chunk, and columns are ARCHETYPE_COLUMN_ALIGNMENT aligned
+//  - in `ITU_ESTORAGE_MODE_SPARSE` we walk the smallest pool, and a run lasts as long as the other pools store data in the same order
+// NOTE: adding/removing components or tags, or destroying entities, while iterating invalidates the iterator
+struct ITU_QueryIterator
+{
+	ITU_ComponentType component_types[SYSTEM_COMPONENTS_MAX];
+	int components_count;
+	Uint64 component_mask;
+	Uint64 tag_mask;
+	Uint64 changed_mask;  // if not 0, only entities where any of these components changed after `changed_since`
+	Uint32 changed_since;
+
+	// iteration state
+	Sint32 archetype;
+	Sint32 chunk;
+	Sint32 row;
+	ITU_ComponentType driver; // sparse mode: pool we are walking
+	Sint32 loc;
+
+	// current run
+	ITU_EntityId* entity_ids;
+	void* columns[SYSTEM_COMPONENTS_MAX]; // one for every entry in `component_types`, same order
+	Sint32 run_locs[SYSTEM_COMPONENTS_MAX]; // sparse mode: location of the run in every pool
+	int count;
+};
+
+void itu_query_begin(ITU_QueryIterator* it, ITU_ComponentType* component_types, int components_count, Uint64 tag_mask);
+bool itu_query_next (ITU_QueryIterator* it);
+// NOTE: must be called before the first `itu_query_next`
+void itu_query_filter_changed(ITU_QueryIterator* it, Uint64 changed_mask, Uint32 changed_since);
+void itu_query_mark_changed  (ITU_QueryIterator* it, int column);
+
+// position of `T` in the list `Ts` (compile time)
+template<typename T, typename... Ts> struct ITU_TypeIndex;
+template<typename T, typename... Ts> struct ITU_TypeIndex<T, T, Ts...> { enum { value = 0 }; };
+template<typename T, typename U, typename... Ts> struct ITU_TypeIndex<T, U, Ts...> { enum { value = 1 + ITU_TypeIndex<T, Ts...>::value }; };
+
+// typed wrapper around `ITU_QueryIterator`. Usage:
+//   itu_query<Transform, Sprite> query;
+//   while(query.next())
+//   {
+//       Transform* transforms = query.column<Transform>();
+//       Sprite*    sprites    = query.column<Sprite>();
+//       for(int i = 0; i < query.count(); ++i)
+//           do_stuff(&transforms[i], &sprites[i]);
+//   }
+template<typename... T>
+struct itu_query
+{
+	ITU_QueryIterator it;
+
+	itu_query(Uint64 tag_mask = 0)
+	{
+		static_assert(sizeof...(T) > 0 && sizeof...(T) <= SYSTEM_COMPONENTS_MAX, "invalid number of query components");
+		ITU_ComponentType component_types[] = { ITU_ComponentTypeOf<T>::get()... };
+		itu_query_begin(&it, component_types, sizeof...(T), tag_mask);
+	}
+
+	// only iterate entities where any of the components in `mask` changed after `since_tick`
+	itu_query& changed(Uint64 mask, Uint32 since_tick) { itu_query_filter_changed(&it, mask, since_tick); return *this; }
+
+	bool next() { return itu_query_next(&it); }
+	int count() { return it.count; }
+	ITU_EntityId* entity_ids() { return it.entity_ids; }
+
+	// write access, marks the whole run as changed
+	template<typename C>
+	C* column() { itu_query_mark_changed(&it, ITU_TypeIndex<C, T...>::value); return (C*)it.columns[ITU_TypeIndex<C, T...>::value]; }
+
+	// NOTE: doesn't mark anything as changed, so don't write through it
+	template<typename C>
+	C* column_read() { return (C*)it.columns[ITU_TypeIndex<C, T...>::value]; }
+};
+
 void itu_debug_ui_widget_entityid(const char* label, ITU_EntityId id);
 #endif // ITU_ENTITY_STORAGE_HPP
@@ -0,0 +1,253 @@
+// linear (bump) allocators
+// An `ITU_Arena` hands out memory by moving an offset forward, and frees everything at once (`itu_arena_reset`),
+// or everything allocated after a given point (`itu_arena_temp_begin`/`itu_arena_temp_end`). No per-allocation bookkeeping.
+// - frame arena (`SDLContext::arena_frame`): memory that lives until the end of the frame. Reset by the main loop, main thread only
+// - scratch arenas (`itu_arena_scratch_begin`/`itu_arena_scratch_end`): temporary memory inside a function. Every thread has its own
+//
+// Arenas have no hard limit: when a block is full a new one is chained to it. Once an arena needed more than one block,
+// resetting it (or ending an outermost temp) replaces them with a single block as big as the most it ever had,
+// so after a few frames the arena settles to its high-water mark and never calls the allocator again.
+// NOTE: a zero-initialized arena is ready to use (it allocates its first block on first use)
+
+#ifndef ITU_LIB_ARENA_HPP
+#define ITU_LIB_ARENA_HPP
+
+#ifndef ITU_UNITY_BUILD
+#include <SDL3/SDL.h>
+#include <itu_common.hpp>
+#include <itu_lib_memory.hpp>
+#endif
+
+#define ITU_ARENA_BLOCK_SIZE_DEFAULT KB(64) // minimum size of a block, if the arena doesn't specify one
+#define ITU_ARENA_SCRATCH_COUNT      2      // per thread, see `itu_arena_scratch_begin`
+
+struct ITU_ArenaBlock
+{
+	ITU_ArenaBlock* prev;
+	Uint64 capacity;
+	Uint64 used;
+	Uint64 used_before; // bytes used in all the previous blocks when this one was added
+};
+
+struct ITU_Arena
+{
+	ITU_ArenaBlock* block; // current block (older ones are linked through `prev`)
+	Uint64 block_size;     // minimum size of new blocks (0 means `ITU_ARENA_BLOCK_SIZE_DEFAULT`)
+	Uint64 used_peak;      // highest `itu_arena_used` ever reached
+	Uint64 capacity_peak;  // highest `itu_arena_capacity` ever reached
+	int    temp_depth;     // number of temps currently open
+};
+
+// position in an arena, everything allocated after it is freed by `itu_arena_temp_end`
+struct ITU_ArenaTemp
+{
+	ITU_Arena*      arena;
+	ITU_ArenaBlock* block;
+	Uint64          used;
+};
+
+void   itu_arena_init(ITU_Arena* arena, Uint64 block_size);
+void   itu_arena_deinit(ITU_Arena* arena);
+void*  itu_arena_alloc(ITU_Arena* arena, Uint64 size, Uint64 alignment);
+char*  itu_arena_strdup(ITU_Arena* arena, const char* str);
+void   itu_arena_reset(ITU_Arena* arena);
+Uint64 itu_arena_used(ITU_Arena* arena);
+Uint64 itu_arena_capacity(ITU_Arena* arena);
+
+ITU_ArenaTemp itu_arena_temp_begin(ITU_Arena* arena);
+void          itu_arena_temp_end(ITU_ArenaTemp temp);
+
+ITU_ArenaTemp itu_arena_scratch_begin(ITU_Arena* conflict = NULL);
+void          itu_arena_scratch_end(ITU_ArenaTemp temp);
+void          itu_arena_scratch_thread_deinit();
+
+// NOTE: memory is NOT zeroed
+#define arena_push_array(arena, type, count) ((type*)itu_arena_alloc((arena), sizeof(type) * (count), alignof(type)))
+#define arena_push_struct(arena, type)       arena_push_array(arena, type, 1)
+
+#endif // ITU_LIB_ARENA_HPP
+
+#if (defined ITU_LIB_ARENA_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
+
+// block data starts right after the header, padded to keep the same alignment `SDL_malloc` gives us
+#define ITU_ARENA_BLOCK_HEADER_SIZE ((sizeof(ITU_ArenaBlock) + 15) & ~(Uint64)15)
+
+static thread_local ITU_Arena arena_scratch[ITU_ARENA_SCRATCH_COUNT];
+
+Uint8* itu_arena_block_data(ITU_ArenaBlock* block)
+{
+	return (Uint8*)block + ITU_ARENA_BLOCK_HEADER_SIZE;
+}
+
+ITU_ArenaBlock* itu_arena_block_create(ITU_Arena* arena, Uint64 capacity_min)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_ARENAS);
+	Uint64 capacity = SDL_max(arena->block_size ? arena->block_size : ITU_ARENA_BLOCK_SIZE_DEFAULT, capacity_min);
+	ITU_ArenaBlock* block = (ITU_ArenaBlock*)SDL_malloc(ITU_ARENA_BLOCK_HEADER_SIZE + capacity);
+	SDL_assert(block && "out of memory");
+	block->prev = NULL;
+	block->capacity = capacity;
+	block->used = 0;
+	block->used_before = 0;
+	return block;
+}
+
+// frees every block after `last` (all of them if `last` is NULL)
+void itu_arena_blocks_free(ITU_Arena* arena, ITU_ArenaBlock* last)
+{
+	while(arena->block != last)
+	{
+		ITU_ArenaBlock* prev = arena->block->prev;
+		SDL_free(arena->block);
+		arena->block = prev;
+	}
+}
+
+// called when the arena is empty: if it ever needed more than it has now, replace its blocks with a single one big enough
+void itu_arena_blocks_merge(ITU_Arena* arena)
+{
+	if(!arena->block->prev && arena->block->capacity >= arena->capacity_peak)
+		return;
+
+	itu_arena_blocks_free(arena, NULL);
+	arena->block = itu_arena_block_create(arena, arena->capacity_peak);
+}
+
+// `block_size`: minimum size of every block (0 for `ITU_ARENA_BLOCK_SIZE_DEFAULT`). Nothing is allocated until first use
+void itu_arena_init(ITU_Arena* arena, Uint64 block_size)
+{
+	SDL_memset(arena, 0, sizeof(*arena));
+	arena->block_size = block_size;
+}
+
+void itu_arena_deinit(ITU_Arena* arena)
+{
+	itu_arena_blocks_free(arena, NULL);
+	SDL_memset(arena, 0, sizeof(*arena));
+}
+
+// `alignment` must be a power of 2
+void* itu_arena_alloc(ITU_Arena* arena, Uint64 size, Uint64 alignment)
+{
+	SDL_assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	ITU_ArenaBlock* block = arena->block;
+	Uint64 offset = 0;
+	if(block)
+	{
+		Uint64 address = (Uint64)(uintptr_t)(itu_arena_block_data(block) + block->used);
+		offset = block->used + (((address + alignment - 1) & ~(alignment - 1)) - address);
+	}
+
+	if(!block || offset + size > block->capacity)
+	{
+		// NOTE: the data of a new block is 16-aligned, the extra `alignment` bytes cover bigger alignments
+		ITU_ArenaBlock* block_new = itu_arena_block_create(arena, size + alignment);
+		block_new->prev = block;
+		block_new->used_before = block ? block->used_before + block->used : 0;
+		arena->block = block = block_new;
+		arena->capacity_peak = SDL_max(arena->capacity_peak, itu_arena_capacity(arena));
+
+		Uint64 address = (Uint64)(uintptr_t)itu_arena_block_data(block);
+		offset = ((address + alignment - 1) & ~(alignment - 1)) - address;
+	}
+
+	block->used = offset + size;
+	arena->used_peak = SDL_max(arena->used_peak, block->used_before + block->used);
+	return itu_arena_block_data(block) + offset;
+}
+
+char* itu_arena_strdup(ITU_Arena* arena, const char* str)
+{
+	Uint64 len = SDL_strlen(str);
+	char* ret = arena_push_array(arena, char, len + 1);
+	SDL_memcpy(ret, str, len + 1);
+	return ret;
+}
+
+// frees everything. O(1), unless the arena grew since the last reset
+void itu_arena_reset(ITU_Arena* arena)
+{
+	SDL_assert(arena->temp_depth == 0 && "arena reset while a temp is still open");
+	if(!arena->block)
+		return;
+
+	arena->block->used = 0;
+	itu_arena_blocks_merge(arena);
+}
+
+Uint64 itu_arena_used(ITU_Arena* arena)
+{
+	return arena->block ? arena->block->used_before + arena->block->used : 0;
+}
+
+Uint64 itu_arena_capacity(ITU_Arena* arena)
+{
+	Uint64 ret = 0;
+	for(ITU_ArenaBlock* block = arena->block; block; block = block->prev)
+		ret += block->capacity;
+	return ret;
+}
+
+ITU_ArenaTemp itu_arena_temp_begin(ITU_Arena* arena)
+{
+	// NOTE: make sure there is a block to go back to, otherwise every temp would end up allocating (and freeing) one
+	if(!arena->block)
+		arena->block = itu_arena_block_create(arena, 0);
+
+	arena->temp_depth++;
+
+	ITU_ArenaTemp ret;
+	ret.arena = arena;
+	ret.block = arena->block;
+	ret.used = arena->block->used;
+	return ret;
+}
+
+// temps can be nested, but must be ended in reverse order
+void itu_arena_temp_end(ITU_ArenaTemp temp)
+{
+	SDL_assert(temp.arena->temp_depth > 0);
+	temp.arena->temp_depth--;
+
+	itu_arena_blocks_free(temp.arena, temp.block);
+	temp.block->used = temp.used;
+
+	// outermost temp on an empty arena, same as `itu_arena_reset`
+	// NOTE: an inner temp can start on an empty arena too (if the outer one didn't allocate yet),
+	//       merging there would free the block the outer temp goes back to
+	if(temp.arena->temp_depth == 0 && temp.used == 0 && !temp.block->prev)
+		itu_arena_blocks_merge(temp.arena);
+}
+
+// temporary memory for the calling thread, freed by `itu_arena_scratch_end`. Scratch arenas can be nested freely.
+// `conflict`: if the caller wants to return something allocated in an arena it got as a parameter, it must pass it here.
+//             That arena could be one of our scratch arenas, in use by one of our callers, and ending our scratch
+//             would free the result as well (so we give back another one)
+//   e.g. char* path_make(ITU_Arena* arena_out, ...)
+//        {
+//        	ITU_ArenaTemp scratch = itu_arena_scratch_begin(arena_out);
+//        	... temporary stuff in `scratch.arena`, result in `arena_out` ...
+//        	itu_arena_scratch_end(scratch);
+//        }
+ITU_ArenaTemp itu_arena_scratch_begin(ITU_Arena* conflict)
+{
+	ITU_Arena* arena = &arena_scratch[0];
+	if(arena == conflict)
+		arena = &arena_scratch[1];
+	return itu_arena_temp_begin(arena);
+}
+
+void itu_arena_scratch_end(ITU_ArenaTemp temp)
+{
+	itu_arena_temp_end(temp);
+}
+
+// frees the scratch arenas of the calling thread. Call before the thread exits
+void itu_arena_scratch_thread_deinit()
+{
+	for(int i = 0; i < ITU_ARENA_SCRATCH_COUNT; ++i)
+		itu_arena_deinit(&arena_scratch[i]);
+}
+
+#endif // (defined ITU_LIB_ARENA_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
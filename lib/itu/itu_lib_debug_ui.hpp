@@ -6,6 +6,16 @@ void itu_debug_ui_render_sprite(SDLContext* context, void* data);
 void itu_debug_ui_render_physicsdata(SDLContext* context, void* data);
 void itu_debug_ui_render_physicsstaticdata(SDLContext* context, void* data);
 void itu_debug_ui_render_shapedata(SDLContext* context, void* data);
+void itu_debug_ui_render_transformparent(SDLContext* context, void* data);
+void itu_debug_ui_render_spritecompact(SDLContext* context, void* data);
+void itu_debug_ui_render_physicsinterpolation(SDLContext* context, void* data);
+
+// frame time graph, percentiles and hitches of the main loop
+void itu_debug_ui_render_frame_stats(ITU_FrameLoop* loop);
+// flame view of the last frame recorded by the profiler (see `itu_lib_profiler.hpp`)
+void itu_debug_ui_render_profiler();
+// live memory per tag and allocations per frame (see `itu_lib_memory.hpp`)
+void itu_debug_ui_render_memory();
 
 #endif // ITU_LIB_DEBUG_UI_HPP
 
@@ -17,6 +27,9 @@ void itu_debug_ui_render_shapedata(SDLContext* context, void* data);
 #ifndef ITU_UNITY_BUILD
 #include <imgui/imgui.h>
 #include <box2d/box2d.h>
+#include <itu_lib_loop.hpp>
+#include <itu_lib_profiler.hpp>
+#include <itu_lib_memory.hpp>
 
 #endif
 
@@ -46,6 +59,16 @@ void itu_debug_ui_render_sprite(SDLContext* context, void* data)
 	ImGui::Checkbox("Flip Hor.", &data_sprite->flip_horizontal);
 }
 
+// edited as a normal `Sprite`, and packed back
+void itu_debug_ui_render_spritecompact(SDLContext* context, void* data)
+{
+	SpriteCompact* data_sprite = (SpriteCompact*)data;
+
+	Sprite sprite = itu_lib_sprite_compact_to_sprite(data_sprite);
+	itu_debug_ui_render_sprite(context, &sprite);
+	*data_sprite = itu_lib_sprite_compact_from_sprite(&sprite);
+}
+
 void itu_debug_ui_render_physicsdata(SDLContext* context, void* data)
 {
 	PhysicsData* data_body = (PhysicsData*)data;
@@ -56,6 +79,17 @@ void itu_debug_ui_render_physicsdata(SDLContext* context, void* data)
 	// TODO show definition data (either here, or in a more appropriate place)
 }
 
+// read-only, it gets overwritten on every physics step anyway
+void itu_debug_ui_render_physicsinterpolation(SDLContext* context, void* data)
+{
+	PhysicsInterpolation* data_interpolation = (PhysicsInterpolation*)data;
+
+	ImGui::Text("position %.3f %.3f", data_interpolation->fixed_step_position.x, data_interpolation->fixed_step_position.y);
+	ImGui::Text("rotation %.3f", data_interpolation->fixed_step_rotation);
+	ImGui::Text("velocity %.3f %.3f", data_interpolation->fixed_step_velocity.x, data_interpolation->fixed_step_velocity.y);
+	ImGui::Text("torque   %.3f", data_interpolation->fixed_step_torque);
+}
+
 void itu_debug_ui_render_physicsstaticdata(SDLContext* context, void* data)
 {
 	// nothing to show here at runtime
@@ -172,4 +206,279 @@ void itu_debug_ui_render_shapedata(SDLContext* context, void* data)
 		}
 }
 
+void itu_debug_ui_render_transformparent(SDLContext* context, void* data)
+{
+	TransformParent* data_parent = (TransformParent*)data;
+
+	itu_debug_ui_widget_entityid("parent", data_parent->parent);
+
+	ImGui::SeparatorText("local");
+	ImGui::PushID("local");
+	ImGui::DragFloat2("position", &data_parent->local.position.x);
+	ImGui::DragFloat2("scale", &data_parent->local.scale.x);
+
+	float rotation_deg = data_parent->local.rotation * RAD_2_DEG;
+	if(ImGui::DragFloat("rotation", &rotation_deg))
+		data_parent->local.rotation = rotation_deg * DEG_2_RAD;
+	ImGui::PopID();
+}
+
+// one bar per recorded frame (work at the bottom, wait on top, in red if it's a hitch),
+// with lines for the target frame time and the hitch threshold
+void itu_debug_ui_frame_stats_graph_render(ITU_FrameLoop* loop, float height)
+{
+	ImVec2 size = ImVec2(ImGui::GetContentRegionAvail().x, height);
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImGui::InvisibleButton("##debug_frame_stats_graph", size);
+	if(loop->history_count == 0)
+		return;
+
+	Uint64 frame_max = SDL_max(loop->hitch_threshold, loop->target_frame_ns);
+	for(int i = 0; i < loop->history_count; ++i)
+		frame_max = SDL_max(frame_max, itu_lib_loop_history_get(loop, i)->frame);
+
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	draw_list->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(0, 0, 0, 128));
+
+	float bar_w = size.x / ITU_LOOP_HISTORY_COUNT;
+	float scale = size.y / (float)frame_max;
+	float y_bottom = origin.y + size.y;
+	for(int i = 0; i < loop->history_count; ++i)
+	{
+		ITU_FrameStats* stats = itu_lib_loop_history_get(loop, i);
+		bool is_hitch = loop->hitch_threshold > 0 && stats->frame > loop->hitch_threshold;
+		float x = origin.x + (ITU_LOOP_HISTORY_COUNT - loop->history_count + i) * bar_w;
+		float y_work = y_bottom - stats->work * scale;
+		float y_frame = y_bottom - stats->frame * scale;
+		draw_list->AddRectFilled(ImVec2(x, y_work), ImVec2(x + bar_w, y_bottom), is_hitch ? IM_COL32(230, 60, 60, 255) : IM_COL32(90, 200, 90, 255));
+		draw_list->AddRectFilled(ImVec2(x, y_frame), ImVec2(x + bar_w, y_work), IM_COL32(128, 128, 128, 255));
+	}
+
+	float y_target = y_bottom - loop->target_frame_ns * scale;
+	float y_threshold = y_bottom - loop->hitch_threshold * scale;
+	draw_list->AddLine(ImVec2(origin.x, y_target), ImVec2(origin.x + size.x, y_target), IM_COL32(255, 255, 255, 160));
+	draw_list->AddLine(ImVec2(origin.x, y_threshold), ImVec2(origin.x + size.x, y_threshold), IM_COL32(230, 60, 60, 160));
+
+	if(ImGui::IsItemHovered() && ImGui::BeginTooltip())
+	{
+		int i = (int)((ImGui::GetIO().MousePos.x - origin.x) / bar_w) - (ITU_LOOP_HISTORY_COUNT - loop->history_count);
+		if(i >= 0 && i < loop->history_count)
+		{
+			ITU_FrameStats* stats = itu_lib_loop_history_get(loop, i);
+			ImGui::Text("frame %llu", (unsigned long long)stats->index);
+			ImGui::Text("%6.3f ms  total",   (float)stats->frame   / (float)MILLIS(1));
+			ImGui::Text("%6.3f ms  work",    (float)stats->work    / (float)MILLIS(1));
+			ImGui::Text("%6.3f ms  systems", (float)stats->systems / (float)MILLIS(1));
+			ImGui::Text("%6.3f ms  wait",    (float)stats->wait    / (float)MILLIS(1));
+			ImGui::Text("%6.3f ms  latency", (float)stats->latency / (float)MILLIS(1));
+			ImGui::Text("%6d     physics steps", stats->physics_steps);
+		}
+		ImGui::EndTooltip();
+	}
+}
+
+void itu_debug_ui_render_frame_stats(ITU_FrameLoop* loop)
+{
+	itu_debug_ui_frame_stats_graph_render(loop, 80);
+
+	if(ImGui::BeginTable("debug_frame_stats_percentiles", 5, ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("");
+		ImGui::TableSetupColumn("p50");
+		ImGui::TableSetupColumn("p95");
+		ImGui::TableSetupColumn("p99");
+		ImGui::TableSetupColumn("max");
+		ImGui::TableHeadersRow();
+
+		const char* names[] = { "total", "work", "systems", "wait", "latency" };
+		Uint64 ITU_FrameStats::* fields[] = { &ITU_FrameStats::frame, &ITU_FrameStats::work, &ITU_FrameStats::systems, &ITU_FrameStats::wait, &ITU_FrameStats::latency };
+		for(int i = 0; i < SDL_arraysize(fields); ++i)
+		{
+			ITU_FramePercentiles percentiles = itu_lib_loop_percentiles(loop, fields[i]);
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%s", names[i]);
+			ImGui::TableNextColumn(); ImGui::Text("%6.3f", percentiles.p50_ms);
+			ImGui::TableNextColumn(); ImGui::Text("%6.3f", percentiles.p95_ms);
+			ImGui::TableNextColumn(); ImGui::Text("%6.3f", percentiles.p99_ms);
+			ImGui::TableNextColumn(); ImGui::Text("%6.3f", percentiles.max_ms);
+		}
+		ImGui::EndTable();
+	}
+
+	if(ImGui::Button("export CSV##debug_frame_stats"))
+		itu_lib_loop_stats_export(loop, "frame_stats.csv", false);
+
+	ImGui::SeparatorText("hitches");
+	float threshold_ms = (float)loop->hitch_threshold / (float)MILLIS(1);
+	if(ImGui::DragFloat("threshold (ms)", &threshold_ms, 0.1f, 0, 1000))
+		loop->hitch_threshold = (Uint64)(SDL_max(threshold_ms, 0.0f) * MILLIS(1));
+	ImGui::Text("%llu hitches so far", (unsigned long long)loop->hitches_total);
+
+	if(loop->hitches_count > 0 && ImGui::BeginTable("debug_frame_stats_hitches", 6, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY, ImVec2(0, 120)))
+	{
+		ImGui::TableSetupColumn("frame");
+		ImGui::TableSetupColumn("total");
+		ImGui::TableSetupColumn("work");
+		ImGui::TableSetupColumn("systems");
+		ImGui::TableSetupColumn("wait");
+		ImGui::TableSetupColumn("physics");
+		ImGui::TableHeadersRow();
+
+		// most recent first
+		for(int i = loop->hitches_count - 1; i >= 0; --i)
+		{
+			ITU_FrameStats* stats = itu_lib_loop_hitch_get(loop, i);
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats->index);
+			ImGui::TableNextColumn(); ImGui::Text("%6.3f", (float)stats->frame   / (float)MILLIS(1));
+			ImGui::TableNextColumn(); ImGui::Text("%6.3f", (float)stats->work    / (float)MILLIS(1));
+			ImGui::TableNextColumn(); ImGui::Text("%6.3f", (float)stats->systems / (float)MILLIS(1));
+			ImGui::TableNextColumn(); ImGui::Text("%6.3f", (float)stats->wait    / (float)MILLIS(1));
+			ImGui::TableNextColumn(); ImGui::Text("%d", stats->physics_steps);
+		}
+		ImGui::EndTable();
+	}
+
+	if(ImGui::Button("export hitches CSV##debug_frame_stats"))
+		itu_lib_loop_stats_export(loop, "frame_hitches.csv", true);
+}
+
+// same name, same color (names are usually string literals, but not always)
+ImU32 itu_debug_ui_profiler_color(const char* name)
+{
+	Uint32 hash = 2166136261u;
+	for(const char* c = name; *c; ++c)
+		hash = (hash ^ (Uint8)*c) * 16777619u;
+	return ImColor::HSV((hash % 1024) / 1024.0f, 0.5f, 0.8f);
+}
+
+void itu_debug_ui_render_profiler()
+{
+#ifndef ITU_PROFILER_ENABLED
+	ImGui::TextWrapped("The profiler is compiled out. Define ITU_PROFILER_ENABLED before including itu_unity_include.hpp to enable it.");
+#else
+	bool paused = itu_profiler_is_paused();
+	if(ImGui::Checkbox("pause", &paused))
+		itu_profiler_set_paused(paused);
+	ImGui::SameLine();
+	if(ImGui::Button("export trace##debug_profiler"))
+		itu_profiler_export("profile_trace.json");
+
+	Uint64 frame_beg, frame_end;
+	if(!itu_profiler_frame_last(&frame_beg, &frame_end) || frame_end <= frame_beg)
+	{
+		ImGui::Text("no frames recorded yet");
+		return;
+	}
+	ImGui::Text("last frame: %6.3f ms", (float)(frame_end - frame_beg) / (float)MILLIS(1));
+
+	const float row_h = ImGui::GetTextLineHeight() + 2;
+	float width = ImGui::GetContentRegionAvail().x;
+	float scale = width / (float)(frame_end - frame_beg);
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+
+	for(int t = 0; t < itu_profiler_threads_count(); ++t)
+	{
+		ITU_ProfilerThread* thread = itu_profiler_thread_get(t);
+		if(!thread)
+			continue;
+
+		// events are stored in the order they ended, so we walk back until they end before the frame began
+		Uint32 head = SDL_GetAtomicU32(&thread->head);
+		Uint32 first = head > ITU_PROFILER_EVENTS_MAX - 1 ? head - (ITU_PROFILER_EVENTS_MAX - 1) : 0;
+		Uint32 oldest = head;
+		int depth_max = -1;
+		while(oldest > first)
+		{
+			ITU_ProfileEvent* event = &thread->events[(oldest - 1) & (ITU_PROFILER_EVENTS_MAX - 1)];
+			if(event->time_end < frame_beg)
+				break;
+			if(event->time_beg < frame_end)
+				depth_max = SDL_max(depth_max, event->depth);
+			--oldest;
+		}
+		if(depth_max < 0)
+			continue;
+
+		ImGui::SeparatorText(thread->name);
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		ImGui::PushID(t);
+		ImGui::InvisibleButton("##debug_profiler_thread", ImVec2(width, row_h * (depth_max + 1)));
+		ImGui::PopID();
+		bool hovered = ImGui::IsItemHovered();
+		ImVec2 mouse = ImGui::GetIO().MousePos;
+
+		for(Uint32 e = oldest; e < head; ++e)
+		{
+			ITU_ProfileEvent* event = &thread->events[e & (ITU_PROFILER_EVENTS_MAX - 1)];
+			if(event->time_beg >= frame_end)
+				continue;
+
+			float x0 = origin.x + (float)((Sint64)event->time_beg - (Sint64)frame_beg) * scale;
+			float x1 = origin.x + (float)((Sint64)event->time_end - (Sint64)frame_beg) * scale;
+			x0 = SDL_max(x0, origin.x);
+			x1 = SDL_min(SDL_max(x1, x0 + 1), origin.x + width);
+			float y0 = origin.y + event->depth * row_h;
+			ImVec2 p0 = ImVec2(x0, y0);
+			ImVec2 p1 = ImVec2(x1, y0 + row_h - 1);
+
+			draw_list->AddRectFilled(p0, p1, itu_debug_ui_profiler_color(event->name));
+			if(x1 - x0 > ImGui::CalcTextSize(event->name).x + 4)
+				draw_list->AddText(ImVec2(x0 + 2, y0 + 1), IM_COL32(0, 0, 0, 255), event->name);
+
+			if(hovered && mouse.x >= p0.x && mouse.x < p1.x && mouse.y >= p0.y && mouse.y < p1.y && ImGui::BeginTooltip())
+			{
+				ImGui::Text("%s", event->name);
+				ImGui::Text("%6.3f ms", (float)(event->time_end - event->time_beg) / (float)MILLIS(1));
+				ImGui::EndTooltip();
+			}
+		}
+	}
+#endif
+}
+
+float itu_debug_ui_memory_allocs_get(void* data, int idx)
+{
+	return (float)itu_memory_tracker_history_get(idx).allocs;
+}
+
+void itu_debug_ui_render_memory()
+{
+	if(!itu_memory_tracker_is_installed())
+	{
+		ImGui::TextWrapped("The memory tracker is not installed. Call itu_memory_tracker_install() first thing in main, and define ITU_MEMORY_TRACKING_ENABLED to get tags and per-frame stats.");
+		return;
+	}
+
+	ITU_MemoryStats stats = itu_memory_tracker_stats();
+	ImGui::LabelText("live", "%.1f KB (%" SDL_PRIu64 " allocations)", (float)stats.total.live_bytes / KB(1), stats.total.live_count);
+	ImGui::LabelText("peak", "%.1f KB", (float)stats.total.peak_bytes / KB(1));
+	ImGui::LabelText("last frame", "%u allocs, %u frees, %.1f KB", stats.frame_last.allocs, stats.frame_last.frees, (float)stats.frame_last.bytes_allocated / KB(1));
+	ImGui::PlotHistogram("##debug_memory_allocs", itu_debug_ui_memory_allocs_get, NULL, itu_memory_tracker_history_count(), 0, "allocs per frame", 0, FLT_MAX, ImVec2(ImGui::GetContentRegionAvail().x, 60));
+
+	if(ImGui::BeginTable("##debug_memory_tags", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+	{
+		ImGui::TableSetupColumn("tag");
+		ImGui::TableSetupColumn("live KB");
+		ImGui::TableSetupColumn("count");
+		ImGui::TableSetupColumn("peak KB");
+		ImGui::TableSetupColumn("allocs total");
+		ImGui::TableHeadersRow();
+		for(int i = 0; i < ITU_MEMORY_TAG_MAX; ++i)
+		{
+			ITU_MemoryTagStats* tag = &stats.tags[i];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%s", itu_memory_tag_names[i]);
+			ImGui::TableNextColumn(); ImGui::Text("%.1f", (float)tag->live_bytes / KB(1));
+			ImGui::TableNextColumn(); ImGui::Text("%" SDL_PRIu64, tag->live_count);
+			ImGui::TableNextColumn(); ImGui::Text("%.1f", (float)tag->peak_bytes / KB(1));
+			ImGui::TableNextColumn(); ImGui::Text("%" SDL_PRIu64, tag->allocs_total);
+		}
+		ImGui::EndTable();
+	}
+
+	if(ImGui::Button("log live allocations##debug_memory"))
+		itu_memory_tracker_report_leaks();
+}
+
 #endif // (defined ITU_LIB_DEBUG_UI_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
\ No newline at end of file
@@ -11,6 +11,9 @@
 #include <stb_ds.h>
 #include <stb_image.h>
 #include <itu_common.hpp>
+#include <itu_lib_memory.hpp>
+#include <itu_lib_profiler.hpp>
+#include <itu_lib_arena.hpp>
 #include <imgui/imgui.h>
 #endif
 
@@ -71,8 +74,6 @@ struct SDLContext
 	float uptime;   // in seconds
 
 	SDL_Time elapsed_frame; // high precision timer
-	SDL_Time accumulator_physics;
-	int physics_steps_count;
 
 	Camera* camera_active;
 	Camera camera_default; // default camera
@@ -112,6 +113,10 @@ struct SDLContext
 	stbds_hm(SDL_Keycode, BtnType) mappings_keyboard;
 	stbds_hm(Uint8, BtnType)       mappings_mouse;
 
+	// memory valid until the end of the current frame (the main loop resets it after present)
+	// NOTE: main thread only, code running in jobs should use scratch arenas (see `itu_arena_scratch_begin`)
+	ITU_Arena arena_frame;
+
 	bool debug_ui_show;
 };
 
@@ -366,6 +371,7 @@ bool sdl_process_events(SDLContext* context)
 
 SDL_Texture* texture_create(SDLContext* context, const char* path, SDL_ScaleMode mode)
 {
+	ITU_PROFILE_SCOPE("texture_create");
 	// texture could accept which pixel format it has as parameter, but this for now seems good enough
 	const SDL_PixelFormat pixel_format = SDL_PIXELFORMAT_RGBA32;
 
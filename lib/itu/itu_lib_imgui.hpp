@@ -16,10 +16,25 @@ bool itu_lib_imgui_process_sdl_event(SDL_Event* event);
 void itu_lib_imgui_frame_begin();
 void itu_lib_imgui_frame_end(SDLContext* context);
 
+inline void* itu_lib_imgui_alloc(size_t size, void* user_data)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_UI);
+	return SDL_malloc(size);
+}
+
+inline void itu_lib_imgui_free(void* ptr, void* user_data)
+{
+	SDL_free(ptr);
+}
+
 inline void itu_lib_imgui_setup(SDL_Window* window, SDLContext* context, bool intercept_keyboard)
 {
 	IMGUI_CHECKVERSION();
 
+	// route imgui through SDL, so that the memory tracker sees it
+	if(itu_memory_tracker_is_installed())
+		ImGui::SetAllocatorFunctions(itu_lib_imgui_alloc, itu_lib_imgui_free);
+
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO();
 
@@ -61,6 +76,7 @@ inline bool itu_lib_imgui_process_sdl_event(SDL_Event* event)
 
 inline void itu_lib_imgui_frame_begin()
 {
+	ITU_PROFILE_SCOPE("imgui_frame_begin");
 	ImGui_ImplSDLRenderer3_NewFrame();
 	ImGui_ImplSDL3_NewFrame();
 	ImGui::NewFrame();
@@ -68,6 +84,7 @@ inline void itu_lib_imgui_frame_begin()
 
 inline void itu_lib_imgui_frame_end(SDLContext* context)
 {
+	ITU_PROFILE_SCOPE("imgui_render");
 	ImGuiIO& io = ImGui::GetIO();
 
 	// NOTE: imgui HAS to render at whatever resolution it desires, otherwise input will be messed up
@@ -0,0 +1,218 @@
+#ifndef ITU_LIB_JOBS_HPP
+#define ITU_LIB_JOBS_HPP
+
+#ifndef ITU_UNITY_BUILD
+#include <SDL3/SDL.h>
+#include <itu_common.hpp>
+#include <itu_lib_profiler.hpp>
+#include <itu_lib_arena.hpp>
+#endif
+
+// minimal worker pool: a fixed number of SDL threads popping jobs from a single shared queue.
+// The main thread pushes jobs, and then helps executing them while waiting for all of them to be done
+// NOTE: jobs must not push other jobs
+
+#define ITU_JOBS_WORKERS_MAX 16
+#define ITU_JOBS_QUEUE_MAX   1024
+
+typedef void (*ITU_JobFunction)(void* data);
+
+// `workers_count`: number of worker threads (main thread excluded). Use 0 to use all available cores
+void itu_lib_jobs_init(int workers_count);
+void itu_lib_jobs_deinit();
+bool itu_lib_jobs_is_initialized();
+int  itu_lib_jobs_workers_count();
+
+// 0 for the main thread (or any thread that is not a worker), [1, workers_count] for worker threads
+int  itu_lib_jobs_thread_index();
+
+// NOTE: if the queue already holds `ITU_JOBS_QUEUE_MAX` jobs, `fn` runs right away on the calling thread
+void itu_lib_jobs_push(ITU_JobFunction fn, void* data);
+void itu_lib_jobs_wait_all();
+
+#endif // ITU_LIB_JOBS_HPP
+
+#if (defined ITU_LIB_JOBS_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
+
+#include <SDL3/SDL.h>
+
+struct ITU_Job
+{
+	ITU_JobFunction fn;
+	void* data;
+};
+
+struct ITU_JobsContext
+{
+	SDL_Thread* workers[ITU_JOBS_WORKERS_MAX];
+	int workers_count;
+
+	// ring buffer
+	ITU_Job queue[ITU_JOBS_QUEUE_MAX];
+	int queue_head;
+	int queue_count;
+
+	int jobs_pending; // queued + currently running
+	bool quit;
+
+	SDL_Mutex*     mutex;
+	SDL_Condition* cond_work; // signaled when a job is pushed (or when quitting)
+	SDL_Condition* cond_done; // signaled when `jobs_pending` reaches 0
+};
+
+static ITU_JobsContext ctx_jobs;
+static thread_local int jobs_thread_index;
+
+// NOTE: must be called with `ctx_jobs.mutex` locked
+bool itu_lib_jobs_pop_locked(ITU_Job* out_job)
+{
+	if(ctx_jobs.queue_count == 0)
+		return false;
+
+	*out_job = ctx_jobs.queue[ctx_jobs.queue_head];
+	ctx_jobs.queue_head = (ctx_jobs.queue_head + 1) % ITU_JOBS_QUEUE_MAX;
+	ctx_jobs.queue_count--;
+	return true;
+}
+
+// runs the job with the mutex unlocked, and marks it as done
+// NOTE: must be called with `ctx_jobs.mutex` locked
+void itu_lib_jobs_run_locked(ITU_Job* job)
+{
+	SDL_UnlockMutex(ctx_jobs.mutex);
+	job->fn(job->data);
+	SDL_LockMutex(ctx_jobs.mutex);
+
+	ctx_jobs.jobs_pending--;
+	if(ctx_jobs.jobs_pending == 0)
+		SDL_BroadcastCondition(ctx_jobs.cond_done);
+}
+
+int itu_lib_jobs_worker_main(void* data)
+{
+	jobs_thread_index = (int)(intptr_t)data;
+
+#ifdef ITU_PROFILER_ENABLED
+	char name[32];
+	SDL_snprintf(name, 32, "itu_worker_%02d", jobs_thread_index - 1);
+	ITU_PROFILE_THREAD_NAME(name);
+#endif
+
+	SDL_LockMutex(ctx_jobs.mutex);
+	while(true)
+	{
+		ITU_Job job;
+		while(!ctx_jobs.quit && !itu_lib_jobs_pop_locked(&job))
+			SDL_WaitCondition(ctx_jobs.cond_work, ctx_jobs.mutex);
+
+		if(ctx_jobs.quit)
+			break;
+
+		itu_lib_jobs_run_locked(&job);
+	}
+	SDL_UnlockMutex(ctx_jobs.mutex);
+
+	// jobs may have used scratch memory
+	itu_arena_scratch_thread_deinit();
+	return 0;
+}
+
+void itu_lib_jobs_init(int workers_count)
+{
+	SDL_assert(!itu_lib_jobs_is_initialized());
+
+	if(workers_count <= 0)
+		workers_count = SDL_GetNumLogicalCPUCores() - 1;
+	workers_count = SDL_clamp(workers_count, 0, ITU_JOBS_WORKERS_MAX);
+
+	SDL_memset(&ctx_jobs, 0, sizeof(ctx_jobs));
+	ctx_jobs.mutex = SDL_CreateMutex();
+	ctx_jobs.cond_work = SDL_CreateCondition();
+	ctx_jobs.cond_done = SDL_CreateCondition();
+
+	for(int i = 0; i < workers_count; ++i)
+	{
+		char name[32];
+		SDL_snprintf(name, 32, "itu_worker_%02d", i);
+		ctx_jobs.workers[i] = SDL_CreateThread(itu_lib_jobs_worker_main, name, (void*)(intptr_t)(i + 1));
+		VALIDATE_PANIC(ctx_jobs.workers[i]);
+	}
+	ctx_jobs.workers_count = workers_count;
+}
+
+void itu_lib_jobs_deinit()
+{
+	if(!itu_lib_jobs_is_initialized())
+		return;
+
+	itu_lib_jobs_wait_all();
+
+	SDL_LockMutex(ctx_jobs.mutex);
+	ctx_jobs.quit = true;
+	SDL_BroadcastCondition(ctx_jobs.cond_work);
+	SDL_UnlockMutex(ctx_jobs.mutex);
+
+	for(int i = 0; i < ctx_jobs.workers_count; ++i)
+		SDL_WaitThread(ctx_jobs.workers[i], NULL);
+
+	SDL_DestroyCondition(ctx_jobs.cond_done);
+	SDL_DestroyCondition(ctx_jobs.cond_work);
+	SDL_DestroyMutex(ctx_jobs.mutex);
+	SDL_memset(&ctx_jobs, 0, sizeof(ctx_jobs));
+}
+
+bool itu_lib_jobs_is_initialized()
+{
+	return ctx_jobs.mutex != NULL;
+}
+
+int itu_lib_jobs_workers_count()
+{
+	return ctx_jobs.workers_count;
+}
+
+int itu_lib_jobs_thread_index()
+{
+	return jobs_thread_index;
+}
+
+void itu_lib_jobs_push(ITU_JobFunction fn, void* data)
+{
+	SDL_assert(itu_lib_jobs_is_initialized());
+
+	SDL_LockMutex(ctx_jobs.mutex);
+	if(ctx_jobs.queue_count == ITU_JOBS_QUEUE_MAX)
+	{
+		// queue full: the workers have plenty to do already, run the job on the calling thread
+		SDL_UnlockMutex(ctx_jobs.mutex);
+		fn(data);
+		return;
+	}
+
+	int loc = (ctx_jobs.queue_head + ctx_jobs.queue_count) % ITU_JOBS_QUEUE_MAX;
+	ctx_jobs.queue[loc] = { fn, data };
+	ctx_jobs.queue_count++;
+	ctx_jobs.jobs_pending++;
+
+	SDL_SignalCondition(ctx_jobs.cond_work);
+	SDL_UnlockMutex(ctx_jobs.mutex);
+}
+
+// blocks until all pushed jobs are done. The calling thread executes queued jobs in the meantime
+// (so this works even with 0 workers)
+void itu_lib_jobs_wait_all()
+{
+	ITU_PROFILE_SCOPE("jobs_wait_all");
+	SDL_LockMutex(ctx_jobs.mutex);
+	while(ctx_jobs.jobs_pending > 0)
+	{
+		ITU_Job job;
+		if(itu_lib_jobs_pop_locked(&job))
+			itu_lib_jobs_run_locked(&job);
+		else
+			SDL_WaitCondition(ctx_jobs.cond_done, ctx_jobs.mutex);
+	}
+	SDL_UnlockMutex(ctx_jobs.mutex);
+}
+
+#endif // ITU_LIB_JOBS_IMPLEMENTATION
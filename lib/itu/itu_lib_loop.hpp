@@ -0,0 +1,358 @@
+// frame pacing for the main loop
+// Usage:
+//     ITU_FrameLoop loop;
+//     itu_lib_loop_init(&loop, renderer, TARGET_FRAMERATE_NS, ITU_LOOP_PACING_HYBRID);
+//     while(!quit)
+//     {
+//         itu_lib_loop_frame_begin(&loop);  // right before polling input
+//         ...
+//         itu_lib_loop_frame_end(&loop);    // waits and presents (call it instead of `SDL_RenderPresent`)
+//         context.delta = loop.delta;
+//     }
+//
+// All times come from `SDL_GetTicksNS`, that is monotonic (`SDL_GetCurrentTime` is wall clock time, and can jump).
+// NOTE: this only depends on SDL, so it can be used by the exercises that don't use `SDLContext`
+
+#ifndef ITU_LIB_LOOP_HPP
+#define ITU_LIB_LOOP_HPP
+
+#ifndef ITU_UNITY_BUILD
+#include <SDL3/SDL.h>
+#include <itu_common.hpp>
+#include <itu_lib_memory.hpp>
+#include <itu_lib_profiler.hpp>
+#endif
+
+// the OS never wakes us up exactly on time, so we sleep until a bit before the deadline and spin for the rest.
+// This is the minimum amount we spin for (on top of the measured oversleep, see `sleep_overshoot`)
+#define ITU_LOOP_SPIN_MIN_NS        MICROS(200)
+#define ITU_LOOP_CALIBRATION_SLEEPS 8
+
+#define ITU_LOOP_HISTORY_COUNT 256 // frames kept for statistics (see `ITU_FrameStats`)
+#define ITU_LOOP_HITCHES_COUNT 32  // hitches kept (the most recent ones)
+
+enum ITU_LoopPacing
+{
+	ITU_LOOP_PACING_HYBRID,   // sleep, then spin until `target_frame_ns` is elapsed
+	ITU_LOOP_PACING_VSYNC,    // `SDL_RenderPresent` waits for vsync, `target_frame_ns` is the refresh rate of the display
+	ITU_LOOP_PACING_UNLOCKED, // no waiting at all (benchmarking)
+
+	ITU_LOOP_PACING_MAX
+};
+
+// timings of a single frame
+struct ITU_FrameStats
+{
+	Uint64 index;         // `frames_count` when the frame ended
+	Uint64 work;
+	Uint64 wait;
+	Uint64 frame;
+	Uint64 latency;
+	Uint64 systems;       // reported by the game (see `itu_lib_loop_frame_report`), 0 if not
+	int    physics_steps; // reported by the game (see `itu_lib_loop_frame_report`), 0 if not
+};
+
+struct ITU_FramePercentiles
+{
+	float p50_ms;
+	float p95_ms;
+	float p99_ms;
+	float max_ms;
+};
+
+struct ITU_FrameLoop
+{
+	SDL_Renderer*  renderer;
+	ITU_LoopPacing pacing;
+	Uint64         target_frame_ns;
+
+	Uint64 time_frame_beg;  // right after the previous present
+	Uint64 time_input;      // when input was sampled for the current frame
+	Uint64 time_deadline;   // when the current frame is supposed to be presented (HYBRID)
+	Uint64 sleep_overshoot; // how much later than asked the OS usually wakes us up (calibrated while running)
+
+	// last frame
+	Uint64 elapsed_work;     // from frame begin to `itu_lib_loop_frame_end`
+	Uint64 elapsed_wait;     // time spent sleeping/spinning
+	Uint64 elapsed_frame;    // from present to present
+	Sint64 deadline_error;   // how late the wait ended (HYBRID)
+	Uint64 latency_input;    // from input sampling to the end of present
+
+	float  delta;            // `elapsed_frame`, in seconds
+	double uptime;           // in seconds
+	Uint64 frames_count;
+
+	// statistics
+	ITU_FrameStats current;                         // filled during the frame, recorded by `itu_lib_loop_frame_end`
+	ITU_FrameStats history[ITU_LOOP_HISTORY_COUNT]; // ring buffer, see `itu_lib_loop_history_get`
+	int            history_next;
+	int            history_count;
+
+	// hitch detector: frames longer than `hitch_threshold` are logged and kept in `hitches` (ring buffer)
+	Uint64         hitch_threshold; // defaults to 1.5 times the target frame time (and follows it, until changed)
+	ITU_FrameStats hitches[ITU_LOOP_HITCHES_COUNT];
+	int            hitches_next;
+	int            hitches_count;
+	Uint64         hitches_total;
+};
+
+void itu_lib_loop_init(ITU_FrameLoop* loop, SDL_Renderer* renderer, Uint64 target_frame_ns, ITU_LoopPacing pacing);
+void itu_lib_loop_set_pacing(ITU_FrameLoop* loop, ITU_LoopPacing pacing);
+void itu_lib_loop_frame_begin(ITU_FrameLoop* loop);
+bool itu_lib_loop_frame_end(ITU_FrameLoop* loop);
+void itu_lib_loop_wait_until(ITU_FrameLoop* loop, Uint64 time_target);
+
+// statistics
+void                 itu_lib_loop_frame_report(ITU_FrameLoop* loop, Uint64 systems, int physics_steps);
+ITU_FrameStats*      itu_lib_loop_history_get(ITU_FrameLoop* loop, int i);
+ITU_FrameStats*      itu_lib_loop_hitch_get(ITU_FrameLoop* loop, int i);
+ITU_FramePercentiles itu_lib_loop_percentiles(ITU_FrameLoop* loop, Uint64 ITU_FrameStats::* field);
+bool                 itu_lib_loop_stats_export(ITU_FrameLoop* loop, const char* path, bool hitches_only);
+
+extern const char* itu_lib_loop_pacing_names[ITU_LOOP_PACING_MAX];
+
+#endif // ITU_LIB_LOOP_HPP
+
+#if (defined ITU_LIB_LOOP_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
+
+const char* itu_lib_loop_pacing_names[ITU_LOOP_PACING_MAX] = { "hybrid", "vsync", "unlocked" };
+
+// keeps track of the worst recent oversleep: grows immediately, shrinks slowly
+void itu_lib_loop_sleep_overshoot_sample(ITU_FrameLoop* loop, Sint64 overshoot)
+{
+	Uint64 sample = overshoot > 0 ? (Uint64)overshoot : 0;
+	if(sample > loop->sleep_overshoot)
+		loop->sleep_overshoot = sample;
+	else
+		loop->sleep_overshoot -= (loop->sleep_overshoot - sample) / 32;
+}
+
+// sleeps until `time_target` minus the margin we need to wake up in time, then spins for the rest
+void itu_lib_loop_wait_until(ITU_FrameLoop* loop, Uint64 time_target)
+{
+	Uint64 now = SDL_GetTicksNS();
+	Uint64 margin = loop->sleep_overshoot + ITU_LOOP_SPIN_MIN_NS;
+	if(time_target > now + margin)
+	{
+		Uint64 sleep = time_target - now - margin;
+		SDL_DelayNS(sleep);
+		Uint64 after = SDL_GetTicksNS();
+		itu_lib_loop_sleep_overshoot_sample(loop, (Sint64)(after - now) - (Sint64)sleep);
+		now = after;
+	}
+
+	while(now < time_target)
+	{
+		SDL_CPUPauseInstruction();
+		now = SDL_GetTicksNS();
+	}
+}
+
+// applies the pacing mode to the renderer. For VSYNC, the target frame time becomes the refresh rate of the display
+// (if we can get it), so that `deadline_error` and frame time stats keep making sense.
+// `hitch_threshold` follows the new target, unless it was changed from its default
+void itu_lib_loop_set_pacing(ITU_FrameLoop* loop, ITU_LoopPacing pacing)
+{
+	bool hitch_threshold_default = loop->hitch_threshold == loop->target_frame_ns * 3 / 2;
+	loop->pacing = pacing;
+	if(loop->renderer)
+		SDL_SetRenderVSync(loop->renderer, pacing == ITU_LOOP_PACING_VSYNC ? 1 : SDL_RENDERER_VSYNC_DISABLED);
+
+	if(pacing == ITU_LOOP_PACING_VSYNC && loop->renderer)
+	{
+		SDL_DisplayID display = SDL_GetDisplayForWindow(SDL_GetRenderWindow(loop->renderer));
+		const SDL_DisplayMode* mode = display ? SDL_GetCurrentDisplayMode(display) : NULL;
+		if(mode && mode->refresh_rate > 0)
+			loop->target_frame_ns = (Uint64)(SECONDS(1) / mode->refresh_rate);
+	}
+	if(hitch_threshold_default)
+		loop->hitch_threshold = loop->target_frame_ns * 3 / 2;
+
+	loop->time_deadline = SDL_GetTicksNS();
+}
+
+void itu_lib_loop_init(ITU_FrameLoop* loop, SDL_Renderer* renderer, Uint64 target_frame_ns, ITU_LoopPacing pacing)
+{
+	SDL_memset(loop, 0, sizeof(*loop));
+	loop->renderer = renderer;
+	ITU_PROFILE_THREAD_NAME("main");
+	loop->target_frame_ns = target_frame_ns;
+
+	// initial guess of how much the OS oversleeps (it keeps being updated while running)
+	for(int i = 0; i < ITU_LOOP_CALIBRATION_SLEEPS; ++i)
+	{
+		Uint64 before = SDL_GetTicksNS();
+		SDL_DelayNS(MILLIS(1));
+		itu_lib_loop_sleep_overshoot_sample(loop, (Sint64)(SDL_GetTicksNS() - before) - (Sint64)MILLIS(1));
+	}
+
+	itu_lib_loop_set_pacing(loop, pacing);
+	loop->hitch_threshold = loop->target_frame_ns * 3 / 2;
+	loop->time_frame_beg = SDL_GetTicksNS();
+	loop->time_input = loop->time_frame_beg;
+	loop->time_deadline = loop->time_frame_beg;
+}
+
+// call right before polling events, so that `latency_input` measures from when input was sampled
+void itu_lib_loop_frame_begin(ITU_FrameLoop* loop)
+{
+	loop->time_input = SDL_GetTicksNS();
+}
+
+// optional, adds the time spent in systems and the number of physics steps to the stats of the current frame
+void itu_lib_loop_frame_report(ITU_FrameLoop* loop, Uint64 systems, int physics_steps)
+{
+	loop->current.systems = systems;
+	loop->current.physics_steps = physics_steps;
+}
+
+// i-th oldest recorded frame (`0 <= i < history_count`)
+ITU_FrameStats* itu_lib_loop_history_get(ITU_FrameLoop* loop, int i)
+{
+	SDL_assert(i >= 0 && i < loop->history_count);
+	int oldest = loop->history_next - loop->history_count;
+	return &loop->history[(oldest + i + ITU_LOOP_HISTORY_COUNT) % ITU_LOOP_HISTORY_COUNT];
+}
+
+// i-th oldest recorded hitch (`0 <= i < hitches_count`)
+ITU_FrameStats* itu_lib_loop_hitch_get(ITU_FrameLoop* loop, int i)
+{
+	SDL_assert(i >= 0 && i < loop->hitches_count);
+	int oldest = loop->hitches_next - loop->hitches_count;
+	return &loop->hitches[(oldest + i + ITU_LOOP_HITCHES_COUNT) % ITU_LOOP_HITCHES_COUNT];
+}
+
+int itu_lib_loop_compare_u64(const void* a, const void* b)
+{
+	Uint64 va = *(const Uint64*)a;
+	Uint64 vb = *(const Uint64*)b;
+	return va < vb ? -1 : va > vb;
+}
+
+// percentiles of one of the timings over the recorded history (ie `itu_lib_loop_percentiles(loop, &ITU_FrameStats::frame)`)
+ITU_FramePercentiles itu_lib_loop_percentiles(ITU_FrameLoop* loop, Uint64 ITU_FrameStats::* field)
+{
+	ITU_FramePercentiles ret = { };
+	int count = loop->history_count;
+	if(count == 0)
+		return ret;
+
+	Uint64 sorted[ITU_LOOP_HISTORY_COUNT];
+	for(int i = 0; i < count; ++i)
+		sorted[i] = itu_lib_loop_history_get(loop, i)->*field;
+	SDL_qsort(sorted, count, sizeof(Uint64), itu_lib_loop_compare_u64);
+
+	ret.p50_ms = (float)sorted[(count - 1) * 50 / 100] / (float)MILLIS(1);
+	ret.p95_ms = (float)sorted[(count - 1) * 95 / 100] / (float)MILLIS(1);
+	ret.p99_ms = (float)sorted[(count - 1) * 99 / 100] / (float)MILLIS(1);
+	ret.max_ms = (float)sorted[count - 1] / (float)MILLIS(1);
+	return ret;
+}
+
+// writes the recorded frames (or only the hitches) as CSV, oldest first, times in milliseconds
+bool itu_lib_loop_stats_export(ITU_FrameLoop* loop, const char* path, bool hitches_only)
+{
+	SDL_IOStream* stream = SDL_IOFromFile(path, "w");
+	if(!stream)
+	{
+		SDL_Log("ERROR could not open '%s': %s\n", path, SDL_GetError());
+		return false;
+	}
+
+	SDL_IOprintf(stream, "frame,work,wait,total,latency,systems,physics_steps,hitch\n");
+	int count = hitches_only ? loop->hitches_count : loop->history_count;
+	for(int i = 0; i < count; ++i)
+	{
+		ITU_FrameStats* stats = hitches_only ? itu_lib_loop_hitch_get(loop, i) : itu_lib_loop_history_get(loop, i);
+		SDL_IOprintf(stream, "%llu,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%d\n",
+			(unsigned long long)stats->index,
+			(float)stats->work    / (float)MILLIS(1),
+			(float)stats->wait    / (float)MILLIS(1),
+			(float)stats->frame   / (float)MILLIS(1),
+			(float)stats->latency / (float)MILLIS(1),
+			(float)stats->systems / (float)MILLIS(1),
+			stats->physics_steps,
+			stats->frame > loop->hitch_threshold
+		);
+	}
+
+	return SDL_CloseIO(stream);
+}
+
+// waits (depending on the pacing mode), presents, and updates the timings of the frame that just ended.
+// Returns true if the frame was a hitch (longer than `hitch_threshold`)
+bool itu_lib_loop_frame_end(ITU_FrameLoop* loop)
+{
+	Uint64 time_work_end = SDL_GetTicksNS();
+	loop->elapsed_work = time_work_end - loop->time_frame_beg;
+
+	loop->deadline_error = 0;
+	if(loop->pacing == ITU_LOOP_PACING_HYBRID)
+	{
+		// deadlines are spaced by exactly `target_frame_ns`, so that the time spent presenting doesn't accumulate.
+		// If we missed one, we start again from now instead of trying to catch up with shorter frames
+		loop->time_deadline += loop->target_frame_ns;
+		if(loop->time_deadline < time_work_end)
+			loop->time_deadline = time_work_end;
+
+		ITU_PROFILE_SCOPE("frame_wait");
+		itu_lib_loop_wait_until(loop, loop->time_deadline);
+		loop->deadline_error = (Sint64)(SDL_GetTicksNS() - loop->time_deadline);
+	}
+	Uint64 time_wait_end = SDL_GetTicksNS();
+	loop->elapsed_wait = time_wait_end - time_work_end;
+
+	if(loop->renderer)
+	{
+		ITU_PROFILE_SCOPE("present");
+		SDL_RenderPresent(loop->renderer);
+	}
+	ITU_PROFILE_FRAME_MARK();
+	ITU_MEMORY_FRAME_MARK();
+
+	Uint64 time_present_end = SDL_GetTicksNS();
+	loop->elapsed_frame = time_present_end - loop->time_frame_beg;
+	loop->latency_input = time_present_end - loop->time_input;
+	loop->delta = (float)loop->elapsed_frame / (float)SECONDS(1);
+	loop->uptime += (double)loop->elapsed_frame / (double)SECONDS(1);
+	loop->frames_count++;
+
+	loop->time_frame_beg = time_present_end;
+
+	// statistics
+	ITU_FrameStats* stats = &loop->current;
+	stats->index = loop->frames_count;
+	stats->work = loop->elapsed_work;
+	stats->wait = loop->elapsed_wait;
+	stats->frame = loop->elapsed_frame;
+	stats->latency = loop->latency_input;
+
+	loop->history[loop->history_next] = *stats;
+	loop->history_next = (loop->history_next + 1) % ITU_LOOP_HISTORY_COUNT;
+	loop->history_count = SDL_min(loop->history_count + 1, ITU_LOOP_HISTORY_COUNT);
+
+	// NOTE: the first frame includes all the initialization, so it's always a hitch
+	bool is_hitch = loop->hitch_threshold > 0 && stats->frame > loop->hitch_threshold && loop->frames_count > 1;
+	if(is_hitch)
+	{
+		loop->hitches[loop->hitches_next] = *stats;
+		loop->hitches_next = (loop->hitches_next + 1) % ITU_LOOP_HITCHES_COUNT;
+		loop->hitches_count = SDL_min(loop->hitches_count + 1, ITU_LOOP_HITCHES_COUNT);
+		loop->hitches_total++;
+
+		SDL_Log("HITCH frame %llu: %.3f ms (work %.3f ms, systems %.3f ms, physics steps %d, wait %.3f ms, latency %.3f ms)\n",
+			(unsigned long long)stats->index,
+			(float)stats->frame   / (float)MILLIS(1),
+			(float)stats->work    / (float)MILLIS(1),
+			(float)stats->systems / (float)MILLIS(1),
+			stats->physics_steps,
+			(float)stats->wait    / (float)MILLIS(1),
+			(float)stats->latency / (float)MILLIS(1)
+		);
+	}
+
+	SDL_memset(&loop->current, 0, sizeof(loop->current));
+	return is_hitch;
+}
+
+#endif // ITU_LIB_LOOP_IMPLEMENTATION
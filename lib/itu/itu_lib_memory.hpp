@@ -0,0 +1,365 @@
+// allocation tracker
+// Installs itself as SDL's allocator (`SDL_SetMemoryFunctions`), so it sees everything going through `SDL_malloc` & co:
+// our own code, stb_ds containers (routed through SDL in `itu_unity_include.hpp`), SDL and its satellite libraries,
+// box2d and imgui (routed through SDL by `itu_sys_physics_init` and `itu_lib_imgui_setup` once the tracker is installed).
+// Every allocation gets a small header with its size and the tag (subsystem) active on the calling thread when it was made,
+// which gives us live bytes and peak per tag, allocator calls per frame, and the list of everything still alive on exit.
+//
+// Opt-in: tag scopes and frame marks are compiled out unless `ITU_MEMORY_TRACKING_ENABLED` is defined
+// (before including this file or `itu_unity_include.hpp`), and nothing is tracked until `itu_memory_tracker_install` is called.
+// NOTE: `itu_memory_tracker_install` must be called before anything is allocated through SDL (ie first thing in `main`):
+//       memory allocated before that has no header, so the tracker can't free it
+
+#ifndef ITU_LIB_MEMORY_HPP
+#define ITU_LIB_MEMORY_HPP
+
+#ifndef ITU_UNITY_BUILD
+#include <SDL3/SDL.h>
+#include <itu_common.hpp>
+#endif
+
+#define ITU_MEMORY_HISTORY_COUNT    256 // frames kept in the history (see `itu_memory_tracker_history_get`)
+#define ITU_MEMORY_LEAKS_LOGGED_MAX 32  // single allocations listed by `itu_memory_tracker_report_leaks`
+
+enum ITU_MemoryTag
+{
+	ITU_MEMORY_TAG_GENERAL,   // anything not tagged (game code, SDL internals)
+	ITU_MEMORY_TAG_ECS,
+	ITU_MEMORY_TAG_RESOURCES,
+	ITU_MEMORY_TAG_PHYSICS,
+	ITU_MEMORY_TAG_UI,
+	ITU_MEMORY_TAG_ARENAS,
+
+	ITU_MEMORY_TAG_MAX
+};
+extern const char* itu_memory_tag_names[ITU_MEMORY_TAG_MAX];
+
+struct ITU_MemoryTagStats
+{
+	Uint64 live_bytes;
+	Uint64 live_count;
+	Uint64 peak_bytes;
+	Uint64 allocs_total;
+};
+
+// allocator calls made during a frame (a realloc counts as both an allocation and a free)
+struct ITU_MemoryFrameStats
+{
+	Uint32 allocs;
+	Uint32 frees;
+	Uint64 bytes_allocated;
+};
+
+struct ITU_MemoryStats
+{
+	ITU_MemoryTagStats   tags[ITU_MEMORY_TAG_MAX];
+	ITU_MemoryTagStats   total;
+	ITU_MemoryFrameStats frame_last;
+	Uint64               frames_count;
+};
+
+#ifdef ITU_MEMORY_TRACKING_ENABLED
+
+struct ITU_MemoryTagScope
+{
+	ITU_MemoryTag tag_prev;
+
+	ITU_MemoryTagScope(ITU_MemoryTag tag);
+	~ITU_MemoryTagScope();
+};
+
+#define ITU_MEMORY_CONCAT_(a, b) a##b
+#define ITU_MEMORY_CONCAT(a, b)  ITU_MEMORY_CONCAT_(a, b)
+
+// everything allocated by the calling thread until the end of the scope is counted as `tag`
+#define ITU_MEMORY_TAG_SCOPE(tag)  ITU_MemoryTagScope ITU_MEMORY_CONCAT(itu_memory_tag_scope_, __LINE__)(tag)
+#define ITU_MEMORY_FRAME_MARK()    itu_memory_tracker_frame_mark()
+
+#else
+
+#define ITU_MEMORY_TAG_SCOPE(tag)
+#define ITU_MEMORY_FRAME_MARK()
+
+#endif // ITU_MEMORY_TRACKING_ENABLED
+
+bool itu_memory_tracker_install();
+bool itu_memory_tracker_is_installed();
+void itu_memory_tracker_frame_mark();
+
+ITU_MemoryTag itu_memory_tag_get();
+ITU_MemoryTag itu_memory_tag_set(ITU_MemoryTag tag);
+
+ITU_MemoryStats      itu_memory_tracker_stats();
+int                  itu_memory_tracker_history_count();
+ITU_MemoryFrameStats itu_memory_tracker_history_get(int i);
+
+void itu_memory_tracker_report_leaks();
+
+#endif // ITU_LIB_MEMORY_HPP
+
+#if (defined ITU_LIB_MEMORY_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
+
+#define ITU_MEMORY_MAGIC 0x17A110C5
+
+// placed in front of every allocation
+struct ITU_MemoryHeader
+{
+	ITU_MemoryHeader* prev; // all live allocations are in a list, for the leak report
+	ITU_MemoryHeader* next;
+	Uint64 size;
+	Uint64 frame;           // frame it was allocated in
+	Sint32 tag;
+	Uint32 magic;           // catches frees of memory we didn't allocate
+};
+
+// padded to keep the same alignment the original allocator gives us
+#define ITU_MEMORY_HEADER_SIZE ((sizeof(ITU_MemoryHeader) + 15) & ~(Uint64)15)
+
+const char* itu_memory_tag_names[ITU_MEMORY_TAG_MAX] = { "general", "ecs", "resources", "physics", "ui", "arenas" };
+
+struct ITU_MemoryTrackerContext
+{
+	bool installed;
+
+	// allocator we forward to
+	SDL_malloc_func  fn_malloc;
+	SDL_calloc_func  fn_calloc;
+	SDL_realloc_func fn_realloc;
+	SDL_free_func    fn_free;
+
+	// everything below is protected by `lock`
+	SDL_SpinLock lock;
+	ITU_MemoryHeader     live;      // sentinel of the list of live allocations
+	ITU_MemoryStats      stats;
+	ITU_MemoryFrameStats frame_current;
+	ITU_MemoryFrameStats history[ITU_MEMORY_HISTORY_COUNT];
+};
+
+static ITU_MemoryTrackerContext ctx_memory;
+static thread_local ITU_MemoryTag memory_tag_current;
+
+ITU_MemoryTag itu_memory_tag_get()
+{
+	return memory_tag_current;
+}
+
+// returns the previous tag
+ITU_MemoryTag itu_memory_tag_set(ITU_MemoryTag tag)
+{
+	ITU_MemoryTag ret = memory_tag_current;
+	memory_tag_current = tag;
+	return ret;
+}
+
+#ifdef ITU_MEMORY_TRACKING_ENABLED
+ITU_MemoryTagScope::ITU_MemoryTagScope(ITU_MemoryTag tag)
+{
+	tag_prev = itu_memory_tag_set(tag);
+}
+
+ITU_MemoryTagScope::~ITU_MemoryTagScope()
+{
+	itu_memory_tag_set(tag_prev);
+}
+#endif // ITU_MEMORY_TRACKING_ENABLED
+
+void itu_memory_tag_stats_add(ITU_MemoryTagStats* stats, Uint64 size)
+{
+	stats->live_bytes += size;
+	stats->live_count++;
+	stats->allocs_total++;
+	stats->peak_bytes = SDL_max(stats->peak_bytes, stats->live_bytes);
+}
+
+void itu_memory_tag_stats_remove(ITU_MemoryTagStats* stats, Uint64 size)
+{
+	stats->live_bytes -= size;
+	stats->live_count--;
+}
+
+void* itu_memory_record_alloc(ITU_MemoryHeader* header, Uint64 size, Sint32 tag)
+{
+	header->size = size;
+	header->tag = tag;
+	header->magic = ITU_MEMORY_MAGIC;
+
+	SDL_LockSpinlock(&ctx_memory.lock);
+	header->frame = ctx_memory.stats.frames_count;
+	header->prev = &ctx_memory.live;
+	header->next = ctx_memory.live.next;
+	ctx_memory.live.next->prev = header;
+	ctx_memory.live.next = header;
+
+	itu_memory_tag_stats_add(&ctx_memory.stats.tags[tag], size);
+	itu_memory_tag_stats_add(&ctx_memory.stats.total, size);
+	ctx_memory.frame_current.allocs++;
+	ctx_memory.frame_current.bytes_allocated += size;
+	SDL_UnlockSpinlock(&ctx_memory.lock);
+
+	return (Uint8*)header + ITU_MEMORY_HEADER_SIZE;
+}
+
+void itu_memory_record_free(ITU_MemoryHeader* header)
+{
+	SDL_LockSpinlock(&ctx_memory.lock);
+	header->prev->next = header->next;
+	header->next->prev = header->prev;
+
+	itu_memory_tag_stats_remove(&ctx_memory.stats.tags[header->tag], header->size);
+	itu_memory_tag_stats_remove(&ctx_memory.stats.total, header->size);
+	ctx_memory.frame_current.frees++;
+	SDL_UnlockSpinlock(&ctx_memory.lock);
+}
+
+ITU_MemoryHeader* itu_memory_header_get(void* ptr)
+{
+	ITU_MemoryHeader* header = (ITU_MemoryHeader*)((Uint8*)ptr - ITU_MEMORY_HEADER_SIZE);
+	SDL_assert(header->magic == ITU_MEMORY_MAGIC && "memory not allocated by the tracker (allocated before `itu_memory_tracker_install`?)");
+	return header;
+}
+
+void* SDLCALL itu_memory_tracked_malloc(size_t size)
+{
+	ITU_MemoryHeader* header = (ITU_MemoryHeader*)ctx_memory.fn_malloc(ITU_MEMORY_HEADER_SIZE + size);
+	if(!header)
+		return NULL;
+	return itu_memory_record_alloc(header, size, memory_tag_current);
+}
+
+void* SDLCALL itu_memory_tracked_calloc(size_t count, size_t size)
+{
+	if(size != 0 && count > SDL_SIZE_MAX / size)
+		return NULL;
+	ITU_MemoryHeader* header = (ITU_MemoryHeader*)ctx_memory.fn_calloc(1, ITU_MEMORY_HEADER_SIZE + count * size);
+	if(!header)
+		return NULL;
+	return itu_memory_record_alloc(header, count * size, memory_tag_current);
+}
+
+// NOTE: the memory keeps the tag it was first allocated with
+void* SDLCALL itu_memory_tracked_realloc(void* ptr, size_t size)
+{
+	if(!ptr)
+		return itu_memory_tracked_malloc(size);
+
+	ITU_MemoryHeader* header = itu_memory_header_get(ptr);
+	Uint64 size_old = header->size;
+	Sint32 tag = header->tag;
+
+	// NOTE: unlink it before reallocating, the list would point to freed memory if the block moves
+	itu_memory_record_free(header);
+	ITU_MemoryHeader* header_new = (ITU_MemoryHeader*)ctx_memory.fn_realloc(header, ITU_MEMORY_HEADER_SIZE + size);
+	if(!header_new)
+	{
+		itu_memory_record_alloc(header, size_old, tag);
+		return NULL;
+	}
+	return itu_memory_record_alloc(header_new, size, tag);
+}
+
+void SDLCALL itu_memory_tracked_free(void* ptr)
+{
+	if(!ptr)
+		return;
+
+	ITU_MemoryHeader* header = itu_memory_header_get(ptr);
+	itu_memory_record_free(header);
+	header->magic = 0;
+	ctx_memory.fn_free(header);
+}
+
+bool itu_memory_tracker_install()
+{
+	SDL_assert(!ctx_memory.installed);
+
+	ctx_memory.live.prev = &ctx_memory.live;
+	ctx_memory.live.next = &ctx_memory.live;
+	SDL_GetMemoryFunctions(&ctx_memory.fn_malloc, &ctx_memory.fn_calloc, &ctx_memory.fn_realloc, &ctx_memory.fn_free);
+	if(!SDL_SetMemoryFunctions(itu_memory_tracked_malloc, itu_memory_tracked_calloc, itu_memory_tracked_realloc, itu_memory_tracked_free))
+	{
+		SDL_Log("ERROR could not install the memory tracker: %s\n", SDL_GetError());
+		return false;
+	}
+
+	ctx_memory.installed = true;
+	return true;
+}
+
+bool itu_memory_tracker_is_installed()
+{
+	return ctx_memory.installed;
+}
+
+// call once per frame (from the main thread), closes the per-frame counters
+void itu_memory_tracker_frame_mark()
+{
+	if(!ctx_memory.installed)
+		return;
+
+	SDL_LockSpinlock(&ctx_memory.lock);
+	ctx_memory.stats.frame_last = ctx_memory.frame_current;
+	ctx_memory.history[ctx_memory.stats.frames_count % ITU_MEMORY_HISTORY_COUNT] = ctx_memory.frame_current;
+	ctx_memory.stats.frames_count++;
+	SDL_memset(&ctx_memory.frame_current, 0, sizeof(ctx_memory.frame_current));
+	SDL_UnlockSpinlock(&ctx_memory.lock);
+}
+
+// consistent copy of all counters
+ITU_MemoryStats itu_memory_tracker_stats()
+{
+	SDL_LockSpinlock(&ctx_memory.lock);
+	ITU_MemoryStats ret = ctx_memory.stats;
+	SDL_UnlockSpinlock(&ctx_memory.lock);
+	return ret;
+}
+
+int itu_memory_tracker_history_count()
+{
+	return (int)SDL_min(ctx_memory.stats.frames_count, (Uint64)ITU_MEMORY_HISTORY_COUNT);
+}
+
+// `i`: 0 is the oldest frame in the history
+ITU_MemoryFrameStats itu_memory_tracker_history_get(int i)
+{
+	Uint64 first = ctx_memory.stats.frames_count - itu_memory_tracker_history_count();
+	return ctx_memory.history[(first + i) % ITU_MEMORY_HISTORY_COUNT];
+}
+
+// logs what is still allocated, per tag, and the oldest `ITU_MEMORY_LEAKS_LOGGED_MAX` allocations.
+// Meant to be called right before exiting, after everything that is supposed to be freed has been
+void itu_memory_tracker_report_leaks()
+{
+	if(!ctx_memory.installed)
+		return;
+
+	ITU_MemoryStats stats = itu_memory_tracker_stats();
+	if(stats.total.live_count == 0)
+	{
+		SDL_Log("memory: no leaks\n");
+		return;
+	}
+
+	SDL_Log("memory: %" SDL_PRIu64 " allocations still alive (%" SDL_PRIu64 " bytes, peak %" SDL_PRIu64 " bytes)\n", stats.total.live_count, stats.total.live_bytes, stats.total.peak_bytes);
+	for(int i = 0; i < ITU_MEMORY_TAG_MAX; ++i)
+		if(stats.tags[i].live_count > 0)
+			SDL_Log("  %-10s %8" SDL_PRIu64 " allocations %12" SDL_PRIu64 " bytes\n", itu_memory_tag_names[i], stats.tags[i].live_count, stats.tags[i].live_bytes);
+
+	// oldest first (newest allocations are at the front of the list)
+	// NOTE: copied out before logging, `SDL_Log` can allocate and we would deadlock on our own lock
+	ITU_MemoryHeader leaks[ITU_MEMORY_LEAKS_LOGGED_MAX];
+	void*            leaks_ptr[ITU_MEMORY_LEAKS_LOGGED_MAX];
+	int leaks_count = 0;
+	SDL_LockSpinlock(&ctx_memory.lock);
+	for(ITU_MemoryHeader* header = ctx_memory.live.prev; header != &ctx_memory.live && leaks_count < ITU_MEMORY_LEAKS_LOGGED_MAX; header = header->prev)
+	{
+		leaks[leaks_count] = *header;
+		leaks_ptr[leaks_count] = (Uint8*)header + ITU_MEMORY_HEADER_SIZE;
+		leaks_count++;
+	}
+	SDL_UnlockSpinlock(&ctx_memory.lock);
+
+	for(int i = 0; i < leaks_count; ++i)
+		SDL_Log("  %p %10" SDL_PRIu64 " bytes, %-10s frame %" SDL_PRIu64 "\n", leaks_ptr[i], leaks[i].size, itu_memory_tag_names[leaks[i].tag], leaks[i].frame);
+}
+
+#endif // (defined ITU_LIB_MEMORY_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
@@ -0,0 +1,281 @@
+// hierarchical CPU profiler
+// `ITU_PROFILE_SCOPE("name")` records a zone from that line to the end of the enclosing scope. Zones are written to a
+// ring buffer owned by the calling thread (no locks, no contention between threads), and can be exported as
+// Chrome trace JSON (open it with `chrome://tracing` or https://ui.perfetto.dev), or shown live (see `itu_debug_ui_render_profiler`).
+//
+// The profiler is compiled out unless `ITU_PROFILER_ENABLED` is defined before including this file
+// (or `itu_unity_include.hpp`): all the macros expand to nothing, so they can be left everywhere.
+// NOTE: zone names are stored as pointers, so they must outlive the recorded data (string literals, system names, ...)
+
+#ifndef ITU_LIB_PROFILER_HPP
+#define ITU_LIB_PROFILER_HPP
+
+#ifndef ITU_UNITY_BUILD
+#include <SDL3/SDL.h>
+#include <itu_common.hpp>
+#endif
+
+#define ITU_PROFILER_THREADS_MAX 32
+#define ITU_PROFILER_EVENTS_MAX  (1 << 15) // per thread, must be a power of 2
+#define ITU_PROFILER_FRAMES_MAX  64        // frame boundaries kept (see `ITU_PROFILE_FRAME_MARK`)
+
+struct ITU_ProfileEvent
+{
+	const char* name;
+	Uint64 time_beg;
+	Uint64 time_end;
+	int    depth; // number of zones open on the same thread when this one began
+};
+
+struct ITU_ProfilerThread
+{
+	char name[32];
+
+	// ring buffer, only written by the owner thread.
+	// `head` is the number of events written so far, and is only incremented once an event is complete
+	ITU_ProfileEvent* events;
+	SDL_AtomicU32     head;
+	SDL_AtomicInt     ready; // set once `events` is allocated
+};
+
+#ifdef ITU_PROFILER_ENABLED
+
+struct ITU_ProfileScope
+{
+	const char* name;
+	Uint64 time_beg;
+
+	ITU_ProfileScope(const char* name);
+	~ITU_ProfileScope();
+};
+
+#define ITU_PROFILE_CONCAT_(a, b) a##b
+#define ITU_PROFILE_CONCAT(a, b)  ITU_PROFILE_CONCAT_(a, b)
+
+#define ITU_PROFILE_SCOPE(name)       ITU_ProfileScope ITU_PROFILE_CONCAT(itu_profile_scope_, __LINE__)(name)
+#define ITU_PROFILE_FRAME_MARK()      itu_profiler_frame_mark()
+#define ITU_PROFILE_THREAD_NAME(name) itu_profiler_thread_set_name(name)
+
+#else
+
+#define ITU_PROFILE_SCOPE(name)
+#define ITU_PROFILE_FRAME_MARK()
+#define ITU_PROFILE_THREAD_NAME(name)
+
+#endif // ITU_PROFILER_ENABLED
+
+void itu_profiler_deinit();
+void itu_profiler_thread_set_name(const char* name);
+void itu_profiler_frame_mark();
+
+// while paused nothing is recorded, so that the live view (and the exported data) stay the same
+void itu_profiler_set_paused(bool paused);
+bool itu_profiler_is_paused();
+
+int                 itu_profiler_threads_count();
+ITU_ProfilerThread* itu_profiler_thread_get(int i);
+// boundaries of the last complete frame. Returns false if less than two frames have been marked
+bool                itu_profiler_frame_last(Uint64* out_time_beg, Uint64* out_time_end);
+
+// writes everything currently in the buffers (the last `ITU_PROFILER_EVENTS_MAX` zones of each thread) as Chrome trace JSON
+bool itu_profiler_export(const char* path);
+
+#endif // ITU_LIB_PROFILER_HPP
+
+#if (defined ITU_LIB_PROFILER_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
+
+struct ITU_ProfilerContext
+{
+	ITU_ProfilerThread threads[ITU_PROFILER_THREADS_MAX];
+	SDL_AtomicInt      threads_count; // slots taken (a slot may not be `ready` yet)
+
+	Uint64        frames[ITU_PROFILER_FRAMES_MAX];
+	SDL_AtomicU32 frames_head;
+
+	SDL_AtomicInt paused;
+};
+
+static ITU_ProfilerContext ctx_profiler;
+static thread_local ITU_ProfilerThread* profiler_thread_current;
+static thread_local bool                profiler_thread_failed;
+static thread_local int                 profiler_depth;
+
+// the first time a thread records something it takes a slot (and allocates its buffer)
+ITU_ProfilerThread* itu_profiler_thread_current()
+{
+	if(profiler_thread_current || profiler_thread_failed)
+		return profiler_thread_current;
+
+	int slot = SDL_AddAtomicInt(&ctx_profiler.threads_count, 1);
+	if(slot >= ITU_PROFILER_THREADS_MAX)
+	{
+		SDL_Log("WARNING profiler: too many threads, increase ITU_PROFILER_THREADS_MAX\n");
+		profiler_thread_failed = true;
+		return NULL;
+	}
+
+	ITU_ProfilerThread* thread = &ctx_profiler.threads[slot];
+	if(thread->name[0] == '\0')
+		SDL_snprintf(thread->name, sizeof(thread->name), "thread_%02d", slot);
+	thread->events = (ITU_ProfileEvent*)SDL_malloc(sizeof(ITU_ProfileEvent) * ITU_PROFILER_EVENTS_MAX);
+	SDL_SetAtomicU32(&thread->head, 0);
+	SDL_SetAtomicInt(&thread->ready, 1);
+
+	profiler_thread_current = thread;
+	return thread;
+}
+
+void itu_profiler_event_record(const char* name, Uint64 time_beg, Uint64 time_end, int depth)
+{
+	if(SDL_GetAtomicInt(&ctx_profiler.paused))
+		return;
+
+	ITU_ProfilerThread* thread = itu_profiler_thread_current();
+	if(!thread)
+		return;
+
+	// NOTE: we are the only writer, the atomic store publishes the event to readers on other threads
+	Uint32 head = SDL_GetAtomicU32(&thread->head);
+	ITU_ProfileEvent* event = &thread->events[head & (ITU_PROFILER_EVENTS_MAX - 1)];
+	event->name = name;
+	event->time_beg = time_beg;
+	event->time_end = time_end;
+	event->depth = depth;
+	SDL_SetAtomicU32(&thread->head, head + 1);
+}
+
+#ifdef ITU_PROFILER_ENABLED
+ITU_ProfileScope::ITU_ProfileScope(const char* name)
+{
+	this->name = name;
+	profiler_depth++;
+	time_beg = SDL_GetTicksNS();
+}
+
+ITU_ProfileScope::~ITU_ProfileScope()
+{
+	Uint64 time_end = SDL_GetTicksNS();
+	profiler_depth--;
+	itu_profiler_event_record(name, time_beg, time_end, profiler_depth);
+}
+#endif // ITU_PROFILER_ENABLED
+
+// frees all buffers. Must be called when no other thread is recording anymore (ie after `itu_lib_jobs_deinit`)
+void itu_profiler_deinit()
+{
+	int count = SDL_min(SDL_GetAtomicInt(&ctx_profiler.threads_count), ITU_PROFILER_THREADS_MAX);
+	for(int i = 0; i < count; ++i)
+		SDL_free(ctx_profiler.threads[i].events);
+	SDL_memset(&ctx_profiler, 0, sizeof(ctx_profiler));
+	profiler_thread_current = NULL;
+}
+
+// name shown for the calling thread (`thread_NN` by default, `itu_lib_loop_init` names the calling thread `main`)
+void itu_profiler_thread_set_name(const char* name)
+{
+	ITU_ProfilerThread* thread = itu_profiler_thread_current();
+	if(thread)
+		SDL_strlcpy(thread->name, name, sizeof(thread->name));
+}
+
+// call once per frame (from the main thread), the live view shows the zones between the last two marks
+void itu_profiler_frame_mark()
+{
+	if(SDL_GetAtomicInt(&ctx_profiler.paused))
+		return;
+
+	Uint32 head = SDL_GetAtomicU32(&ctx_profiler.frames_head);
+	ctx_profiler.frames[head % ITU_PROFILER_FRAMES_MAX] = SDL_GetTicksNS();
+	SDL_SetAtomicU32(&ctx_profiler.frames_head, head + 1);
+}
+
+void itu_profiler_set_paused(bool paused)
+{
+	SDL_SetAtomicInt(&ctx_profiler.paused, paused);
+}
+
+bool itu_profiler_is_paused()
+{
+	return SDL_GetAtomicInt(&ctx_profiler.paused);
+}
+
+int itu_profiler_threads_count()
+{
+	return SDL_min(SDL_GetAtomicInt(&ctx_profiler.threads_count), ITU_PROFILER_THREADS_MAX);
+}
+
+// NULL if the thread in that slot is not done initializing
+ITU_ProfilerThread* itu_profiler_thread_get(int i)
+{
+	ITU_ProfilerThread* thread = &ctx_profiler.threads[i];
+	return SDL_GetAtomicInt(&thread->ready) ? thread : NULL;
+}
+
+bool itu_profiler_frame_last(Uint64* out_time_beg, Uint64* out_time_end)
+{
+	Uint32 head = SDL_GetAtomicU32(&ctx_profiler.frames_head);
+	if(head < 2)
+		return false;
+
+	*out_time_beg = ctx_profiler.frames[(head - 2) % ITU_PROFILER_FRAMES_MAX];
+	*out_time_end = ctx_profiler.frames[(head - 1) % ITU_PROFILER_FRAMES_MAX];
+	return true;
+}
+
+bool itu_profiler_export(const char* path)
+{
+	SDL_IOStream* stream = SDL_IOFromFile(path, "w");
+	if(!stream)
+	{
+		SDL_Log("ERROR could not open '%s': %s\n", path, SDL_GetError());
+		return false;
+	}
+
+	// NOTE: recording is paused while exporting, otherwise the oldest events could be overwritten while we read them.
+	//       A zone closing right when we pause can still be written, so we also skip the oldest slot
+	bool paused_prev = itu_profiler_is_paused();
+	itu_profiler_set_paused(true);
+
+	Uint64 time_origin = SDL_MAX_UINT64;
+	for(int i = 0; i < itu_profiler_threads_count(); ++i)
+	{
+		ITU_ProfilerThread* thread = itu_profiler_thread_get(i);
+		if(!thread)
+			continue;
+		Uint32 head = SDL_GetAtomicU32(&thread->head);
+		Uint32 first = head > ITU_PROFILER_EVENTS_MAX - 1 ? head - (ITU_PROFILER_EVENTS_MAX - 1) : 0;
+		for(Uint32 e = first; e < head; ++e)
+			time_origin = SDL_min(time_origin, thread->events[e & (ITU_PROFILER_EVENTS_MAX - 1)].time_beg);
+	}
+
+	SDL_IOprintf(stream, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first_entry = true;
+	for(int i = 0; i < itu_profiler_threads_count(); ++i)
+	{
+		ITU_ProfilerThread* thread = itu_profiler_thread_get(i);
+		if(!thread)
+			continue;
+
+		SDL_IOprintf(stream, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first_entry ? "" : ",\n", i, thread->name);
+		first_entry = false;
+
+		Uint32 head = SDL_GetAtomicU32(&thread->head);
+		Uint32 first = head > ITU_PROFILER_EVENTS_MAX - 1 ? head - (ITU_PROFILER_EVENTS_MAX - 1) : 0;
+		for(Uint32 e = first; e < head; ++e)
+		{
+			ITU_ProfileEvent* event = &thread->events[e & (ITU_PROFILER_EVENTS_MAX - 1)];
+			// timestamps are in microseconds
+			SDL_IOprintf(stream, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				event->name, i,
+				(double)(event->time_beg - time_origin) / (double)MICROS(1),
+				(double)(event->time_end - event->time_beg) / (double)MICROS(1)
+			);
+		}
+	}
+	SDL_IOprintf(stream, "\n]}\n");
+
+	itu_profiler_set_paused(paused_prev);
+	return SDL_CloseIO(stream);
+}
+
+#endif // ITU_LIB_PROFILER_IMPLEMENTATION
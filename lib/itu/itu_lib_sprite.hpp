@@ -3,6 +3,7 @@
 
 #ifndef ITU_UNITY_BUILD
 #include <itu_lib_engine.hpp>
+#include <itu_resource_storage.hpp>
 #endif
 
 struct Sprite
@@ -14,6 +15,20 @@ struct Sprite
 	bool         flip_horizontal;
 };
 
+// compact version of `Sprite` (32 bytes instead of 56, so two per cache line): the texture is a resource storage id
+// and the tint is packed in 8 bits per channel. Use the accessors below to read/write them as `SDL_Texture*` and `color`
+// NOTE: textures need to be in the resource storage (see `itu_sys_rstorage_texture_add`)
+struct SpriteCompact
+{
+	SDL_FRect rect;
+	vec2f     pivot;
+	Uint32    tint;    // RGBA8 (see `itu_lib_sprite_tint_pack`)
+	Uint16    texture; // ITU_IdTexture (`SPRITE_COMPACT_TEXTURE_NONE` if no texture)
+	bool      flip_horizontal;
+};
+
+#define SPRITE_COMPACT_TEXTURE_NONE 0xFFFF
+
 void itu_lib_sprite_init(Sprite* sprite, SDL_Texture* texture, SDL_FRect rect);
 SDL_FRect itu_lib_sprite_get_rect(int x, int y, int tile_w, int tile_h);
 SDL_FRect itu_lib_sprite_get_screen_rect(SDLContext* context, Sprite* sprite, Transform* transform);
@@ -21,6 +36,18 @@ vec2f itu_lib_sprite_get_world_size(SDLContext* context, Sprite* sprite, Transfo
 void itu_lib_sprite_render(SDLContext* context, Sprite* sprite, Transform* transform);
 void itu_lib_sprite_render_debug(SDLContext* context, Sprite* sprite, Transform* transform);
 
+Uint32 itu_lib_sprite_tint_pack  (color tint);
+color  itu_lib_sprite_tint_unpack(Uint32 tint);
+
+void          itu_lib_sprite_compact_init       (SpriteCompact* sprite, ITU_IdTexture texture, SDL_FRect rect);
+SDL_Texture*  itu_lib_sprite_compact_get_texture(SpriteCompact* sprite);
+void          itu_lib_sprite_compact_set_texture(SpriteCompact* sprite, SDL_Texture* texture);
+color         itu_lib_sprite_compact_get_tint   (SpriteCompact* sprite);
+void          itu_lib_sprite_compact_set_tint   (SpriteCompact* sprite, color tint);
+Sprite        itu_lib_sprite_compact_to_sprite  (SpriteCompact* sprite);
+SpriteCompact itu_lib_sprite_compact_from_sprite(Sprite* sprite);
+void          itu_lib_sprite_compact_render     (SDLContext* context, SpriteCompact* sprite, Transform* transform);
+
 #endif // ITU_LIB_SPRITE_HPP
 
 #if (defined ITU_LIB_SPRITE_IMPLEMENTATION) || (defined ITU_UNITY_BUILD)
@@ -100,4 +127,87 @@ void itu_lib_sprite_render_debug(SDLContext* context, Sprite* sprite, Transform*
 	itu_lib_render_draw_point(context->renderer, pos, 5, COLOR_YELLOW);
 }
 
+Uint32 itu_lib_sprite_tint_pack(color tint)
+{
+	Uint32 r = (Uint32)(SDL_clamp(tint.r, 0.0f, 1.0f) * 255.0f + 0.5f);
+	Uint32 g = (Uint32)(SDL_clamp(tint.g, 0.0f, 1.0f) * 255.0f + 0.5f);
+	Uint32 b = (Uint32)(SDL_clamp(tint.b, 0.0f, 1.0f) * 255.0f + 0.5f);
+	Uint32 a = (Uint32)(SDL_clamp(tint.a, 0.0f, 1.0f) * 255.0f + 0.5f);
+	return (r << 24) | (g << 16) | (b << 8) | a;
+}
+
+color itu_lib_sprite_tint_unpack(Uint32 tint)
+{
+	color ret;
+	ret.r = ((tint >> 24) & 0xFF) * (1.0f / 255.0f);
+	ret.g = ((tint >> 16) & 0xFF) * (1.0f / 255.0f);
+	ret.b = ((tint >>  8) & 0xFF) * (1.0f / 255.0f);
+	ret.a = ( tint        & 0xFF) * (1.0f / 255.0f);
+	return ret;
+}
+
+// inits sprite with reasonable defaults
+void itu_lib_sprite_compact_init(SpriteCompact* sprite, ITU_IdTexture texture, SDL_FRect rect)
+{
+	SDL_assert(texture <= SPRITE_COMPACT_TEXTURE_NONE);
+	sprite->rect = rect;
+	sprite->pivot = vec2f{ 0.5f, 0.5f };
+	sprite->tint = itu_lib_sprite_tint_pack(COLOR_WHITE);
+	sprite->texture = (Uint16)texture;
+	sprite->flip_horizontal = false;
+}
+
+SDL_Texture* itu_lib_sprite_compact_get_texture(SpriteCompact* sprite)
+{
+	if(sprite->texture == SPRITE_COMPACT_TEXTURE_NONE)
+		return NULL;
+	return itu_sys_rstorage_texture_get_ptr(sprite->texture);
+}
+
+void itu_lib_sprite_compact_set_texture(SpriteCompact* sprite, SDL_Texture* texture)
+{
+	ITU_IdTexture id = texture ? itu_sys_rstorage_texture_from_ptr(texture) : SPRITE_COMPACT_TEXTURE_NONE;
+	SDL_assert(id < SPRITE_COMPACT_TEXTURE_NONE || !texture);
+	sprite->texture = texture ? (Uint16)id : SPRITE_COMPACT_TEXTURE_NONE;
+}
+
+color itu_lib_sprite_compact_get_tint(SpriteCompact* sprite)
+{
+	return itu_lib_sprite_tint_unpack(sprite->tint);
+}
+
+void itu_lib_sprite_compact_set_tint(SpriteCompact* sprite, color tint)
+{
+	sprite->tint = itu_lib_sprite_tint_pack(tint);
+}
+
+Sprite itu_lib_sprite_compact_to_sprite(SpriteCompact* sprite)
+{
+	Sprite ret;
+	ret.texture = itu_lib_sprite_compact_get_texture(sprite);
+	ret.rect = sprite->rect;
+	ret.pivot = sprite->pivot;
+	ret.tint = itu_lib_sprite_compact_get_tint(sprite);
+	ret.flip_horizontal = sprite->flip_horizontal;
+	return ret;
+}
+
+SpriteCompact itu_lib_sprite_compact_from_sprite(Sprite* sprite)
+{
+	SpriteCompact ret;
+	itu_lib_sprite_compact_set_texture(&ret, sprite->texture);
+	ret.rect = sprite->rect;
+	ret.pivot = sprite->pivot;
+	ret.tint = itu_lib_sprite_tint_pack(sprite->tint);
+	ret.flip_horizontal = sprite->flip_horizontal;
+	return ret;
+}
+
+void itu_lib_sprite_compact_render(SDLContext* context, SpriteCompact* sprite, Transform* transform)
+{
+	// NOTE: unpacking is way cheaper than the render call itself, so we just reuse the normal path
+	Sprite sprite_unpacked = itu_lib_sprite_compact_to_sprite(sprite);
+	itu_lib_sprite_render(context, &sprite_unpacked, transform);
+}
+
 #endif // ITU_LIB_SPRITE_IMPLEMENTATION
\ No newline at end of file
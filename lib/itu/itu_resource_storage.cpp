@@ -3,6 +3,8 @@
 
 #include <SDL3/SDL.h>
 #include <itu_common.hpp>
+#include <itu_lib_profiler.hpp>
+#include <itu_lib_arena.hpp>
 #include <SDL3_mixer/SDL_mixer.h>
 #include <SDL3_ttf/SDL_ttf.h>
 #include <stb_ds.h>
@@ -36,11 +38,14 @@ struct ITU_ResourceStorageContext
 	stbds_hm(ITU_IdTexture, const char*) debug_names_texture;
 	stbds_hm(ITU_IdAudio  , const char*) debug_names_audio;
 	stbds_hm(ITU_IdFont   , const char*) debug_names_font;
+	ITU_Arena debug_names_arena; // storage for all debug names (they live as long as the storage)
 };
 ITU_ResourceStorageContext ctx_rstorage;
 
 ITU_IdTexture itu_sys_rstorage_texture_load(SDLContext* context, const char* path, SDL_ScaleMode mode)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_RESOURCES);
+	ITU_PROFILE_SCOPE("texture_load");
 	SDL_Texture*  new_tex = texture_create(context, path, mode);
 
 	if(!new_tex)
@@ -81,6 +86,7 @@ SDL_Texture* itu_sys_rstorage_texture_get_ptr(ITU_IdTexture id)
 
 ITU_IdTexture itu_sys_rstorage_texture_add(SDL_Texture* texture)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_RESOURCES);
 	ITU_IdTexture new_tex_idx = id_tex_next++;
 	TextureData   new_tex_data = { 0 };
 	new_tex_data.texture = texture;
@@ -92,12 +98,8 @@ ITU_IdTexture itu_sys_rstorage_texture_add(SDL_Texture* texture)
 
 void itu_sys_rstorage_texture_set_debug_name(ITU_IdTexture id, const char* debug_name)
 {
-	// NOTE: allocating every single name is BAD, but we haven't looked in allocaiton startegies and memory arenas yet
-	int len = SDL_strlen(debug_name);
-	char* name_storage = (char*)SDL_malloc(len + 1);
-	SDL_memcpy(name_storage, debug_name, len);
-	name_storage[len] = 0;
-
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_RESOURCES);
+	char* name_storage = itu_arena_strdup(&ctx_rstorage.debug_names_arena, debug_name);
 	stbds_hmput(ctx_rstorage.debug_names_texture, id, name_storage);
 }
 
@@ -115,6 +117,8 @@ const char* itu_sys_rstorage_texture_get_debug_name(ITU_IdTexture id)
 // =====================================================================================
 ITU_IdFont itu_sys_rstorage_font_load(SDLContext* context, const char* path, float size)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_RESOURCES);
+	ITU_PROFILE_SCOPE("font_load");
 	TTF_Font*  new_font = TTF_OpenFont(path, size);
 
 	if(!new_font)
@@ -134,6 +138,7 @@ ITU_IdFont itu_sys_rstorage_font_load(SDLContext* context, const char* path, flo
 
 ITU_IdFont itu_sys_rstorage_font_add(TTF_Font* font)
 {
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_RESOURCES);
 	ITU_IdFont new_font_idx = id_font_next++;
 	FontData new_font_data = { 0 };
 	new_font_data.font= font;
@@ -165,12 +170,8 @@ TTF_Font* itu_sys_rstorage_font_get_ptr(ITU_IdFont id)
 
 void itu_sys_rstorage_font_set_debug_name(ITU_IdFont id, const char* debug_name)
 {
-	// NOTE: allocating every single name is BAD, but we haven't looked in allocaiton startegies and memory arenas yet
-	int len = SDL_strlen(debug_name);
-	char* name_storage = (char*)SDL_malloc(len + 1);
-	SDL_memcpy(name_storage, debug_name, len);
-	name_storage[len] = 0;
-
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_RESOURCES);
+	char* name_storage = itu_arena_strdup(&ctx_rstorage.debug_names_arena, debug_name);
 	stbds_hmput(ctx_rstorage.debug_names_font, id, name_storage);
 }
 
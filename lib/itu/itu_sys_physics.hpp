@@ -10,15 +10,11 @@
 
 
 
+// only what game code reads/writes every frame (the fixed step state used for interpolation is in `PhysicsInterpolation`)
 struct PhysicsData
 {
 	b2BodyId body_id;
 
-	vec2f fixed_step_position;
-	float fixed_step_rotation;
-	vec2f fixed_step_velocity;
-	float fixed_step_torque;
-
 	vec2f velocity;
 	float torque;
 
@@ -26,6 +22,16 @@ struct PhysicsData
 	bool ignore_rotation;
 };
 
+// state of the body at the last physics step, used to interpolate `Transform` and `PhysicsData` between steps.
+// Only touched by `itu_system_physics`, that adds it to every entity with a `PhysicsData` on its own
+struct PhysicsInterpolation
+{
+	vec2f fixed_step_position;
+	float fixed_step_rotation;
+	vec2f fixed_step_velocity;
+	float fixed_step_torque;
+};
+
 struct PhysicsStaticData
 {
 	b2BodyId body_id;
@@ -68,8 +74,24 @@ void fn_box2d_wrapper_draw_polygon(b2Transform transform, const b2Vec2* vertices
 void fn_box2d_wrapper_draw_circle(b2Transform transform, float radius, b2HexColor b2_color, void* context);
 void fn_box2d_wrapper_draw_capsule(b2Vec2 p1, b2Vec2 p2, float radius, b2HexColor b2_color, void* context);
 
+void* itu_sys_physics_alloc(unsigned int size, int alignment)
+{
+	ITU_MEMORY_TAG_SCOPE(ITU_MEMORY_TAG_PHYSICS);
+	return SDL_aligned_alloc(alignment, size);
+}
+
+void itu_sys_physics_free(void* mem)
+{
+	SDL_aligned_free(mem);
+}
+
 void itu_sys_physics_init(SDLContext* context)
 {
+	// route box2d through SDL, so that the memory tracker sees it
+	// NOTE: box2d wants this before it allocates anything, so before the first world is created
+	if(itu_memory_tracker_is_installed())
+		b2SetAllocator(itu_sys_physics_alloc, itu_sys_physics_free);
+
 	// debug draw
 	sys_physics_data.debug_draw.context = context;
 	sys_physics_data.debug_draw.drawShapes = true;
@@ -89,6 +111,7 @@ void itu_sys_physics_reset(const b2WorldDef* world_def)
 
 void itu_sys_physics_step(float fixed_delta)
 {
+	ITU_PROFILE_SCOPE("physics_step");
 	b2World_Step(sys_physics_data.world_id, fixed_delta, 4);
 }
 
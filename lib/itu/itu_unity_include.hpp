@@ -7,6 +7,14 @@
 #define STB_IMAGE_IMPLEMENTATION
 
 #include <SDL3/SDL.h>
+
+// stb libraries allocate through SDL, so they show up in allocation tracking (see `itu_lib_memory.hpp`)
+#define STBDS_REALLOC(context, ptr, size) SDL_realloc(ptr, size)
+#define STBDS_FREE(context, ptr)          SDL_free(ptr)
+#define STBI_MALLOC(size)                 SDL_malloc(size)
+#define STBI_REALLOC(ptr, size)           SDL_realloc(ptr, size)
+#define STBI_FREE(ptr)                    SDL_free(ptr)
+
 #include <SDL3_mixer/SDL_mixer.h>
 #include <SDL3_ttf/SDL_ttf.h>
 
@@ -20,9 +28,14 @@
 #include <box2d/box2d.h>
 
 #include <itu_common.hpp>
+#include <itu_lib_memory.hpp>
+#include <itu_lib_profiler.hpp>
+#include <itu_lib_arena.hpp>
 #include <itu_lib_engine.hpp>
+#include <itu_lib_loop.hpp>
 
 #include <itu_lib_fileutils.hpp>
+#include <itu_lib_jobs.hpp>
 
 #include <itu_entity_storage.hpp>
 #include <itu_resource_storage.hpp>